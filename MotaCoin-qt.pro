@@ -191,6 +191,14 @@ contains(USE_UPNP, -) {
     win32:LIBS += -liphlpapi
 }
 
+# use: qmake "USE_SECP256K1=1"
+# libsecp256k1 (https://github.com/bitcoin-core/secp256k1) must be installed for support
+contains(USE_SECP256K1, 1) {
+    message(Building with libsecp256k1 signature verification)
+    DEFINES += USE_SECP256K1
+    LIBS += -lsecp256k1
+}
+
 # use: qmake "USE_DBUS=1"
 contains(USE_DBUS, 1) {
     message(Building with DBUS (Freedesktop notifications) support)
@@ -314,13 +322,16 @@ HEADERS += src/qt/bitcoingui.h \
     src/checkpoints.h \
     src/compat.h \
     src/coincontrol.h \
+    src/perfstats.h \
     src/sync.h \
     src/util.h \
     src/uint256.h \
     src/uint256_t.h \
+    src/arith_uint256.h \
     src/kernel.h \
     src/scrypt.h \
     src/pbkdf2.h \
+    src/sha256.h \
     src/serialize.h \
     src/strlcpy.h \
     src/main.h \
@@ -358,6 +369,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/qt/transactionview.h \
     src/qt/walletmodel.h \
     src/bitcoinrpc.h \
+    src/rpcjson.h \
     src/qt/overviewpage.h \
     src/qt/csvmodelwriter.h \
     src/crypter.h \
@@ -379,6 +391,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/clientversion.h \
     src/qt/chatwindow.h \
     src/qt/serveur.h \
+    src/blockfile.h \
     src/bloom.h \
     src/checkqueue.h \
     src/hash.h \
@@ -421,11 +434,13 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
         src/qt/serveur.cpp \
     src/alert.cpp \
     src/version.cpp \
+    src/perfstats.cpp \
     src/sync.cpp \
     src/util.cpp \
     src/netbase.cpp \
     src/key.cpp \
     src/script.cpp \
+    src/blockfile.cpp \
     src/main.cpp \
     src/miner.cpp \
     src/init.cpp \
@@ -451,6 +466,7 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/qt/walletmodel.cpp \
     src/bitcoinrpc.cpp \
     src/rpcdump.cpp \
+    src/rpcjson.cpp \
     src/rpcnet.cpp \
     src/rpcmining.cpp \
     src/rpcwallet.cpp \
@@ -474,7 +490,8 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/scrypt-x86.S \
     src/scrypt-x86_64.S \
     src/scrypt.cpp \
-    src/pbkdf2.cpp
+    src/pbkdf2.cpp \
+    src/sha256.cpp
 
 RESOURCES += \
     src/qt/bitcoin.qrc
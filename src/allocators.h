@@ -10,6 +10,9 @@
 #include <string>
 #include <boost/thread/mutex.hpp>
 #include <map>
+#include <new>
+#include <utility>
+#include <vector>
 
 #ifdef WIN32
 #ifdef _WIN32_WINNT
@@ -252,6 +255,44 @@ struct zero_after_free_allocator : public std::allocator<T>
     }
 };
 
+//
+// Hands out objects carved from large slabs. Objects are never destroyed or
+// freed, which suits data that lives until exit: there is no per-object
+// heap header, and objects allocated one after another share cache lines
+// and pages. Not thread safe; callers serialize allocations.
+//
+template<typename T, size_t nPerSlab = 4096>
+class CArena
+{
+private:
+    std::vector<char*> vSlabs;
+    size_t nUsed; // objects handed out from the last slab
+
+public:
+    CArena() : nUsed(nPerSlab) {}
+
+    template<typename... Args>
+    T* New(Args&&... args)
+    {
+        if (nUsed == nPerSlab)
+        {
+            vSlabs.push_back(static_cast<char*>(::operator new(sizeof(T) * nPerSlab)));
+            nUsed = 0;
+        }
+        return new (vSlabs.back() + sizeof(T) * nUsed++) T(std::forward<Args>(args)...);
+    }
+
+    size_t size() const
+    {
+        return vSlabs.empty() ? 0 : (vSlabs.size() - 1) * nPerSlab + nUsed;
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return vSlabs.size() * nPerSlab * sizeof(T);
+    }
+};
+
 // This is exactly like std::string, but with a custom allocator.
 typedef std::basic_string<char, std::char_traits<char>, secure_allocator<char> > SecureString;
 
@@ -0,0 +1,383 @@
+// Copyright (c) 2009-2015 Satoshi Nakamoto
+// Copyright (c) 2009-2015 The Bitcoin developers
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_ARITH_UINT256_H
+#define BITCOIN_ARITH_UINT256_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "uint256.h"
+
+/** Fixed width unsigned integer with the arithmetic that target and trust
+ *  computations need (multiply, divide, shifts, compare). Unlike CBigNum it
+ *  lives on the stack and never touches OpenSSL. Arithmetic wraps modulo
+ *  2^BITS, so callers pick a width large enough for their intermediates.
+ */
+template<unsigned int BITS>
+class arith_base_uint
+{
+protected:
+    enum { WIDTH=BITS/32 };
+    uint32_t pn[WIDTH];
+
+    template<unsigned int> friend class arith_base_uint;
+
+public:
+    arith_base_uint()
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    arith_base_uint(uint64_t b)
+    {
+        pn[0] = (uint32_t)b;
+        pn[1] = (uint32_t)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    /** Widen or truncate from another width */
+    template<unsigned int BITS2>
+    explicit arith_base_uint(const arith_base_uint<BITS2>& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = i < (int)arith_base_uint<BITS2>::WIDTH ? b.pn[i] : 0;
+    }
+
+    bool operator!() const
+    {
+        for (int i = 0; i < WIDTH; i++)
+            if (pn[i] != 0)
+                return false;
+        return true;
+    }
+
+    const arith_base_uint operator~() const
+    {
+        arith_base_uint ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        return ret;
+    }
+
+    arith_base_uint& operator=(uint64_t b)
+    {
+        pn[0] = (uint32_t)b;
+        pn[1] = (uint32_t)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+        return *this;
+    }
+
+    arith_base_uint& operator^=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] ^= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator&=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] &= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator|=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] |= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator<<=(unsigned int shift)
+    {
+        arith_base_uint a(*this);
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+        int k = shift / 32;
+        shift = shift % 32;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            if (i+k+1 < WIDTH && shift != 0)
+                pn[i+k+1] |= (a.pn[i] >> (32-shift));
+            if (i+k < WIDTH)
+                pn[i+k] |= (a.pn[i] << shift);
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator>>=(unsigned int shift)
+    {
+        arith_base_uint a(*this);
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+        int k = shift / 32;
+        shift = shift % 32;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            if (i-k-1 >= 0 && shift != 0)
+                pn[i-k-1] |= (a.pn[i] << (32-shift));
+            if (i-k >= 0)
+                pn[i-k] |= (a.pn[i] >> shift);
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator+=(const arith_base_uint& b)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = carry + pn[i] + b.pn[i];
+            pn[i] = n & 0xffffffff;
+            carry = n >> 32;
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator-=(const arith_base_uint& b)
+    {
+        uint64_t borrow = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = (uint64_t)pn[i] - b.pn[i] - borrow;
+            pn[i] = n & 0xffffffff;
+            borrow = (n >> 32) & 1;
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator*=(uint32_t b32)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = carry + (uint64_t)b32 * pn[i];
+            pn[i] = n & 0xffffffff;
+            carry = n >> 32;
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator*=(const arith_base_uint& b)
+    {
+        arith_base_uint a;
+        for (int j = 0; j < WIDTH; j++)
+        {
+            if (pn[j] == 0)
+                continue;
+            uint64_t carry = 0;
+            for (int i = 0; i + j < WIDTH; i++)
+            {
+                uint64_t n = carry + a.pn[i + j] + (uint64_t)pn[j] * b.pn[i];
+                a.pn[i + j] = n & 0xffffffff;
+                carry = n >> 32;
+            }
+        }
+        *this = a;
+        return *this;
+    }
+
+    /** Truncating division by a single word, one pass from the top */
+    arith_base_uint& operator/=(uint32_t b32)
+    {
+        if (b32 == 0)
+            return *this = 0;
+        uint64_t rem = 0;
+        for (int i = WIDTH-1; i >= 0; i--)
+        {
+            uint64_t n = (rem << 32) | pn[i];
+            pn[i] = (uint32_t)(n / b32);
+            rem = n % b32;
+        }
+        return *this;
+    }
+
+    /** Truncating division; dividing by zero yields zero */
+    arith_base_uint& operator/=(const arith_base_uint& b)
+    {
+        arith_base_uint div = b;     // make a copy, so we can shift.
+        arith_base_uint num = *this; // make a copy, so we can subtract.
+        *this = 0;                   // the quotient.
+        int num_bits = num.bits();
+        int div_bits = div.bits();
+        if (div_bits == 0 || div_bits > num_bits)
+            return *this;
+        int shift = num_bits - div_bits;
+        div <<= shift; // shift so that div and num align.
+        while (shift >= 0)
+        {
+            if (num >= div)
+            {
+                num -= div;
+                pn[shift / 32] |= (1U << (shift & 31)); // set a bit of the result.
+            }
+            div >>= 1; // shift back.
+            shift--;
+        }
+        // num now contains the remainder of the division.
+        return *this;
+    }
+
+    arith_base_uint& operator++()
+    {
+        // prefix operator
+        int i = 0;
+        while (i < WIDTH && ++pn[i] == 0)
+            i++;
+        return *this;
+    }
+
+    int CompareTo(const arith_base_uint& b) const
+    {
+        for (int i = WIDTH-1; i >= 0; i--)
+        {
+            if (pn[i] < b.pn[i])
+                return -1;
+            if (pn[i] > b.pn[i])
+                return 1;
+        }
+        return 0;
+    }
+
+    bool EqualTo(uint64_t b) const
+    {
+        for (int i = WIDTH-1; i >= 2; i--)
+            if (pn[i])
+                return false;
+        return pn[1] == (b >> 32) && pn[0] == (b & 0xffffffff);
+    }
+
+    /** Position of the highest set bit plus one, or zero */
+    unsigned int bits() const
+    {
+        for (int pos = WIDTH-1; pos >= 0; pos--)
+        {
+            if (pn[pos])
+            {
+                for (int nbits = 31; nbits > 0; nbits--)
+                    if (pn[pos] & (1U << nbits))
+                        return 32*pos + nbits + 1;
+                return 32*pos + 1;
+            }
+        }
+        return 0;
+    }
+
+    uint64_t GetLow64() const
+    {
+        return pn[0] | (uint64_t)pn[1] << 32;
+    }
+
+    friend inline const arith_base_uint operator+(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) += b; }
+    friend inline const arith_base_uint operator-(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) -= b; }
+    friend inline const arith_base_uint operator*(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) *= b; }
+    friend inline const arith_base_uint operator/(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) /= b; }
+    friend inline const arith_base_uint operator*(const arith_base_uint& a, uint32_t b)               { return arith_base_uint(a) *= b; }
+    friend inline const arith_base_uint operator/(const arith_base_uint& a, uint32_t b)               { return arith_base_uint(a) /= b; }
+    friend inline const arith_base_uint operator<<(const arith_base_uint& a, unsigned int shift)      { return arith_base_uint(a) <<= shift; }
+    friend inline const arith_base_uint operator>>(const arith_base_uint& a, unsigned int shift)      { return arith_base_uint(a) >>= shift; }
+    friend inline bool operator==(const arith_base_uint& a, const arith_base_uint& b) { return memcmp(a.pn, b.pn, sizeof(a.pn)) == 0; }
+    friend inline bool operator!=(const arith_base_uint& a, const arith_base_uint& b) { return memcmp(a.pn, b.pn, sizeof(a.pn)) != 0; }
+    friend inline bool operator<(const arith_base_uint& a, const arith_base_uint& b)  { return a.CompareTo(b) < 0; }
+    friend inline bool operator<=(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) <= 0; }
+    friend inline bool operator>(const arith_base_uint& a, const arith_base_uint& b)  { return a.CompareTo(b) > 0; }
+    friend inline bool operator>=(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) >= 0; }
+    friend inline bool operator==(const arith_base_uint& a, uint64_t b) { return a.EqualTo(b); }
+    friend inline bool operator!=(const arith_base_uint& a, uint64_t b) { return !a.EqualTo(b); }
+};
+
+/** 256-bit unsigned integer for targets and chain trust */
+class arith_uint256 : public arith_base_uint<256>
+{
+public:
+    arith_uint256() {}
+    arith_uint256(const arith_base_uint<256>& b) : arith_base_uint<256>(b) {}
+    arith_uint256(uint64_t b) : arith_base_uint<256>(b) {}
+    template<unsigned int BITS2>
+    explicit arith_uint256(const arith_base_uint<BITS2>& b) : arith_base_uint<256>(b) {}
+
+    explicit arith_uint256(const uint256& b)
+    {
+        memcpy(pn, b.begin(), sizeof(pn));
+    }
+
+    uint256 getuint256() const
+    {
+        uint256 n;
+        memcpy(n.begin(), pn, sizeof(pn));
+        return n;
+    }
+
+    /**
+     * The "compact" format is a representation of a whole number N using an
+     * unsigned 32bit number similar to a floating point format. The most
+     * significant 8 bits are the unsigned exponent of base 256 and the lower
+     * 23 bits are the mantissa; bit 23 (0x800000) is the sign. This is the
+     * OpenSSL MPI encoding CBigNum::SetCompact used, so the results agree
+     * for every nBits value:
+     *   N = (-1^sign) * mantissa * 256^(exponent-3)
+     * pfNegative is set for a non-zero negative value, pfOverflow when N
+     * does not fit in 256 bits. In both cases the stored value is not N.
+     */
+    arith_uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL)
+    {
+        int nSize = nCompact >> 24;
+        uint32_t nWord = nCompact & 0x007fffff;
+        if (nSize <= 3)
+        {
+            nWord >>= 8 * (3 - nSize);
+            *this = nWord;
+        }
+        else
+        {
+            *this = nWord;
+            *this <<= 8 * (nSize - 3);
+        }
+        if (pfNegative)
+            *pfNegative = nWord != 0 && (nCompact & 0x00800000) != 0;
+        if (pfOverflow)
+            *pfOverflow = nWord != 0 && ((nSize > 34) ||
+                                         (nWord > 0xff && nSize > 33) ||
+                                         (nWord > 0xffff && nSize > 32));
+        return *this;
+    }
+
+    uint32_t GetCompact(bool fNegative = false) const
+    {
+        int nSize = (bits() + 7) / 8;
+        uint32_t nCompact = 0;
+        if (nSize <= 3)
+            nCompact = GetLow64() << 8 * (3 - nSize);
+        else
+            nCompact = (arith_uint256(*this) >> 8 * (nSize - 3)).GetLow64();
+        // The 0x00800000 bit denotes the sign.
+        // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
+        if (nCompact & 0x00800000)
+        {
+            nCompact >>= 8;
+            nSize++;
+        }
+        nCompact |= nSize << 24;
+        nCompact |= (fNegative && (nCompact & 0x007fffff) ? 0x00800000 : 0);
+        return nCompact;
+    }
+};
+
+/** 512-bit unsigned integer for products of a target with a weight */
+class arith_uint512 : public arith_base_uint<512>
+{
+public:
+    arith_uint512() {}
+    arith_uint512(const arith_base_uint<512>& b) : arith_base_uint<512>(b) {}
+    arith_uint512(uint64_t b) : arith_base_uint<512>(b) {}
+    template<unsigned int BITS2>
+    explicit arith_uint512(const arith_base_uint<BITS2>& b) : arith_base_uint<512>(b) {}
+};
+
+#endif
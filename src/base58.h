@@ -16,106 +16,177 @@
 #ifndef BITCOIN_BASE58_H
 #define BITCOIN_BASE58_H
 
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 #include <vector>
-#include "bignum.h"
 #include "key.h"
 #include "script.h"
 
 static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 
+// Value of each base58 digit character, -1 for characters that aren't digits
+static const signed char mapBase58[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8,-1,-1,-1,-1,-1,-1,
+    -1, 9,10,11,12,13,14,15,16,-1,17,18,19,20,21,-1,
+    22,23,24,25,26,27,28,29,30,31,32,-1,-1,-1,-1,-1,
+    -1,33,34,35,36,37,38,39,40,41,42,43,-1,44,45,46,
+    47,48,49,50,51,52,53,54,55,56,57,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+// The conversions work on limbs holding five base58 digits (58^5 < 2^30)
+// or 32 bits, so each input byte or character costs one multiply-add per
+// limb instead of a bignum division. Limbs of the usual keys and addresses
+// fit in a buffer on the stack.
+static const uint32_t BASE58_POW5 = 58 * 58 * 58 * 58 * 58;
+static const size_t BASE58_STACK_LIMBS = 64;
+
 // Encode a byte sequence as a base58-encoded string
 inline std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
 {
-    CAutoBN_CTX pctx;
-    CBigNum bn58 = 58;
-    CBigNum bn0 = 0;
-
-    // Convert big endian data to little endian
-    // Extra zero at the end make sure bignum will interpret as a positive number
-    std::vector<unsigned char> vchTmp(pend-pbegin+1, 0);
-    reverse_copy(pbegin, pend, vchTmp.begin());
-
-    // Convert little endian data to bignum
-    CBigNum bn;
-    bn.setvch(vchTmp);
+    // Leading zeroes encoded as base58 zeros
+    size_t nZeroes = 0;
+    while (pbegin != pend && *pbegin == 0)
+    {
+        pbegin++;
+        nZeroes++;
+    }
 
-    // Convert bignum to std::string
-    std::string str;
-    // Expected size increase from base58 conversion is approximately 137%
+    // Convert big endian bytes to little endian limbs of five base58 digits.
+    // Expected size increase from base58 conversion is approximately 137%,
     // use 138% to be safe
-    str.reserve((pend - pbegin) * 138 / 100 + 1);
-    CBigNum dv;
-    CBigNum rem;
-    while (bn > bn0)
+    size_t nMaxLimbs = (pend - pbegin) * 138 / 100 / 5 + 1;
+    uint32_t pnStack[BASE58_STACK_LIMBS];
+    std::vector<uint32_t> vLimbs;
+    uint32_t* pn = pnStack;
+    if (nMaxLimbs > BASE58_STACK_LIMBS)
     {
-        if (!BN_div(&dv, &rem, &bn, &bn58, pctx))
-            throw bignum_error("EncodeBase58 : BN_div failed");
-        bn = dv;
-        unsigned int c = rem.getulong();
-        str += pszBase58[c];
+        vLimbs.resize(nMaxLimbs);
+        pn = &vLimbs[0];
+    }
+    size_t nLimbs = 0;
+    while (pbegin != pend)
+    {
+        // Up to three bytes at a time keep limb * 2^24 + carry below 2^64
+        int nBytes = std::min(pend - pbegin, (ptrdiff_t)3);
+        uint64_t carry = 0;
+        for (int i = 0; i < nBytes; i++)
+            carry = (carry << 8) | *pbegin++;
+        for (size_t i = 0; i < nLimbs; i++)
+        {
+            carry += (uint64_t)pn[i] << (8 * nBytes);
+            pn[i] = carry % BASE58_POW5;
+            carry /= BASE58_POW5;
+        }
+        while (carry > 0)
+        {
+            pn[nLimbs++] = carry % BASE58_POW5;
+            carry /= BASE58_POW5;
+        }
     }
 
-    // Leading zeroes encoded as base58 zeros
-    for (const unsigned char* p = pbegin; p < pend && *p == 0; p++)
-        str += pszBase58[0];
-
-    // Convert little endian std::string to big endian
-    reverse(str.begin(), str.end());
+    // Convert limbs to big endian digits, the top limb without leading zeros
+    std::string str;
+    str.reserve(nZeroes + nLimbs * 5);
+    str.assign(nZeroes, pszBase58[0]);
+    for (size_t i = nLimbs; i-- > 0; )
+    {
+        char pch[5];
+        uint32_t n = pn[i];
+        for (int j = 4; j >= 0; j--)
+        {
+            pch[j] = pszBase58[n % 58];
+            n /= 58;
+        }
+        int nSkip = 0;
+        if (i == nLimbs - 1)
+            while (pch[nSkip] == pszBase58[0])
+                nSkip++;
+        str.append(pch + nSkip, 5 - nSkip);
+    }
     return str;
 }
 
 // Encode a byte vector as a base58-encoded string
 inline std::string EncodeBase58(const std::vector<unsigned char>& vch)
 {
-    return EncodeBase58(&vch[0], &vch[0] + vch.size());
+    return EncodeBase58(vch.data(), vch.data() + vch.size());
 }
 
 // Decode a base58-encoded string psz into byte vector vchRet
 // returns true if decoding is successful
 inline bool DecodeBase58(const char* psz, std::vector<unsigned char>& vchRet)
 {
-    CAutoBN_CTX pctx;
     vchRet.clear();
-    CBigNum bn58 = 58;
-    CBigNum bn = 0;
-    CBigNum bnChar;
     while (isspace(*psz))
         psz++;
 
-    // Convert big endian string to bignum
-    for (const char* p = psz; *p; p++)
+    // Leading base58 zeros decode to zero bytes
+    size_t nZeroes = 0;
+    while (*psz == pszBase58[0])
+    {
+        psz++;
+        nZeroes++;
+    }
+
+    // Convert big endian digits to little endian 32-bit limbs, five digits
+    // at a time. log(58) / log(2^32) is below 0.1836
+    size_t nMaxLimbs = strlen(psz) * 1836 / 10000 + 1;
+    uint32_t pnStack[BASE58_STACK_LIMBS];
+    std::vector<uint32_t> vLimbs;
+    uint32_t* pn = pnStack;
+    if (nMaxLimbs > BASE58_STACK_LIMBS)
+    {
+        vLimbs.resize(nMaxLimbs);
+        pn = &vLimbs[0];
+    }
+    size_t nLimbs = 0;
+    while (true)
     {
-        const char* p1 = strchr(pszBase58, *p);
-        if (p1 == NULL)
+        uint64_t carry = 0;
+        uint64_t nMul = 1;
+        for (int i = 0; i < 5 && mapBase58[(unsigned char)*psz] >= 0; i++, psz++)
         {
-            while (isspace(*p))
-                p++;
-            if (*p != '\0')
-                return false;
+            carry = carry * 58 + mapBase58[(unsigned char)*psz];
+            nMul *= 58;
+        }
+        if (nMul == 1)
             break;
+        for (size_t i = 0; i < nLimbs; i++)
+        {
+            carry += pn[i] * nMul;
+            pn[i] = (uint32_t)carry;
+            carry >>= 32;
         }
-        bnChar.setulong(p1 - pszBase58);
-        if (!BN_mul(&bn, &bn, &bn58, pctx))
-            throw bignum_error("DecodeBase58 : BN_mul failed");
-        bn += bnChar;
+        if (carry > 0)
+            pn[nLimbs++] = (uint32_t)carry;
     }
 
-    // Get bignum as little endian data
-    std::vector<unsigned char> vchTmp = bn.getvch();
-
-    // Trim off sign byte if present
-    if (vchTmp.size() >= 2 && vchTmp.end()[-1] == 0 && vchTmp.end()[-2] >= 0x80)
-        vchTmp.erase(vchTmp.end()-1);
-
-    // Restore leading zeros
-    int nLeadingZeros = 0;
-    for (const char* p = psz; *p == pszBase58[0]; p++)
-        nLeadingZeros++;
-    vchRet.assign(nLeadingZeros + vchTmp.size(), 0);
+    // Only trailing whitespace may follow the digits
+    while (isspace(*psz))
+        psz++;
+    if (*psz != '\0')
+        return false;
 
-    // Convert little endian data to big endian
-    reverse_copy(vchTmp.begin(), vchTmp.end(), vchRet.end() - vchTmp.size());
+    // Convert limbs to big endian bytes, without the top limb's leading zeros
+    vchRet.reserve(nZeroes + nLimbs * 4);
+    vchRet.assign(nZeroes, 0);
+    for (size_t i = nLimbs; i-- > 0; )
+        for (int j = 3; j >= 0; j--)
+            if (i != nLimbs - 1 || (pn[i] >> (8 * j)) != 0 || vchRet.size() > nZeroes)
+                vchRet.push_back((pn[i] >> (8 * j)) & 0xff);
     return true;
 }
 
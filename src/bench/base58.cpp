@@ -0,0 +1,40 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "base58.h"
+
+// Address sized payload: version byte, hash160 and checksum
+static void EncodeBase58_25Bytes(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(25);
+    for (unsigned int i = 0; i < vch.size(); i++)
+        vch[i] = (unsigned char)(i * 73 + 1);
+    while (state.KeepRunning())
+        EncodeBase58(vch);
+}
+
+// Private key export sized payload
+static void EncodeBase58_38Bytes(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(38);
+    for (unsigned int i = 0; i < vch.size(); i++)
+        vch[i] = (unsigned char)(i * 73 + 1);
+    while (state.KeepRunning())
+        EncodeBase58(vch);
+}
+
+static void DecodeBase58_25Bytes(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(25);
+    for (unsigned int i = 0; i < vch.size(); i++)
+        vch[i] = (unsigned char)(i * 73 + 1);
+    std::string str = EncodeBase58(vch);
+    while (state.KeepRunning())
+        DecodeBase58(str, vch);
+}
+
+BENCHMARK(EncodeBase58_25Bytes);
+BENCHMARK(EncodeBase58_38Bytes);
+BENCHMARK(DecodeBase58_25Bytes);
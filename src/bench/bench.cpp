@@ -0,0 +1,112 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include <stdio.h>
+#include <limits>
+
+#include "util.h"
+
+namespace benchmark
+{
+
+State::State(const std::string& nameIn, int64_t nMaxElapsedIn)
+    : name(nameIn), nMaxElapsed(nMaxElapsedIn), nBeginTime(0), nLastTime(0), nCount(0), nCountMask(0),
+      dMinTime(std::numeric_limits<double>::max()), dMaxTime(0)
+{
+}
+
+// On entry nCount is the number of iterations completed since timing began
+bool State::KeepRunning()
+{
+    if (nCount & nCountMask)
+    {
+        ++nCount;
+        return true;
+    }
+
+    int64_t nNow = GetTimeMicros();
+    if (nCount == 0)
+    {
+        nBeginTime = nLastTime = nNow;
+        ++nCount;
+        return true;
+    }
+
+    int64_t nElapsed = nNow - nLastTime;
+    if (nElapsed * 128 < nMaxElapsed)
+    {
+        // Far too short to time with microsecond resolution: make batches
+        // eight times longer and start the measurement over
+        nCountMask = ((nCountMask << 3) | 7) & ((1LL << 60) - 1);
+        nBeginTime = nLastTime = nNow;
+        nCount = 1;
+        dMinTime = std::numeric_limits<double>::max();
+        dMaxTime = 0;
+        return true;
+    }
+
+    double dTimeOne = nElapsed * 1000.0 / (nCountMask + 1);
+    dMinTime = std::min(dMinTime, dTimeOne);
+    dMaxTime = std::max(dMaxTime, dTimeOne);
+    nLastTime = nNow;
+
+    if (nNow - nBeginTime >= nMaxElapsed)
+        return false;
+
+    // Double the batch while batches are short, but only on a boundary of
+    // the new batch size so that every batch is timed over whole batches
+    if (nElapsed * 16 < nMaxElapsed)
+    {
+        uint64_t nNewCountMask = ((nCountMask << 1) | 1) & ((1LL << 60) - 1);
+        if ((nCount & nNewCountMask) == 0)
+            nCountMask = nNewCountMask;
+    }
+    ++nCount;
+    return true;
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::Benchmarks()
+{
+    // Function-local so that registration from other translation units'
+    // static initializers does not depend on initialization order
+    static BenchmarkMap benchmarks;
+    return benchmarks;
+}
+
+BenchRunner::BenchRunner(const std::string& name, BenchFunction func)
+{
+    Benchmarks().insert(std::make_pair(name, func));
+}
+
+void BenchRunner::RunAll(const std::string& strFilter, int64_t nMaxElapsed)
+{
+    fprintf(stdout, "# benchmark,iterations,elapsed_us,ns_per_op,ops_per_s,min_ns_per_op,max_ns_per_op\n");
+    fflush(stdout);
+    for (BenchmarkMap::iterator it = Benchmarks().begin(); it != Benchmarks().end(); ++it)
+    {
+        if (it->first.find(strFilter) == std::string::npos)
+            continue;
+
+        State state(it->first, nMaxElapsed);
+        it->second(state);
+
+        uint64_t nIterations = state.GetIterations();
+        int64_t nElapsed = std::max(state.GetElapsed(), (int64_t)1);
+        double dTimeOne = nIterations ? nElapsed * 1000.0 / nIterations : 0;
+        fprintf(stdout, "%s,%" PRIu64 ",%" PRId64 ",%.1f,%.1f,%.1f,%.1f\n",
+            state.GetName().c_str(), nIterations, nElapsed, dTimeOne,
+            nIterations * 1000000.0 / nElapsed,
+            nIterations ? state.GetMinTime() : 0, state.GetMaxTime());
+        fflush(stdout);
+    }
+}
+
+void BenchRunner::List()
+{
+    for (BenchmarkMap::iterator it = Benchmarks().begin(); it != Benchmarks().end(); ++it)
+        fprintf(stdout, "%s\n", it->first.c_str());
+}
+
+}
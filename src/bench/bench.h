@@ -0,0 +1,82 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+/** Micro-benchmark registry for bench_motacoin.
+ *
+ * A benchmark is a function taking a State; it does its setup, then runs the
+ * code to be timed for as long as KeepRunning() returns true:
+ *
+ *     static void Hash9_80Bytes(benchmark::State& state)
+ *     {
+ *         ... setup ...
+ *         while (state.KeepRunning())
+ *             hash = Hash9(BEGIN(header), END(header));
+ *     }
+ *     BENCHMARK(Hash9_80Bytes);
+ *
+ * KeepRunning() only reads the clock once per batch of iterations, doubling
+ * the batch until a batch takes a noticeable slice of the time budget, so
+ * even operations of a few nanoseconds are measured with little overhead.
+ */
+namespace benchmark
+{
+
+class State
+{
+private:
+    std::string name;
+    int64_t nMaxElapsed;    // time budget in microseconds
+    int64_t nBeginTime;
+    int64_t nLastTime;
+    uint64_t nCount;
+    uint64_t nCountMask;
+    double dMinTime;        // fastest and slowest batch, nanoseconds per operation
+    double dMaxTime;
+
+public:
+    State(const std::string& nameIn, int64_t nMaxElapsedIn);
+
+    bool KeepRunning();
+
+    const std::string& GetName() const { return name; }
+    uint64_t GetIterations() const { return nCount; }
+    int64_t GetElapsed() const { return nLastTime - nBeginTime; }
+    double GetMinTime() const { return dMinTime; }
+    double GetMaxTime() const { return dMaxTime; }
+};
+
+typedef boost::function<void(State&)> BenchFunction;
+
+class BenchRunner
+{
+private:
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& Benchmarks();
+
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    // Run every benchmark whose name contains strFilter, giving each
+    // nMaxElapsed microseconds, and print one CSV line per benchmark to stdout
+    static void RunAll(const std::string& strFilter, int64_t nMaxElapsed);
+    static void List();
+};
+
+}
+
+// BENCHMARK(foo) registers foo under the name "foo"
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BITCOIN_BENCH_BENCH_H
@@ -0,0 +1,568 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// End-to-end benchmark of block connection: generates a synthetic chain on
+// testnet rules into a temporary data directory and times connecting it the
+// way initial block download does, a reorganization to a competing branch
+// and putting the disconnected transactions back into the memory pool.
+
+#include <stdio.h>
+
+#include <deque>
+
+#include <boost/filesystem.hpp>
+
+#include "db.h"
+#include "kernel.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+extern void noui_connect();
+
+// Above the stake target spacing, so that the stake target stays at its
+// limit and every block of the same kind adds the same trust
+static const unsigned int CHAIN_BLOCK_SPACING = 5 * 60;
+
+// Paid by every generated transaction; covers transactions up to 100 kB
+static const int64_t CHAIN_TX_FEE = 100 * MIN_TX_FEE;
+
+// Stake outputs the premine is split into, each staking about once per
+// maturity period
+static const unsigned int CHAIN_STAKE_OUTPUTS = 64;
+
+// Outputs of the transactions that fill the coin pool
+static const unsigned int CHAIN_SPLIT_OUTPUTS = 100;
+
+// An output the generator can spend
+struct ChainCoin
+{
+    COutPoint prevout;
+    int64_t nValue;
+    CScript scriptPubKey;
+    int nHeightSpendable; // first height whose block may spend it
+    unsigned int nTimeBlock; // time of the block that created it
+};
+
+// A stake output and what the kernel check reads about it, loaded once
+// its block is on the main chain
+struct ChainStake
+{
+    ChainCoin coin;
+    bool fLoaded;
+    CBlock blockFrom;
+    CTransaction txPrev;
+    unsigned int nTxPrevOffset;
+};
+
+// The coins one branch of the chain can spend. Transactions take pool coins
+// from the front and put their outputs at the back, so every block spends
+// coins from earlier blocks.
+struct ChainWallet
+{
+    std::deque<ChainCoin> vPool;
+    std::vector<ChainStake> vStake;
+};
+
+class ChainGenerator
+{
+public:
+    ChainGenerator(int nTxsIn, int nInputsIn, int nP2SHPercentIn, unsigned int nPoolSizeIn);
+
+    // Builds a valid block on top of pindexPrev from the wallet's coins
+    bool MakeBlock(ChainWallet& wallet, CBlockIndex* pindexPrev, CBlock& block);
+
+private:
+    int nTxs;
+    int nInputs;
+    int nP2SHPercent;
+    unsigned int nPoolSize;
+    unsigned int nOutputs;
+
+    // Key 0 stakes and signs blocks, keys 1 to 3 back the 2-of-3 multisig
+    // and the others receive pay-to-pubkey-hash outputs
+    CBasicKeyStore keystore;
+    std::vector<CKey> vKey;
+    CScript scriptRedeem;
+
+    CScript NextScript();
+    bool FindKernel(ChainWallet& wallet, int nHeight, unsigned int nBits, unsigned int& nTime, unsigned int& nStake);
+    void AddTransactions(ChainWallet& wallet, CBlock& block, int nHeight, int64_t& nFees);
+    bool SignTransaction(CTransaction& tx, const std::vector<ChainCoin>& vCoins);
+};
+
+ChainGenerator::ChainGenerator(int nTxsIn, int nInputsIn, int nP2SHPercentIn, unsigned int nPoolSizeIn) :
+    nTxs(nTxsIn), nInputs(nInputsIn), nP2SHPercent(nP2SHPercentIn), nPoolSize(nPoolSizeIn), nOutputs(0)
+{
+    // Fixed secrets, so that every run builds the same chain up to the
+    // signatures' random nonces
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        CSecret vchSecret(32, 0);
+        vchSecret[31] = (unsigned char)(i + 1);
+        CKey key;
+        key.SetSecret(vchSecret, true);
+        keystore.AddKey(key);
+        vKey.push_back(key);
+    }
+    std::vector<CKey> vMultisig(vKey.begin() + 1, vKey.begin() + 4);
+    scriptRedeem.SetMultisig(2, vMultisig);
+    keystore.AddCScript(scriptRedeem);
+}
+
+// -p2sh percent of the outputs are multisig behind pay-to-script-hash
+CScript ChainGenerator::NextScript()
+{
+    CScript script;
+    unsigned int n = nOutputs++;
+    if ((int)(n % 100) < nP2SHPercent)
+        script.SetDestination(scriptRedeem.GetID());
+    else
+        script.SetDestination(vKey[4 + n % 4].GetPubKey().GetID());
+    return script;
+}
+
+bool ChainGenerator::SignTransaction(CTransaction& tx, const std::vector<ChainCoin>& vCoins)
+{
+    CSignatureHasher hasher(tx);
+    for (unsigned int i = 0; i < vCoins.size(); i++)
+        if (!SignSignature(keystore, vCoins[i].scriptPubKey, tx, i, SIGHASH_ALL, &hasher))
+            return false;
+    return true;
+}
+
+// First second from nTime on at which one of the stake outputs meets the
+// target, checked the way CheckProofOfStake does
+bool ChainGenerator::FindKernel(ChainWallet& wallet, int nHeight, unsigned int nBits, unsigned int& nTime, unsigned int& nStake)
+{
+    CTxDB txdb("r");
+    for (unsigned int nTry = 0; nTry < 24 * 60 * 60; nTry++, nTime++)
+    {
+        for (nStake = 0; nStake < wallet.vStake.size(); nStake++)
+        {
+            ChainStake& stake = wallet.vStake[nStake];
+            if (stake.coin.nHeightSpendable > nHeight || stake.coin.nTimeBlock + nStakeMinAge > nTime)
+                continue;
+            if (!stake.fLoaded)
+            {
+                // Outputs created on a side branch cannot stake on it
+                CTxIndex txindex;
+                if (!stake.txPrev.ReadFromDisk(txdb, stake.coin.prevout, txindex) ||
+                    !stake.blockFrom.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
+                {
+                    stake.coin.nHeightSpendable = std::numeric_limits<int>::max();
+                    continue;
+                }
+                stake.nTxPrevOffset = txindex.pos.nTxPos - txindex.pos.nBlockPos;
+                stake.fLoaded = true;
+            }
+
+            unsigned int nTimeTx = nTime;
+            uint256 hashProofOfStake;
+            if (CheckStakeKernelHash(nBits, stake.blockFrom, stake.nTxPrevOffset, stake.txPrev, stake.coin.prevout,
+                                     nTimeTx, 0, true, hashProofOfStake))
+                return true;
+        }
+    }
+    return false;
+}
+
+void ChainGenerator::AddTransactions(ChainWallet& wallet, CBlock& block, int nHeight, int64_t& nFees)
+{
+    unsigned int nBlockSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    unsigned int nBlockSigOps = 0;
+    for (int i = 0; i < nTxs || wallet.vStake.empty(); i++)
+    {
+        // The pool grows to its size through transactions that split one
+        // coin, then every transaction spends -inputs coins into as many
+        bool fSplit = wallet.vStake.empty() || wallet.vPool.size() < nPoolSize;
+        unsigned int nIn = fSplit ? 1 : nInputs;
+        if (wallet.vPool.size() < nIn)
+            break;
+        std::vector<ChainCoin> vCoins(wallet.vPool.begin(), wallet.vPool.begin() + nIn);
+
+        CTransaction tx;
+        tx.nTime = block.nTime;
+        int64_t nValueIn = 0;
+        for (unsigned int j = 0; j < nIn; j++)
+        {
+            if (vCoins[j].nHeightSpendable > nHeight)
+                return;
+            tx.vin.push_back(CTxIn(vCoins[j].prevout));
+            nValueIn += vCoins[j].nValue;
+        }
+        int64_t nValueOut = nValueIn - CHAIN_TX_FEE;
+
+        // The premine first goes to the stake outputs
+        unsigned int nStakeOutputs = 0;
+        if (wallet.vStake.empty())
+        {
+            CScript scriptStake;
+            scriptStake.SetDestination(vKey[0].GetPubKey().GetID());
+            int64_t nStakeValue = nValueOut / 10 * 9 / CHAIN_STAKE_OUTPUTS;
+            for (nStakeOutputs = 0; nStakeOutputs < CHAIN_STAKE_OUTPUTS; nStakeOutputs++)
+                tx.vout.push_back(CTxOut(nStakeValue, scriptStake));
+            nValueOut -= nStakeValue * CHAIN_STAKE_OUTPUTS;
+        }
+
+        unsigned int nOut = fSplit ? CHAIN_SPLIT_OUTPUTS : nIn;
+        if (nValueOut < (int64_t)nOut * CENT)
+            nOut = 1;
+        for (unsigned int j = 0; j < nOut; j++)
+        {
+            int64_t nValue = nValueOut / nOut;
+            if (j == nOut - 1)
+                nValue = nValueOut - nValue * (nOut - 1);
+            tx.vout.push_back(CTxOut(nValue, NextScript()));
+        }
+
+        if (!SignTransaction(tx, vCoins))
+            return;
+
+        unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        unsigned int nTxSigOps = tx.GetLegacySigOpCount() + 3 * nIn; // at most three per multisig input
+        if (nBlockSize + nTxSize >= MAX_BLOCK_SIZE_GEN || nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS / 2)
+            return;
+        nBlockSize += nTxSize;
+        nBlockSigOps += nTxSigOps;
+        nFees += CHAIN_TX_FEE;
+        block.vtx.push_back(tx);
+
+        wallet.vPool.erase(wallet.vPool.begin(), wallet.vPool.begin() + nIn);
+        uint256 hashTx = tx.GetHash();
+        for (unsigned int j = 0; j < tx.vout.size(); j++)
+        {
+            ChainCoin coin;
+            coin.prevout = COutPoint(hashTx, j);
+            coin.nValue = tx.vout[j].nValue;
+            coin.scriptPubKey = tx.vout[j].scriptPubKey;
+            coin.nHeightSpendable = nHeight + 1;
+            coin.nTimeBlock = block.nTime;
+            if (j < nStakeOutputs)
+            {
+                ChainStake stake;
+                stake.coin = coin;
+                stake.fLoaded = false;
+                stake.nTxPrevOffset = 0;
+                wallet.vStake.push_back(stake);
+            }
+            else
+                wallet.vPool.push_back(coin);
+        }
+    }
+}
+
+bool ChainGenerator::MakeBlock(ChainWallet& wallet, CBlockIndex* pindexPrev, CBlock& block)
+{
+    int nHeight = pindexPrev->nHeight + 1;
+    bool fProofOfStake = nHeight >= MODIFIER_INTERVAL_SWITCH;
+    CScript scriptBlockKey;
+    scriptBlockKey << vKey[0].GetPubKey() << OP_CHECKSIG;
+
+    block.SetNull();
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nBits = GetNextTargetRequired(pindexPrev, fProofOfStake);
+    block.nTime = pindexPrev->nTime + CHAIN_BLOCK_SPACING;
+
+    CTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    block.vtx.push_back(txCoinBase);
+
+    if (fProofOfStake)
+    {
+        unsigned int nStake;
+        if (!FindKernel(wallet, nHeight, block.nBits, block.nTime, nStake))
+            return error("MakeBlock() : no kernel found for height %d", nHeight);
+        ChainStake stake = wallet.vStake[nStake];
+        wallet.vStake.erase(wallet.vStake.begin() + nStake);
+
+        CTransaction txCoinStake;
+        txCoinStake.nTime = block.nTime;
+        txCoinStake.vin.push_back(CTxIn(stake.coin.prevout));
+        txCoinStake.vout.resize(2);
+        txCoinStake.vout[0].SetEmpty();
+        txCoinStake.vout[1].scriptPubKey = scriptBlockKey;
+
+        CTxDB txdb("r");
+        uint64_t nCoinAge;
+        if (!txCoinStake.GetCoinAge(txdb, nCoinAge))
+            return error("MakeBlock() : unable to get coin age for coinstake");
+        txCoinStake.vout[1].nValue = stake.coin.nValue +
+            GetProofOfStakeReward(nCoinAge, block.nBits, block.nTime, 0, stake.coin.nValue, block.hashPrevBlock);
+        if (!SignTransaction(txCoinStake, std::vector<ChainCoin>(1, stake.coin)))
+            return error("MakeBlock() : unable to sign coinstake");
+        block.vtx.push_back(txCoinStake);
+
+        stake.coin.prevout = COutPoint(txCoinStake.GetHash(), 1);
+        stake.coin.nValue = txCoinStake.vout[1].nValue;
+        stake.coin.scriptPubKey = scriptBlockKey;
+        stake.coin.nHeightSpendable = nHeight + nCoinbaseMaturity + 1;
+        stake.coin.nTimeBlock = block.nTime;
+        stake.fLoaded = false;
+        wallet.vStake.push_back(stake);
+    }
+
+    int64_t nFees = 0;
+    AddTransactions(wallet, block, nHeight, nFees);
+
+    CTransaction& txNew = block.vtx[0];
+    txNew.nTime = block.nTime;
+    if (fProofOfStake)
+    {
+        txNew.vout.resize(2);
+        txNew.vout[0].SetEmpty();
+        txNew.vout[1].SetEmpty();
+    }
+    else
+    {
+        txNew.vout.resize(1);
+        txNew.vout[0].nValue = GetProofOfWorkReward(pindexPrev->nHeight, nFees);
+        txNew.vout[0].scriptPubKey.SetDestination(vKey[0].GetPubKey().GetID());
+
+        // The premine (see GetProofOfWorkReward) funds the chain; the other
+        // proof-of-work rewards are left unspent
+        if (pindexPrev->nHeight == 2)
+        {
+            ChainCoin coin;
+            coin.prevout = COutPoint(txNew.GetHash(), 0);
+            coin.nValue = txNew.vout[0].nValue;
+            coin.scriptPubKey = txNew.vout[0].scriptPubKey;
+            coin.nHeightSpendable = nHeight + nCoinbaseMaturity + 1;
+            coin.nTimeBlock = block.nTime;
+            wallet.vPool.push_front(coin);
+        }
+    }
+
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    if (fProofOfStake && !vKey[0].Sign(block.GetHash(), block.vchBlockSig))
+        return error("MakeBlock() : unable to sign block");
+    return true;
+}
+
+// What ProcessBlock does with a block whose parent is known, except that
+// proof-of-work is not checked: the synthetic proof-of-work blocks are not
+// mined. Proof-of-stake blocks are checked in full.
+static bool ProcessSyntheticBlock(CBlock& block)
+{
+    if (!block.CheckBlock(false, true, true))
+        return error("ProcessSyntheticBlock() : CheckBlock FAILED");
+    block.fChecked = true;
+    if (!block.AcceptBlock())
+        return error("ProcessSyntheticBlock() : AcceptBlock FAILED");
+    return true;
+}
+
+struct ChainPhase
+{
+    const char* pszName;
+    int nBlocks;
+    int nTxs;
+    int nInputs;
+    int64_t nElapsed; // microseconds
+
+    ChainPhase(const char* pszNameIn) : pszName(pszNameIn), nBlocks(0), nTxs(0), nInputs(0), nElapsed(0) {}
+
+    void Add(const CBlock& block)
+    {
+        nBlocks++;
+        nTxs += block.vtx.size();
+        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+            if (!tx.IsCoinBase())
+                nInputs += tx.vin.size();
+    }
+
+    void Print() const
+    {
+        fprintf(stdout, "%s,%d,%d,%d,%" PRId64 ",%.1f,%.1f\n", pszName, nBlocks, nTxs, nInputs, nElapsed,
+                nBlocks ? (double)nElapsed / nBlocks : 0, nTxs ? (double)nElapsed / nTxs : 0);
+        fflush(stdout);
+    }
+};
+
+static bool RunChainBenchmark(int nBlocks, int nTxs, int nInputs, int nP2SHPercent, int nReorgDepth)
+{
+    LOCK(cs_main);
+
+    // Large enough that the main chain after the fork point and the
+    // competing branch spend different halves of it
+    unsigned int nPoolSize = (2 * nReorgDepth + 3) * nTxs * nInputs;
+    ChainGenerator generator(nTxs, nInputs, nP2SHPercent, nPoolSize);
+
+    fprintf(stdout, "# blocks=%d txs=%d inputs=%d p2sh=%d reorgdepth=%d\n",
+            nBlocks, nTxs, nInputs, nP2SHPercent, nReorgDepth);
+    fprintf(stdout, "# phase,blocks,txs,inputs,elapsed_us,us_per_block,us_per_tx\n");
+
+    // Blocks arriving one by one on top of the best chain, as in initial
+    // block download; generating and signing them is not timed
+    ChainPhase connect("connect");
+    ChainWallet wallet, walletFork;
+    CBlockIndex* pindexFork = NULL;
+    std::vector<CBlock> vDisconnect;
+    for (int nHeight = 1; nHeight <= nBlocks; nHeight++)
+    {
+        if (nHeight == nBlocks - nReorgDepth + 1)
+        {
+            pindexFork = pindexBest;
+            walletFork = wallet;
+            walletFork.vPool.erase(walletFork.vPool.begin(), walletFork.vPool.begin() + walletFork.vPool.size() / 2);
+        }
+
+        CBlock block;
+        if (!generator.MakeBlock(wallet, pindexBest, block))
+            return false;
+        SetMockTime(block.nTime);
+
+        int64_t nStart = GetTimeMicros();
+        if (!ProcessSyntheticBlock(block))
+            return error("RunChainBenchmark() : block %d rejected", nHeight);
+        connect.nElapsed += GetTimeMicros() - nStart;
+        connect.Add(block);
+
+        if (pindexFork)
+            vDisconnect.push_back(block);
+    }
+    connect.Print();
+
+    // A competing branch from -reorgdepth blocks back; its blocks are stored
+    // as a side branch until the last one outweighs the main chain
+    ChainPhase sidebranch("sidebranch");
+    ChainPhase reorg("reorg");
+    CBlockIndex* pindexPrev = pindexFork;
+    for (int i = 0; i <= nReorgDepth; i++)
+    {
+        CBlock block;
+        if (!generator.MakeBlock(walletFork, pindexPrev, block))
+            return false;
+        if (block.nTime > GetAdjustedTime())
+            SetMockTime(block.nTime);
+
+        bool fReorg = (i == nReorgDepth);
+        int64_t nStart = GetTimeMicros();
+        if (!ProcessSyntheticBlock(block))
+            return error("RunChainBenchmark() : competing block %d rejected", i + 1);
+        int64_t nElapsed = GetTimeMicros() - nStart;
+
+        if (fReorg)
+            reorg.nElapsed += nElapsed;
+        else
+        {
+            sidebranch.nElapsed += nElapsed;
+            sidebranch.Add(block);
+        }
+        // The reorganization connects the whole branch
+        reorg.Add(block);
+
+        pindexPrev = mapBlockIndex[block.GetHash()];
+    }
+    BOOST_FOREACH(const CBlock& block, vDisconnect)
+        reorg.Add(block);
+    if (pindexBest != pindexPrev)
+        return error("RunChainBenchmark() : competing branch did not become the best chain");
+    sidebranch.Print();
+    reorg.Print();
+
+    // The disconnected transactions again, with the input checks that
+    // Reorganize() skips when it resurrects them
+    mempool.clear();
+    ChainPhase accept("mempool");
+    int nRejected = 0;
+    CTxDB txdb("r");
+    BOOST_FOREACH(const CBlock& block, vDisconnect)
+    {
+        accept.nBlocks++;
+        BOOST_FOREACH(CTransaction tx, block.vtx)
+        {
+            if (tx.IsCoinBase() || tx.IsCoinStake())
+                continue;
+            int64_t nStart = GetTimeMicros();
+            bool fAccepted = tx.AcceptToMemoryPool(txdb, true);
+            accept.nElapsed += GetTimeMicros() - nStart;
+            accept.nTxs++;
+            accept.nInputs += tx.vin.size();
+            if (!fAccepted)
+                nRejected++;
+        }
+    }
+    accept.Print();
+    if (nRejected)
+        fprintf(stdout, "# mempool: %d transactions rejected\n", nRejected);
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("--help"))
+    {
+        fprintf(stdout,
+            "Usage: bench_chain [options]\n"
+            "Generates a synthetic chain on testnet rules in a temporary data directory and\n"
+            "times connecting it, a reorganization and re-accepting the disconnected\n"
+            "transactions to the memory pool. Prints one CSV line per phase:\n"
+            "  phase,blocks,txs,inputs,elapsed_us,us_per_block,us_per_tx\n"
+            "Options:\n"
+            "  -blocks=<n>      Length of the chain (default: 300)\n"
+            "  -txs=<n>         Transactions per block besides coinbase and coinstake (default: 100)\n"
+            "  -inputs=<n>      Inputs per transaction (default: 2)\n"
+            "  -p2sh=<pct>      Percentage of 2-of-3 multisig pay-to-script-hash outputs (default: 20)\n"
+            "  -reorgdepth=<n>  Blocks disconnected by the reorganization (default: 10)\n"
+            "  -printtoconsole  Send the node's log output to the console\n");
+        return 0;
+    }
+
+    int nBlocks = GetArg("-blocks", 300);
+    int nTxs = GetArg("-txs", 100);
+    int nInputs = GetArg("-inputs", 2);
+    int nP2SHPercent = GetArg("-p2sh", 20);
+    int nReorgDepth = GetArg("-reorgdepth", 10);
+    if (nTxs < 0 || nInputs < 1 || nInputs > 100 || nP2SHPercent < 0 || nP2SHPercent > 100 || nReorgDepth < 1)
+    {
+        fprintf(stderr, "Error: -txs, -inputs (1 to 100), -p2sh (0 to 100) or -reorgdepth (at least 1) out of range\n");
+        return 1;
+    }
+    // Only proof-of-stake blocks are reorganized, as proof-of-work would be
+    // checked when they are read back from disk
+    if (nBlocks - nReorgDepth < MODIFIER_INTERVAL_SWITCH)
+    {
+        fprintf(stderr, "Error: -blocks must be at least %d more than -reorgdepth\n", MODIFIER_INTERVAL_SWITCH);
+        return 1;
+    }
+
+    fPrintToConsole = GetBoolArg("-printtoconsole");
+    fPrintToDebugger = true; // don't want to write to debug.log file
+    noui_connect();
+
+    // Testnet has no hardened checkpoints past its genesis block and
+    // verifies every signature
+    fTestNet = true;
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() /
+                                       boost::filesystem::unique_path("bench_chain_%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    bool fOk = false;
+    try
+    {
+        bitdb.MakeMock();
+        CTxDB::MakeMock();
+        if (LoadBlockIndex(true))
+            fOk = RunChainBenchmark(nBlocks, nTxs, nInputs, nP2SHPercent, nReorgDepth);
+        CTxDB().Close();
+    }
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "Error: %s\n", e.what());
+        fOk = false;
+    }
+    boost::filesystem::remove_all(pathTemp);
+
+    if (!fOk)
+        fprintf(stderr, "Error: benchmark failed, rerun with -printtoconsole for details\n");
+    return fOk ? 0 : 1;
+}
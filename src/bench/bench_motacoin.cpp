@@ -0,0 +1,42 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include <stdio.h>
+
+#include "util.h"
+
+extern void noui_connect();
+
+int main(int argc, char* argv[])
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("--help"))
+    {
+        fprintf(stdout,
+            "Usage: bench_motacoin [options]\n"
+            "Runs micro-benchmarks and prints one CSV line per benchmark:\n"
+            "  name,iterations,elapsed_us,ns_per_op,ops_per_s,min_ns_per_op,max_ns_per_op\n"
+            "Options:\n"
+            "  -filter=<str>  Only run benchmarks whose name contains <str>\n"
+            "  -time=<ms>     Time to spend on each benchmark (default: 1000)\n"
+            "  -list          List the benchmarks and exit\n");
+        return 0;
+    }
+
+    fPrintToDebugger = true; // don't want to write to debug.log file
+    noui_connect();
+
+    // Time signature checks, not signature cache hits
+    SoftSetArg("-maxsigcachesize", "0");
+
+    if (mapArgs.count("-list"))
+    {
+        benchmark::BenchRunner::List();
+        return 0;
+    }
+
+    benchmark::BenchRunner::RunAll(GetArg("-filter", ""), std::max(GetArg("-time", 1000), (int64_t)1) * 1000);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "bloom.h"
+#include "main.h"
+
+// A full-looking block: a coinbase and nTx - 1 transactions with two
+// pay-to-pubkey-hash inputs and two outputs each, with signature and key
+// sized script data filled from a counter
+static void MakeBlock(CBlock& block, unsigned int nTx)
+{
+    unsigned int nCounter = 0;
+    block.SetNull();
+    block.nVersion = 7;
+    block.nTime = 1420070400;
+    block.nBits = 0x1e0fffff;
+    block.vtx.resize(nTx);
+    for (unsigned int i = 0; i < nTx; i++)
+    {
+        CTransaction& tx = block.vtx[i];
+        tx.nTime = block.nTime;
+        tx.vin.resize(i == 0 ? 1 : 2);
+        tx.vout.resize(2);
+        for (unsigned int j = 0; j < tx.vin.size(); j++)
+        {
+            std::vector<unsigned char> vchSig(72), vchPubKey(33);
+            for (unsigned int k = 0; k < vchSig.size(); k++)
+                vchSig[k] = (unsigned char)(nCounter++ * 167);
+            for (unsigned int k = 0; k < vchPubKey.size(); k++)
+                vchPubKey[k] = (unsigned char)(nCounter++ * 89);
+            if (i == 0)
+                tx.vin[j].prevout.SetNull();
+            else
+                tx.vin[j].prevout = COutPoint(Hash(BEGIN(nCounter), END(nCounter)), j);
+            tx.vin[j].scriptSig << vchSig << vchPubKey;
+        }
+        for (unsigned int j = 0; j < tx.vout.size(); j++)
+        {
+            uint160 hash160 = Hash160(std::vector<unsigned char>(BEGIN(nCounter), END(nCounter)));
+            nCounter++;
+            tx.vout[j].nValue = (i + 1) * COIN + j;
+            tx.vout[j].scriptPubKey << OP_DUP << OP_HASH160 << hash160 << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+    }
+    block.hashMerkleRoot = block.BuildMerkleTree();
+}
+
+// Includes hashing every transaction, as CheckBlock does
+static void BuildMerkleTree_500Tx(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 500);
+    uint256 hash;
+    while (state.KeepRunning())
+        hash ^= block.BuildMerkleTree();
+}
+
+// Filtering block transactions for an SPV peer whose filter matches none
+// of them; one operation is one transaction
+static void CBloomFilter_IsRelevantAndUpdate(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 500);
+    CBloomFilter filter(1000, 0.0001, 0, BLOOM_UPDATE_ALL);
+    for (unsigned int i = 0; i < 100; i++)
+        filter.insert(Hash(BEGIN(i), END(i)));
+    std::vector<uint256> vHash;
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        vHash.push_back(block.GetTxHash(i));
+
+    unsigned int i = 0;
+    int nFound = 0;
+    while (state.KeepRunning())
+    {
+        nFound += filter.IsRelevantAndUpdate(block.vtx[i], vHash[i]);
+        if (++i == block.vtx.size())
+            i = 0;
+    }
+}
+
+static void CDataStream_SerializeBlock(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 500);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning())
+    {
+        ss.clear();
+        ss << block;
+    }
+}
+
+static void CDataStream_DeserializeBlock(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 500);
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    while (state.KeepRunning())
+    {
+        CDataStream ss(ssBlock.begin(), ssBlock.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock blockRead;
+        ss >> blockRead;
+    }
+}
+
+static void CDataStream_SerializeTx(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 2);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning())
+    {
+        ss.clear();
+        ss << block.vtx[1];
+    }
+}
+
+static void CDataStream_DeserializeTx(benchmark::State& state)
+{
+    CBlock block;
+    MakeBlock(block, 2);
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+    ssTx << block.vtx[1];
+    while (state.KeepRunning())
+    {
+        CDataStream ss(ssTx.begin(), ssTx.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        ss >> tx;
+    }
+}
+
+BENCHMARK(BuildMerkleTree_500Tx);
+BENCHMARK(CBloomFilter_IsRelevantAndUpdate);
+BENCHMARK(CDataStream_SerializeBlock);
+BENCHMARK(CDataStream_DeserializeBlock);
+BENCHMARK(CDataStream_SerializeTx);
+BENCHMARK(CDataStream_DeserializeTx);
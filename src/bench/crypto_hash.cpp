@@ -0,0 +1,169 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "hashblock.h"
+#include "kernel.h"
+#include "main.h"
+#include "scrypt.h"
+#include "util.h"
+
+// Each stage feeds its output back in as the next input, so that the
+// compiler cannot hoist the hash out of the loop
+
+// Block header hash over the 80 serialized header bytes
+static void Hash9_80Bytes(benchmark::State& state)
+{
+    unsigned char header[80] = {};
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        hash = Hash9(header, header + sizeof(header));
+        memcpy(header + 4, hash.begin(), 32);
+    }
+}
+
+// The thirteen primitives chained by Hash9, one at a time, each on the
+// 64-byte output of the previous stage as in Hash9 itself
+#define X13_PRIMITIVE(algo)                                             \
+static void X13_##algo(benchmark::State& state)                        \
+{                                                                       \
+    sph_##algo##512_context ctx;                                        \
+    uint512 hash;                                                       \
+    while (state.KeepRunning())                                         \
+    {                                                                   \
+        sph_##algo##512_init(&ctx);                                     \
+        sph_##algo##512(&ctx, static_cast<const void*>(&hash), 64);     \
+        sph_##algo##512_close(&ctx, static_cast<void*>(&hash));         \
+    }                                                                   \
+}                                                                       \
+BENCHMARK(X13_##algo);
+
+X13_PRIMITIVE(blake)
+X13_PRIMITIVE(bmw)
+X13_PRIMITIVE(groestl)
+X13_PRIMITIVE(skein)
+X13_PRIMITIVE(jh)
+X13_PRIMITIVE(keccak)
+X13_PRIMITIVE(luffa)
+X13_PRIMITIVE(cubehash)
+X13_PRIMITIVE(shavite)
+X13_PRIMITIVE(simd)
+X13_PRIMITIVE(echo)
+X13_PRIMITIVE(hamsi)
+X13_PRIMITIVE(fugue)
+
+// Double SHA-256 as used for transaction ids, over a typical 250 byte
+// transaction and over a 32 byte hash
+static void SHA256D_250Bytes(benchmark::State& state)
+{
+    unsigned char data[250] = {};
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        hash = Hash(data, data + sizeof(data));
+        memcpy(data, hash.begin(), 32);
+    }
+}
+
+static void SHA256D_32Bytes(benchmark::State& state)
+{
+    uint256 hash;
+    while (state.KeepRunning())
+        hash = Hash(hash.begin(), hash.end());
+}
+
+// Wallet passphrase key derivation; the wallet calibrates the number of
+// rounds to the time one takes, so a few rounds give the per-round cost
+static void ScryptSaltedMultiround_4Rounds(benchmark::State& state)
+{
+    std::string strPassphrase = "correct horse battery staple";
+    unsigned char chSalt[8] = { 0x1b, 0xad, 0xb0, 0x0c, 0x2e, 0x5a, 0x17, 0x42 };
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        hash = scrypt_salted_multiround_hash(strPassphrase.data(), strPassphrase.size(), chSalt, sizeof(chSalt), 4);
+        chSalt[0] ^= hash.begin()[0];
+    }
+}
+
+// Serialize-then-hash against streaming the serialization into the hasher
+// as SerializeHash does, for a transaction with two pay-to-pubkey-hash
+// inputs and outputs and for the stake kernel hash
+static void MakeTransaction(CTransaction& tx)
+{
+    tx.nTime = 1420070400;
+    tx.vin.resize(2);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        tx.vin[i].prevout = COutPoint(Hash(BEGIN(i), END(i)), i);
+        tx.vin[i].scriptSig << std::vector<unsigned char>(72, 0x30 + i) << std::vector<unsigned char>(33, 0x02);
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey << OP_DUP << OP_HASH160 << uint160(i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+}
+
+static void TxHash_HashWriter(benchmark::State& state)
+{
+    CTransaction tx;
+    MakeTransaction(tx);
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        hash ^= tx.GetHash();
+        tx.nLockTime++;
+    }
+}
+
+static void TxHash_DataStream(benchmark::State& state)
+{
+    CTransaction tx;
+    MakeTransaction(tx);
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        CDataStream ss(SER_GETHASH, 0);
+        ss << tx;
+        hash ^= Hash(ss.begin(), ss.end());
+        tx.nLockTime++;
+    }
+}
+
+// The kernel search hashes the stake modifier once and continues from a
+// copy of that state for every candidate time, as CheckStakeKernelHash does
+static void StakeHash_HashWriter(benchmark::State& state)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << (uint64_t)0x0123456789abcdefULL;
+    unsigned int nTimeTx = 1420070400;
+    uint256 hash;
+    while (state.KeepRunning())
+        hash ^= stakeHash(nTimeTx++, 1420000000, ss, 0, 81, 1420000000);
+}
+
+static uint256 StakeHashDataStream(unsigned int nTimeTx, unsigned int nTxPrevTime, CDataStream ss, unsigned int prevoutIndex, unsigned int nTxPrevOffset, unsigned int nTimeBlockFrom)
+{
+    ss << nTimeBlockFrom << nTxPrevOffset << nTxPrevTime << prevoutIndex << nTimeTx;
+    return Hash(ss.begin(), ss.end());
+}
+
+static void StakeHash_DataStream(benchmark::State& state)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << (uint64_t)0x0123456789abcdefULL;
+    unsigned int nTimeTx = 1420070400;
+    uint256 hash;
+    while (state.KeepRunning())
+        hash ^= StakeHashDataStream(nTimeTx++, 1420000000, ss, 0, 81, 1420000000);
+}
+
+BENCHMARK(Hash9_80Bytes);
+BENCHMARK(SHA256D_250Bytes);
+BENCHMARK(SHA256D_32Bytes);
+BENCHMARK(ScryptSaltedMultiround_4Rounds);
+BENCHMARK(TxHash_HashWriter);
+BENCHMARK(TxHash_DataStream);
+BENCHMARK(StakeHash_HashWriter);
+BENCHMARK(StakeHash_DataStream);
@@ -0,0 +1,72 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "json/json_spirit_reader_template.h"
+
+#include "rpcjson.h"
+#include "util.h"
+
+using namespace json_spirit;
+
+// A sendmany to 50 addresses
+static std::string SendManyRequest()
+{
+    std::string str = "{\"method\":\"sendmany\",\"params\":[\"\",{";
+    for (int i = 0; i < 50; i++)
+        str += strprintf("%s\"MotaAddr%026d\":%d.%08d", i ? "," : "", i, i % 7, i * 1234567 % 100000000);
+    str += "},1,\"payroll\"],\"id\":1}";
+    return str;
+}
+
+// A signrawtransaction of a 500 byte transaction with ten P2SH prevouts
+static std::string SignRawTransactionRequest()
+{
+    std::string strTx;
+    for (int i = 0; i < 1000; i++)
+        strTx += strprintf("%02x", (i * 37) & 0xff);
+    std::string str = "{\"method\":\"signrawtransaction\",\"params\":[\"" + strTx + "\",[";
+    for (int i = 0; i < 10; i++)
+        str += strprintf("%s{\"txid\":\"%064x\",\"vout\":%d,\"scriptPubKey\":\"76a914%040x88ac\","
+                         "\"redeemScript\":\"5221%066x21%066x52ae\"}", i ? "," : "", i, i, i, i, i + 1);
+    str += "],[\"PrivKey1\",\"PrivKey2\"],\"ALL\"],\"id\":\"curltest\"}";
+    return str;
+}
+
+static void JSONSpirit_SendMany(benchmark::State& state)
+{
+    std::string str = SendManyRequest();
+    Value v;
+    while (state.KeepRunning())
+        read_string(str, v);
+}
+
+static void ParseJSON_SendMany(benchmark::State& state)
+{
+    std::string str = SendManyRequest();
+    Value v;
+    while (state.KeepRunning())
+        ParseJSON(str, v);
+}
+
+static void JSONSpirit_SignRawTransaction(benchmark::State& state)
+{
+    std::string str = SignRawTransactionRequest();
+    Value v;
+    while (state.KeepRunning())
+        read_string(str, v);
+}
+
+static void ParseJSON_SignRawTransaction(benchmark::State& state)
+{
+    std::string str = SignRawTransactionRequest();
+    Value v;
+    while (state.KeepRunning())
+        ParseJSON(str, v);
+}
+
+BENCHMARK(JSONSpirit_SendMany);
+BENCHMARK(ParseJSON_SendMany);
+BENCHMARK(JSONSpirit_SignRawTransaction);
+BENCHMARK(ParseJSON_SignRawTransaction);
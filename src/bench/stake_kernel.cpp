@@ -0,0 +1,89 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "kernel.h"
+#include "main.h"
+
+// A staked output in a block that is followed by enough indexed blocks for
+// GetKernelStakeModifier to find the modifier a selection interval later,
+// linked into mapBlockIndex the way AddToBlockIndex does it
+struct StakeSetup
+{
+    CBlock blockFrom;
+    CTransaction txPrev;
+    COutPoint prevout;
+    unsigned int nTxPrevOffset;
+    unsigned int nTimeTx;
+    unsigned int nBits;
+
+    StakeSetup()
+    {
+        blockFrom.nVersion = 1;
+        blockFrom.nTime = 1420070400;
+        blockFrom.nBits = 0x1e0fffff;
+        txPrev.nTime = blockFrom.nTime;
+        txPrev.vin.resize(1);
+        txPrev.vout.resize(1);
+        txPrev.vout[0].nValue = 1000 * COIN;
+        blockFrom.vtx.push_back(txPrev);
+        blockFrom.hashMerkleRoot = blockFrom.BuildMerkleTree();
+        prevout = COutPoint(txPrev.GetHash(), 0);
+        nTxPrevOffset = 81;
+
+        // Hard enough that no kernel meets it, so the search runs in full
+        nBits = 0x1b00ffff;
+        nTimeTx = blockFrom.nTime + 10 * 24 * 60 * 60;
+
+        static bool fChainBuilt = false;
+        if (fChainBuilt)
+            return;
+        fChainBuilt = true;
+
+        uint256 hash = blockFrom.GetHash();
+        CBlockIndex* pindexPrev = NewBlockIndex(0, 0, blockFrom);
+        pindexPrev->phashBlock = &mapBlockIndex.insert(std::make_pair(hash, pindexPrev)).first->first;
+        // One block per modifier interval, running well past the selection
+        // interval of about 35 modifier intervals
+        for (int i = 1; i <= 100; i++)
+        {
+            CBlockIndex* pindex = NewBlockIndex();
+            pindex->nHeight = i;
+            pindex->nTime = blockFrom.nTime + i * nModifierInterval;
+            pindex->SetStakeModifier(0x0123456789abcdefULL * i, true);
+            pindex->pprev = pindexPrev;
+            pindexPrev->pnext = pindex;
+            pindexPrev = pindex;
+        }
+    }
+};
+
+// Verifying a received coinstake's kernel
+static void CheckStakeKernelHash_Check(benchmark::State& state)
+{
+    StakeSetup setup;
+    uint256 hashProofOfStake;
+    while (state.KeepRunning())
+    {
+        unsigned int nTimeTx = setup.nTimeTx;
+        CheckStakeKernelHash(setup.nBits, setup.blockFrom, setup.nTxPrevOffset, setup.txPrev, setup.prevout,
+                             nTimeTx, 0, true, hashProofOfStake);
+    }
+}
+
+// Searching one output for a kernel over the staker's default hash drift
+static void CheckStakeKernelHash_Search45(benchmark::State& state)
+{
+    StakeSetup setup;
+    uint256 hashProofOfStake;
+    while (state.KeepRunning())
+    {
+        unsigned int nTimeTx = setup.nTimeTx;
+        CheckStakeKernelHash(setup.nBits, setup.blockFrom, setup.nTxPrevOffset, setup.txPrev, setup.prevout,
+                             nTimeTx, 45, false, hashProofOfStake);
+    }
+}
+
+BENCHMARK(CheckStakeKernelHash_Check);
+BENCHMARK(CheckStakeKernelHash_Search45);
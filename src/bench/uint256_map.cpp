@@ -0,0 +1,46 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "hash.h"
+#include "util.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Lookups of random keys in a map of 100000 random uint256 keys, ordered
+// and hashed with the salted SipHash hasher, cycling through the keys
+template<typename Map>
+static void MapLookups(benchmark::State& state)
+{
+    std::vector<uint256> vKeys(100000);
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        vKeys[i] = GetRandHash();
+    Map m;
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        m.insert(std::make_pair(vKeys[i], i));
+
+    unsigned int i = 0;
+    unsigned int nFound = 0;
+    while (state.KeepRunning())
+    {
+        nFound += m.count(vKeys[i]);
+        if (++i == vKeys.size())
+            i = 0;
+    }
+}
+
+static void Uint256Map_Lookup(benchmark::State& state)
+{
+    MapLookups<std::map<uint256, unsigned int> >(state);
+}
+
+static void Uint256UnorderedMap_Lookup(benchmark::State& state)
+{
+    MapLookups<std::unordered_map<uint256, unsigned int, CSaltedHasher> >(state);
+}
+
+BENCHMARK(Uint256Map_Lookup);
+BENCHMARK(Uint256UnorderedMap_Lookup);
@@ -0,0 +1,187 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "bench/bench.h"
+
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "script.h"
+
+// Internal to script.cpp
+extern bool CastToBool(const std::vector<unsigned char>& vch);
+extern bool CheckSig(std::vector<unsigned char> vchSig, std::vector<unsigned char> vchPubKey, CScript scriptCode,
+                     const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher);
+
+// A transaction spending a pay-to-pubkey-hash output (input 0) and a
+// pay-to-script-hash 2-of-3 multisig output (input 1), both signed
+struct SpendSetup
+{
+    CBasicKeyStore keystore;
+    CKey key[3];
+    CTransaction txFrom;
+    CTransaction txTo;
+    uint256 hashSig;
+    std::vector<unsigned char> vchSig; // DER signature of input 0, without the hash type byte
+
+    SpendSetup()
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            key[i].MakeNewKey(true);
+            keystore.AddKey(key[i]);
+        }
+        std::vector<CKey> keys(key, key + 3);
+        CScript redeemScript;
+        redeemScript.SetMultisig(2, keys);
+        keystore.AddCScript(redeemScript);
+
+        txFrom.vout.resize(2);
+        txFrom.vout[0].scriptPubKey.SetDestination(key[0].GetPubKey().GetID());
+        txFrom.vout[0].nValue = 10 * COIN;
+        txFrom.vout[1].scriptPubKey.SetDestination(redeemScript.GetID());
+        txFrom.vout[1].nValue = 10 * COIN;
+
+        txTo.vin.resize(2);
+        txTo.vout.resize(1);
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            txTo.vin[i].prevout.hash = txFrom.GetHash();
+            txTo.vin[i].prevout.n = i;
+        }
+        txTo.vout[0].scriptPubKey.SetDestination(key[1].GetPubKey().GetID());
+        txTo.vout[0].nValue = 20 * COIN - CENT;
+        for (unsigned int i = 0; i < 2; i++)
+            SignSignature(keystore, txFrom, txTo, i);
+
+        hashSig = SignatureHash(txFrom.vout[0].scriptPubKey, txTo, 0, SIGHASH_ALL);
+        key[0].Sign(hashSig, vchSig);
+    }
+};
+
+static void CKey_Verify(benchmark::State& state)
+{
+    SpendSetup setup;
+    int nValid = 0;
+    while (state.KeepRunning())
+        nValid += setup.key[0].Verify(setup.hashSig, setup.vchSig);
+    assert(nValid == (int)state.GetIterations());
+}
+
+static void CKey_VerifyOpenSSL(benchmark::State& state)
+{
+    SpendSetup setup;
+    int nValid = 0;
+    while (state.KeepRunning())
+        nValid += setup.key[0].VerifyOpenSSL(setup.hashSig, setup.vchSig);
+    assert(nValid == (int)state.GetIterations());
+}
+
+static void CPubKey_Verify(benchmark::State& state)
+{
+    SpendSetup setup;
+    CPubKey pubkey = setup.key[0].GetPubKey();
+    int nValid = 0;
+    while (state.KeepRunning())
+        nValid += pubkey.Verify(setup.hashSig, setup.vchSig);
+    assert(nValid == (int)state.GetIterations());
+}
+
+// Signature hash plus verification, as OP_CHECKSIG does it
+static void CheckSig_P2PKH(benchmark::State& state)
+{
+    SpendSetup setup;
+    std::vector<unsigned char> vchSig(setup.vchSig);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    std::vector<unsigned char> vchPubKey = setup.key[0].GetPubKey().Raw();
+    int nValid = 0;
+    while (state.KeepRunning())
+        nValid += CheckSig(vchSig, vchPubKey, setup.txFrom.vout[0].scriptPubKey, setup.txTo, 0, 0, NULL);
+    assert(nValid == (int)state.GetIterations());
+}
+
+static void EvalScript_P2PKH(benchmark::State& state)
+{
+    SpendSetup setup;
+    const CScript& scriptSig = setup.txTo.vin[0].scriptSig;
+    const CScript& scriptPubKey = setup.txFrom.vout[0].scriptPubKey;
+    int nValid = 0;
+    while (state.KeepRunning())
+    {
+        std::vector<std::vector<unsigned char> > stack;
+        nValid += EvalScript(stack, scriptSig, setup.txTo, 0, 0) &&
+                  EvalScript(stack, scriptPubKey, setup.txTo, 0, 0) &&
+                  !stack.empty() && CastToBool(stack.back());
+    }
+    assert(nValid == (int)state.GetIterations());
+}
+
+// Both scripts plus the serialized redeem script: two signature checks
+static void VerifyScript_P2SH_Multisig2of3(benchmark::State& state)
+{
+    SpendSetup setup;
+    int nValid = 0;
+    while (state.KeepRunning())
+        nValid += VerifyScript(setup.txTo.vin[1].scriptSig, setup.txFrom.vout[1].scriptPubKey, setup.txTo, 1, 0);
+    assert(nValid == (int)state.GetIterations());
+}
+
+static void SignatureHash_2Inputs(benchmark::State& state)
+{
+    SpendSetup setup;
+    const CScript& scriptCode = setup.txFrom.vout[0].scriptPubKey;
+    uint256 hash;
+    while (state.KeepRunning())
+        hash ^= SignatureHash(scriptCode, setup.txTo, 0, SIGHASH_ALL);
+}
+
+// One input of a 100-input consolidation, with and without reusing the
+// hashing state across the transaction's inputs
+static void MakeConsolidation(const SpendSetup& setup, CTransaction& tx)
+{
+    tx = setup.txTo;
+    tx.vin.resize(100, setup.txTo.vin[0]);
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+        tx.vin[i].prevout.n = i;
+}
+
+static void SignatureHash_100Inputs(benchmark::State& state)
+{
+    SpendSetup setup;
+    CTransaction tx;
+    MakeConsolidation(setup, tx);
+    const CScript& scriptCode = setup.txFrom.vout[0].scriptPubKey;
+    uint256 hash;
+    unsigned int nIn = 0;
+    while (state.KeepRunning())
+    {
+        hash ^= SignatureHash(scriptCode, tx, nIn, SIGHASH_ALL);
+        nIn = (nIn + 1) % tx.vin.size();
+    }
+}
+
+static void CSignatureHasher_100Inputs(benchmark::State& state)
+{
+    SpendSetup setup;
+    CTransaction tx;
+    MakeConsolidation(setup, tx);
+    const CScript& scriptCode = setup.txFrom.vout[0].scriptPubKey;
+    CSignatureHasher hasher(tx);
+    uint256 hash;
+    unsigned int nIn = 0;
+    while (state.KeepRunning())
+    {
+        hash ^= hasher.SignatureHash(scriptCode, nIn, SIGHASH_ALL);
+        nIn = (nIn + 1) % tx.vin.size();
+    }
+}
+
+BENCHMARK(CKey_Verify);
+BENCHMARK(CKey_VerifyOpenSSL);
+BENCHMARK(CPubKey_Verify);
+BENCHMARK(CheckSig_P2PKH);
+BENCHMARK(EvalScript_P2PKH);
+BENCHMARK(VerifyScript_P2SH_Multisig2of3);
+BENCHMARK(SignatureHash_2Inputs);
+BENCHMARK(SignatureHash_100Inputs);
+BENCHMARK(CSignatureHasher_100Inputs);
@@ -7,6 +7,7 @@
 #include "init.h"
 #include "util.h"
 #include "sync.h"
+#include "perfstats.h"
 #include "ui_interface.h"
 #include "base58.h"
 #include "bitcoinrpc.h"
@@ -49,6 +50,8 @@ void ThreadRPCServer3(void* parg);
 
 static inline unsigned short GetDefaultRPCPort()
 {
+    if (GetBoolArg("-regtest", false))
+        return 23621;
     return GetBoolArg("-testnet", false) ? 23521 : 17421;
 }
 
@@ -233,6 +236,172 @@ Value stop(const Array& params, bool fHelp)
     return "MotaCoin server stopping";
 }
 
+Value logging(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "logging [category] [level]\n"
+            "Sets the debug log level of a category (net, mempool, stake, db, rpc, or all)\n"
+            "to none, info or debug. Returns the level of every category.");
+
+    if (params.size() == 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Both category and level are required");
+    if (params.size() == 2)
+    {
+        string strCategory = params[0].get_str();
+        int nCategory = LogCategoryFromName(strCategory);
+        if (nCategory < 0 && strCategory != "all")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown category: " + strCategory);
+        int nLevel = LogLevelFromName(params[1].get_str());
+        if (nLevel < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown level: " + params[1].get_str());
+        for (int i = 0; i < LOG_CATEGORIES; i++)
+            if (nCategory < 0 || i == nCategory)
+                nLogLevel[i] = nLevel;
+    }
+
+    Object ret;
+    for (int i = 0; i < LOG_CATEGORIES; i++)
+        ret.push_back(Pair(LogCategoryName(i), LogLevelName(nLogLevel[i])));
+    return ret;
+}
+
+static Object PerfHistogramToJSON(const CPerfHistogram& histogram)
+{
+    Object ret;
+    ret.push_back(Pair("count", (boost::int64_t)histogram.nCount));
+    ret.push_back(Pair("totalmicros", (boost::int64_t)histogram.nTotalMicros));
+    ret.push_back(Pair("maxmicros", (boost::int64_t)histogram.nMaxMicros));
+    Object buckets;
+    for (int i = 0; i < PERF_HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram.vBucket[i] == 0)
+            continue;
+        int64_t nLimit = CPerfHistogram::BucketLimit(i);
+        string strBucket = nLimit < 0 ? strprintf(">%" PRId64, CPerfHistogram::BucketLimit(i - 1))
+                                      : strprintf("<=%" PRId64, nLimit);
+        buckets.push_back(Pair(strBucket, (boost::int64_t)histogram.vBucket[i]));
+    }
+    ret.push_back(Pair("histogram", buckets));
+    return ret;
+}
+
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats [reset=false]\n"
+            "Returns acquisition counts, wait and hold time histograms (in microseconds)\n"
+            "and the call sites that waited longest for each lock, ordered by total wait.\n"
+            "If reset is true the counters are cleared after being returned.\n"
+            "Only available in builds configured with LOCK_PROFILE.");
+
+#ifdef LOCK_PROFILE
+    std::map<string, CLockStats> mapStats;
+    GetLockProfile(mapStats);
+    if (params.size() > 0 && params[0].get_bool())
+        ResetLockProfile();
+
+    vector<pair<int64_t, string> > vSorted;
+    for (std::map<string, CLockStats>::iterator mi = mapStats.begin(); mi != mapStats.end(); ++mi)
+        if (mi->second.nAcquires > 0 || mi->second.nTryFailed > 0)
+            vSorted.push_back(make_pair(mi->second.wait.nTotalMicros, mi->first));
+    sort(vSorted.rbegin(), vSorted.rend());
+
+    Object ret;
+    BOOST_FOREACH(const PAIRTYPE(int64_t, string)& item, vSorted)
+    {
+        const CLockStats& stats = mapStats[item.second];
+        Object obj;
+        obj.push_back(Pair("acquires", (boost::int64_t)stats.nAcquires));
+        obj.push_back(Pair("recursive", (boost::int64_t)stats.nRecursive));
+        obj.push_back(Pair("contended", (boost::int64_t)stats.nContended));
+        obj.push_back(Pair("tryfailed", (boost::int64_t)stats.nTryFailed));
+        obj.push_back(Pair("wait", PerfHistogramToJSON(stats.wait)));
+        obj.push_back(Pair("hold", PerfHistogramToJSON(stats.hold)));
+
+        // A header's call site shows up once per translation unit that
+        // includes it, so merge them by name before ranking
+        std::map<string, CLockSiteStats> mapSites;
+        for (std::map<pair<const char*, int>, CLockSiteStats>::const_iterator si = stats.mapSites.begin(); si != stats.mapSites.end(); ++si)
+        {
+            CLockSiteStats& site = mapSites[strprintf("%s:%d", si->first.first, si->first.second)];
+            site.nContended += si->second.nContended;
+            site.nWaitMicros += si->second.nWaitMicros;
+            site.nMaxWaitMicros = max(site.nMaxWaitMicros, si->second.nMaxWaitMicros);
+        }
+        vector<pair<int64_t, string> > vSites;
+        for (std::map<string, CLockSiteStats>::iterator si = mapSites.begin(); si != mapSites.end(); ++si)
+            vSites.push_back(make_pair(si->second.nWaitMicros, si->first));
+        sort(vSites.rbegin(), vSites.rend());
+        if (vSites.size() > 10)
+            vSites.resize(10);
+
+        Array sites;
+        BOOST_FOREACH(const PAIRTYPE(int64_t, string)& site, vSites)
+        {
+            const CLockSiteStats& siteStats = mapSites[site.second];
+            Object siteObj;
+            siteObj.push_back(Pair("site", site.second));
+            siteObj.push_back(Pair("contended", (boost::int64_t)siteStats.nContended));
+            siteObj.push_back(Pair("waitmicros", (boost::int64_t)siteStats.nWaitMicros));
+            siteObj.push_back(Pair("maxwaitmicros", (boost::int64_t)siteStats.nMaxWaitMicros));
+            sites.push_back(siteObj);
+        }
+        obj.push_back(Pair("topsites", sites));
+        ret.push_back(Pair(item.second, obj));
+    }
+    return ret;
+#else
+    throw JSONRPCError(RPC_MISC_ERROR, "Lock profiling is not compiled in; rebuild with LOCK_PROFILE defined");
+#endif
+}
+
+Value getperfstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getperfstats [reset=false]\n"
+            "Returns the latency of message handling, block connection phases, mempool\n"
+            "acceptance, block and coinstake creation, database and block file access and\n"
+            "RPC calls. Per operation: count, total and maximum in microseconds and the\n"
+            "number of calls in each power of two bucket, keyed by its upper bound. Per\n"
+            "thread: count and total time of each operation.\n"
+            "If reset is true the counters are cleared after being returned.");
+
+    PerfStatsMap mapTotal;
+    std::map<string, PerfStatsMap> mapByThread;
+    GetPerfStats(mapTotal, &mapByThread);
+    if (params.size() > 0 && params[0].get_bool())
+        ResetPerfStats();
+
+    Object operations;
+    for (PerfStatsMap::iterator mi = mapTotal.begin(); mi != mapTotal.end(); ++mi)
+    {
+        operations.push_back(Pair(mi->first, PerfHistogramToJSON(mi->second)));
+    }
+
+    Object threads;
+    for (std::map<string, PerfStatsMap>::iterator mi = mapByThread.begin(); mi != mapByThread.end(); ++mi)
+    {
+        Object thread;
+        for (PerfStatsMap::iterator si = mi->second.begin(); si != mi->second.end(); ++si)
+        {
+            Object obj;
+            obj.push_back(Pair("count", (boost::int64_t)si->second.nCount));
+            obj.push_back(Pair("totalmicros", (boost::int64_t)si->second.nTotalMicros));
+            thread.push_back(Pair(si->first, obj));
+        }
+        threads.push_back(Pair(mi->first, thread));
+    }
+
+    Object ret;
+    ret.push_back(Pair("enabled", fPerfStats));
+    ret.push_back(Pair("operations", operations));
+    ret.push_back(Pair("threads", threads));
+    return ret;
+}
+
 
 
 //
@@ -245,6 +414,9 @@ static const CRPCCommand vRPCCommands[] =
   //  ------------------------  -----------------------  ------  --------
     { "help",                   &help,                   true,   true },
     { "stop",                   &stop,                   true,   true },
+    { "logging",                &logging,                true,   true },
+    { "getlockstats",           &getlockstats,           true,   true },
+    { "getperfstats",           &getperfstats,           true,   true },
     { "getbestblockhash",       &getbestblockhash,       true,   false },
     { "getblockcount",          &getblockcount,          true,   false },
     { "getconnectioncount",     &getconnectioncount,     true,   false },
@@ -301,6 +473,7 @@ static const CRPCCommand vRPCCommands[] =
     { "settxfee",               &settxfee,               false,  false },
     { "getblocktemplate",       &getblocktemplate,       true,   false },
     { "submitblock",            &submitblock,            false,  false },
+    { "generate",               &generate,               false,  false },
     { "listsinceblock",         &listsinceblock,         false,  false },
     { "dumpprivkey",            &dumpprivkey,            false,  false },
     { "dumpwallet",             &dumpwallet,             true,   false },
@@ -538,7 +711,7 @@ string JSONRPCRequest(const string& strMethod, const Array& params, const Value&
     request.push_back(Pair("method", strMethod));
     request.push_back(Pair("params", params));
     request.push_back(Pair("id", id));
-    return write_string(Value(request), false) + "\n";
+    return WriteJSON(Value(request)) + "\n";
 }
 
 Object JSONRPCReplyObj(const Value& result, const Value& error, const Value& id)
@@ -556,7 +729,7 @@ Object JSONRPCReplyObj(const Value& result, const Value& error, const Value& id)
 string JSONRPCReply(const Value& result, const Value& error, const Value& id)
 {
     Object reply = JSONRPCReplyObj(result, error, id);
-    return write_string(Value(reply), false) + "\n";
+    return WriteJSON(Value(reply)) + "\n";
 }
 
 void ErrorReply(std::ostream& stream, const Object& objError, const Value& id)
@@ -993,7 +1166,7 @@ void JSONRequest::parse(const Value& valRequest)
     if (valMethod.type() != str_type)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Method must be a string");
     strMethod = valMethod.get_str();
-    if (strMethod != "getwork" && strMethod != "getblocktemplate")
+    if (strMethod != "getwork" && strMethod != "getblocktemplate" && LogAccept(LOG_RPC, LOGLEVEL_INFO))
         printf("ThreadRPCServer method=%s\n", strMethod.c_str());
 
     // Parse params
@@ -1036,7 +1209,7 @@ static string JSONRPCExecBatch(const Array& vReq)
     for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
         ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
 
-    return write_string(Value(ret), false) + "\n";
+    return WriteJSON(Value(ret)) + "\n";
 }
 
 static CCriticalSection cs_THREAD_RPCHANDLER;
@@ -1096,7 +1269,7 @@ void ThreadRPCServer3(void* parg)
         {
             // Parse request
             Value valRequest;
-            if (!read_string(strRequest, valRequest))
+            if (!ParseJSON(strRequest, valRequest))
                 throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
             string strReply;
@@ -1153,13 +1326,17 @@ json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_s
     try
     {
         // Execute
+        CPerfTimer timer("rpc.", strMethod);
         Value result;
         {
             if (pcmd->unlocked)
                 result = pcmd->actor(params, false);
             else {
                 LOCK2(cs_main, pwalletMain->cs_wallet);
+                CWalletWriteBatch walletBatch(pwalletMain);
                 result = pcmd->actor(params, false);
+                if (!walletBatch.End())
+                    throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to write wallet transactions to disk");
             }
         }
         return result;
@@ -1217,7 +1394,7 @@ Object CallRPC(const string& strMethod, const Array& params)
 
     // Parse reply
     Value valReply;
-    if (!read_string(strReply, valReply))
+    if (!ParseJSON(strReply, valReply))
         throw runtime_error("couldn't parse reply from server");
     const Object& reply = valReply.get_obj();
     if (reply.empty())
@@ -1239,7 +1416,7 @@ void ConvertTo(Value& value, bool fAllowNull=false)
         // reinterpret string as unquoted json value
         Value value2;
         string strJSON = value.get_str();
-        if (!read_string(strJSON, value2))
+        if (!ParseJSON(strJSON, value2))
             throw runtime_error(string("Error parsing JSON:")+strJSON);
         ConvertTo<T>(value2, fAllowNull);
         value = value2;
@@ -1263,6 +1440,8 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     // Special case non-string parameter types
     //
     if (strMethod == "stop"                   && n > 0) ConvertTo<bool>(params[0]);
+    if (strMethod == "getlockstats"           && n > 0) ConvertTo<bool>(params[0]);
+    if (strMethod == "getperfstats"           && n > 0) ConvertTo<bool>(params[0]);
     if (strMethod == "sendtoaddress"          && n > 1) ConvertTo<double>(params[1]);
     if (strMethod == "settxfee"               && n > 0) ConvertTo<double>(params[0]);
 	if (strMethod == "getaddednodeinfo"       && n > 0) ConvertTo<bool>(params[0]);
@@ -1289,6 +1468,7 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     if (strMethod == "walletpassphrase"       && n > 1) ConvertTo<boost::int64_t>(params[1]);
     if (strMethod == "walletpassphrase"       && n > 2) ConvertTo<bool>(params[2]);
     if (strMethod == "getblocktemplate"       && n > 0) ConvertTo<Object>(params[0]);
+    if (strMethod == "generate"               && n > 0) ConvertTo<boost::int64_t>(params[0]);
     if (strMethod == "listsinceblock"         && n > 1) ConvertTo<boost::int64_t>(params[1]);
 	if (strMethod == "ccselect" 					&& n > 1)	ConvertTo<int>(params[1]);
 	if (strMethod == "ccreturnchange" 	&& n > 0)	ConvertTo<bool>(params[0]);
@@ -1353,7 +1533,7 @@ int CommandLineRPC(int argc, char *argv[])
         if (error.type() != null_type)
         {
             // Error
-            strPrint = "error: " + write_string(error, false);
+            strPrint = "error: " + WriteJSON(error);
             int code = find_value(error.get_obj(), "code").get_int();
             nRet = abs(code);
         }
@@ -1365,7 +1545,7 @@ int CommandLineRPC(int argc, char *argv[])
             else if (result.type() == str_type)
                 strPrint = result.get_str();
             else
-                strPrint = write_string(result, true);
+                strPrint = WriteJSON(result, true);
         }
     }
     catch (std::exception& e)
@@ -0,0 +1,267 @@
+// Copyright (c) 2009-2012 The Bitcoin developers
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfile.h"
+#include "main.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Number of block files kept mapped at once
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 8;
+
+// Block file space is reserved in chunks of this size
+static const unsigned int BLOCKFILE_CHUNK_SIZE = 16 * 1024 * 1024;
+
+// During initial download BLOCKSYNC_COMMIT syncs only every this many blocks
+static const unsigned int BLOCKSYNC_IBD_INTERVAL = 500;
+
+CBlockFileManager blockfiles;
+CBlockFileWriter blockwriter;
+
+CBlockFileManager::MappingRef CBlockFileManager::Map(unsigned int nFile)
+{
+#ifdef WIN32
+    return MappingRef();
+#else
+    if ((nFile < 1) || (nFile == (unsigned int) -1))
+        return MappingRef();
+    int fd = open(BlockFilePath(nFile).string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return MappingRef();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return MappingRef();
+    }
+    void* pdata = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pdata == MAP_FAILED)
+        return MappingRef();
+    return MappingRef(new CMapping((unsigned char*)pdata, st.st_size));
+#endif
+}
+
+CBlockFileManager::CMapping::~CMapping()
+{
+#ifndef WIN32
+    munmap(pdata, nSize);
+#endif
+}
+
+// Requires cs. The mapping returned stays valid for as long as the caller
+// holds the reference, even if it is evicted or refreshed meanwhile.
+CBlockFileManager::MappingRef CBlockFileManager::GetMapped(unsigned int nFile, unsigned int nPos, bool fRefresh)
+{
+    map<unsigned int, CMappedFile>::iterator mi = mapFiles.find(nFile);
+    if (mi != mapFiles.end() && (fRefresh || nPos >= (*mi).second.mapping->nSize))
+    {
+        mapFiles.erase(mi);
+        mi = mapFiles.end();
+    }
+
+    if (mi == mapFiles.end())
+    {
+        // Evict the least recently used mapping
+        if (mapFiles.size() >= MAX_MAPPED_BLOCK_FILES)
+        {
+            map<unsigned int, CMappedFile>::iterator miOldest = mapFiles.begin();
+            for (map<unsigned int, CMappedFile>::iterator it = mapFiles.begin(); it != mapFiles.end(); ++it)
+                if ((*it).second.nLastUsed < (*miOldest).second.nLastUsed)
+                    miOldest = it;
+            mapFiles.erase(miOldest);
+        }
+
+        CMappedFile file;
+        file.mapping = Map(nFile);
+        if (!file.mapping)
+            return MappingRef();
+        mi = mapFiles.insert(make_pair(nFile, file)).first;
+    }
+
+    CMappedFile& file = (*mi).second;
+    if (nPos >= file.mapping->nSize)
+        return MappingRef();
+    file.nLastUsed = ++nUseCounter;
+    return file.mapping;
+}
+
+void CBlockFileManager::CloseAll()
+{
+    LOCK(cs);
+    mapFiles.clear();
+}
+
+// Make at least nNeed bytes available from nCur, reading a chunk at a time
+bool CBlockFileScanner::Fill(unsigned int nNeed)
+{
+    if (vBuf.size() - nCur >= nNeed)
+        return true;
+    vBuf.erase(vBuf.begin(), vBuf.begin() + nCur);
+    nBufBegin += nCur;
+    nCur = 0;
+    while (vBuf.size() < nNeed && !fEof)
+    {
+        unsigned int nOld = vBuf.size();
+        unsigned int nRead = max(BLOCKFILE_CHUNK_SIZE, nNeed - nOld);
+        vBuf.resize(nOld + nRead);
+        size_t nGot = fread(&vBuf[nOld], 1, nRead, file);
+        vBuf.resize(nOld + nGot);
+        if (nGot < nRead)
+            fEof = true;
+    }
+    return vBuf.size() >= nNeed;
+}
+
+bool CBlockFileScanner::Next(unsigned int& nBlockPosRet, vector<unsigned char>& vchBlockRet)
+{
+    const unsigned int nHeaderSize = sizeof(pchMessageStart) + sizeof(unsigned int);
+    while (Fill(nHeaderSize))
+    {
+        unsigned char* pbegin = &vBuf[nCur];
+        unsigned char* pend = &vBuf[0] + vBuf.size() - sizeof(pchMessageStart) + 1;
+        unsigned char* pfind = (unsigned char*)memchr(pbegin, pchMessageStart[0], pend - pbegin);
+        if (!pfind)
+        {
+            nCur = pend - &vBuf[0];
+            continue;
+        }
+        nCur = pfind - &vBuf[0];
+        if (memcmp(pfind, pchMessageStart, sizeof(pchMessageStart)) != 0)
+        {
+            nCur++;
+            continue;
+        }
+        if (!Fill(nHeaderSize))
+            break;
+        unsigned int nSize;
+        memcpy(&nSize, &vBuf[nCur + sizeof(pchMessageStart)], sizeof(nSize));
+        if (nSize == 0 || nSize > MAX_BLOCK_SIZE)
+        {
+            // Not a block header after all
+            nCur++;
+            continue;
+        }
+        // A block cut short at the end of the file is not returned
+        if (!Fill(nHeaderSize + nSize))
+            break;
+        nBlockPosRet = nBufBegin + nCur + nHeaderSize;
+        vchBlockRet.assign(vBuf.begin() + nCur + nHeaderSize, vBuf.begin() + nCur + nHeaderSize + nSize);
+        nCur += nHeaderSize + nSize;
+        return true;
+    }
+    return false;
+}
+
+// Reserve disk space for [nOffset, nOffset+nLength) without changing the size
+// of the file. Failure is harmless, the space is then allocated as written.
+static void AllocateFileRange(FILE* file, unsigned int nOffset, unsigned int nLength)
+{
+#if defined(__linux__)
+    fallocate(fileno(file), FALLOC_FL_KEEP_SIZE, nOffset, nLength);
+#elif defined(MAC_OSX)
+    // Allocated past the physical end of the file, which is where it grows
+    fstore_t fst;
+    fst.fst_flags = F_ALLOCATECONTIG;
+    fst.fst_posmode = F_PEOFPOSMODE;
+    fst.fst_offset = 0;
+    fst.fst_length = nLength;
+    fst.fst_bytesalloc = 0;
+    if (fcntl(fileno(file), F_PREALLOCATE, &fst) == -1)
+    {
+        fst.fst_flags = F_ALLOCATEALL;
+        fcntl(fileno(file), F_PREALLOCATE, &fst);
+    }
+#endif
+}
+
+bool CBlockFileWriter::Prepare(unsigned int nAddSize)
+{
+    while (true)
+    {
+        if (!file)
+        {
+            file = OpenBlockFile(nFile, 0, "ab");
+            if (!file)
+                return error("CBlockFileWriter::Prepare() : open blk%04u.dat failed", nFile);
+            long nEnd = -1;
+            if (fseek(file, 0, SEEK_END) == 0)
+                nEnd = ftell(file);
+            if (nEnd < 0)
+            {
+                fclose(file);
+                file = NULL;
+                return error("CBlockFileWriter::Prepare() : seek to end of blk%04u.dat failed", nFile);
+            }
+            nFileSize = nEnd;
+            nAllocated = nEnd;
+        }
+        // FAT32 file size max 4GB, fseek and ftell max 2GB, so we must stay under 2GB
+        if (nFileSize < (unsigned int)(0x7F000000 - MAX_SIZE))
+            break;
+        Close();
+        nFile++;
+    }
+
+    if (nFileSize + nAddSize > nAllocated)
+    {
+        unsigned int nNewAllocated = (nFileSize + nAddSize + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE * BLOCKFILE_CHUNK_SIZE;
+        AllocateFileRange(file, nAllocated, nNewAllocated - nAllocated);
+        nAllocated = nNewAllocated;
+    }
+    return true;
+}
+
+bool CBlockFileWriter::Finish(unsigned int nSize, unsigned int& nFileRet, unsigned int& nBlockPosRet)
+{
+    // Flush stdio buffers, so that readers of the mapped file see the block
+    if (fflush(file) != 0)
+    {
+        Close();
+        return error("CBlockFileWriter::Finish() : write to blk%04u.dat failed", nFile);
+    }
+
+    nFileRet = nFile;
+    nBlockPosRet = nFileSize + sizeof(pchMessageStart) + sizeof(nSize);
+    nFileSize = nBlockPosRet + nSize;
+    nUnsynced++;
+
+    if (nSyncMode == BLOCKSYNC_BLOCK)
+        Sync();
+    return true;
+}
+
+void CBlockFileWriter::Sync()
+{
+    if (file && nUnsynced > 0)
+        FileCommit(file);
+    nUnsynced = 0;
+}
+
+void CBlockFileWriter::SyncBeforeCommit()
+{
+    LOCK(cs);
+    if (nSyncMode != BLOCKSYNC_COMMIT || nUnsynced == 0)
+        return;
+    if (!IsInitialBlockDownload() || nUnsynced >= BLOCKSYNC_IBD_INTERVAL)
+        Sync();
+}
+
+void CBlockFileWriter::Close()
+{
+    LOCK(cs);
+    if (!file)
+        return;
+    Sync();
+    fclose(file);
+    file = NULL;
+}
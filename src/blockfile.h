@@ -0,0 +1,230 @@
+// Copyright (c) 2009-2012 The Bitcoin developers
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BLOCKFILE_H
+#define BITCOIN_BLOCKFILE_H
+
+#include "protocol.h"
+#include "serialize.h"
+#include "sync.h"
+#include "version.h"
+
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode);
+
+/** Stream-like reader over a range of memory, for deserializing in place
+ * (e.g. straight out of a mapped block file) without copying into a CDataStream.
+ */
+class CMemoryReader
+{
+private:
+    const char* pcur;
+    const char* pend;
+
+public:
+    int nType;
+    int nVersion;
+
+    CMemoryReader(const unsigned char* pbeginIn, const unsigned char* pendIn, int nTypeIn, int nVersionIn) :
+        pcur((const char*)pbeginIn), pend((const char*)pendIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    CMemoryReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+            throw std::ios_base::failure("CMemoryReader::read() : end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    size_t size() const { return pend - pcur; }
+
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Serves reads from the blk%04u.dat files out of read-only memory maps, so
+ * that a block or transaction read costs a memcpy rather than an
+ * fopen/fseek/fread/fclose sequence. The most recently used files stay
+ * mapped; a mapping is refreshed when a read reaches past its end (the file
+ * being appended to has grown). Falls back to stdio when a file can't be
+ * mapped (e.g. on Windows or out of address space).
+ * The lock only guards the set of mappings: a reader pins the mapping it
+ * needs and deserializes after releasing the lock, and a mapping evicted
+ * meanwhile is unmapped when its last reader is done with it.
+ */
+class CBlockFileManager
+{
+private:
+    // One read-only mapping of a whole file, unmapped on destruction
+    struct CMapping : private boost::noncopyable
+    {
+        unsigned char* pdata;
+        size_t nSize;
+
+        CMapping(unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+        ~CMapping();
+    };
+    typedef boost::shared_ptr<const CMapping> MappingRef;
+
+    struct CMappedFile
+    {
+        MappingRef mapping;
+        uint64_t nLastUsed;
+    };
+
+    CCriticalSection cs;
+    std::map<unsigned int, CMappedFile> mapFiles;
+    uint64_t nUseCounter;
+
+    MappingRef GetMapped(unsigned int nFile, unsigned int nPos, bool fRefresh);
+    static MappingRef Map(unsigned int nFile);
+
+public:
+    CBlockFileManager() : nUseCounter(0) {}
+    ~CBlockFileManager() { CloseAll(); }
+
+    // Deserialize obj from block file nFile at offset nPos
+    template<typename T>
+    bool Read(unsigned int nFile, unsigned int nPos, T& obj, int nType)
+    {
+        for (int nTry = 0; nTry < 2; nTry++)
+        {
+            MappingRef mapping;
+            {
+                LOCK(cs);
+                mapping = GetMapped(nFile, nPos, nTry > 0);
+            }
+            if (!mapping)
+                break;
+            try {
+                CMemoryReader reader(mapping->pdata + nPos, mapping->pdata + mapping->nSize, nType, CLIENT_VERSION);
+                reader >> obj;
+                return true;
+            }
+            catch (std::exception &e) {
+                // Possibly a record appended after the file was mapped; remap once
+            }
+        }
+
+        FILE* file = OpenBlockFile(nFile, nPos, "rb");
+        if (!file)
+            return false;
+        CAutoFile filein = CAutoFile(file, nType, CLIENT_VERSION);
+        try {
+            filein >> obj;
+        }
+        catch (std::exception &e) {
+            return false;
+        }
+        return true;
+    }
+
+    // Drop all mappings
+    void CloseAll();
+};
+
+extern CBlockFileManager blockfiles;
+
+/** Sequential scan of a block file for message start + size framed blocks,
+ * in large reads. Damaged regions are skipped by searching for the next
+ * message start. Takes ownership of the file.
+ */
+class CBlockFileScanner
+{
+private:
+    FILE* file;
+    std::vector<unsigned char> vBuf;
+    unsigned int nBufBegin;     // file offset of vBuf[0]
+    unsigned int nCur;          // scan position in vBuf
+    bool fEof;
+
+    bool Fill(unsigned int nNeed);
+
+public:
+    CBlockFileScanner(FILE* fileIn) : file(fileIn), nBufBegin(0), nCur(0), fEof(false) {}
+    ~CBlockFileScanner() { if (file) fclose(file); }
+
+    // Next serialized block and its offset in the file, false at the end
+    bool Next(unsigned int& nBlockPosRet, std::vector<unsigned char>& vchBlockRet);
+};
+
+/** When block data is fsynced (-blocksync) */
+enum BlockSyncMode
+{
+    BLOCKSYNC_BLOCK,    // after every block written
+    BLOCKSYNC_COMMIT,   // once before the next txdb commit, i.e. before the index refers to it
+    BLOCKSYNC_NONE,     // left to the OS until the file is finished or closed
+};
+
+/** Appends blocks to the current blk%04u.dat file, which stays open between
+ * writes instead of being reopened and searched to the end for each block.
+ * Disk space is reserved ahead of the data in large chunks so the files don't
+ * fragment; the reservation does not change the file size, so the end of the
+ * file is still the end of the data for readers and on restart.
+ */
+class CBlockFileWriter
+{
+private:
+    CCriticalSection cs;
+    FILE* file;
+    unsigned int nFile;
+    unsigned int nFileSize;     // end of the data in nFile
+    unsigned int nAllocated;    // end of the space reserved so far
+    unsigned int nUnsynced;     // blocks written since the last fsync
+
+    bool Prepare(unsigned int nAddSize);
+    bool Finish(unsigned int nSize, unsigned int& nFileRet, unsigned int& nBlockPosRet);
+    void Sync();
+
+public:
+    int nSyncMode;
+
+    CBlockFileWriter() : file(NULL), nFile(1), nFileSize(0), nAllocated(0), nUnsynced(0), nSyncMode(BLOCKSYNC_COMMIT) {}
+    ~CBlockFileWriter() { Close(); }
+
+    // Append obj, preceded by the message start and its size, to the
+    // current block file; returns the file number and the offset of obj
+    template<typename T>
+    bool Append(const T& obj, unsigned int& nFileRet, unsigned int& nBlockPosRet)
+    {
+        LOCK(cs);
+        unsigned int nSize = ::GetSerializeSize(obj, SER_DISK, CLIENT_VERSION);
+        if (!Prepare(sizeof(pchMessageStart) + sizeof(nSize) + nSize))
+            return false;
+        CAutoFile fileout = CAutoFile(file, SER_DISK, CLIENT_VERSION);
+        try {
+            fileout << FLATDATA(pchMessageStart) << nSize << obj;
+        }
+        catch (std::exception &e) {
+            // Position unknown after a partial write; reopen at the end next time
+            fileout.release();
+            Close();
+            return false;
+        }
+        fileout.release();
+        return Finish(nSize, nFileRet, nBlockPosRet);
+    }
+
+    // Called before a txdb commit: fsync data the commit may refer to
+    void SyncBeforeCommit();
+
+    // fsync and close the current file
+    void Close();
+};
+
+extern CBlockFileWriter blockwriter;
+
+#endif
@@ -147,6 +147,13 @@ public:
             condWorker.notify_all();
     }
 
+    // Ask the worker threads to exit once all queued work has been processed
+    void Quit() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fQuit = true;
+        condWorker.notify_all();
+    }
+
     ~CCheckQueue() {
     }
 
@@ -124,4 +124,31 @@
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/** SipHash-2-4 of a 256-bit value, keyed with (k0, k1) */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
+/** Same, with a 32-bit value appended to the message */
+uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
+
+/** Hasher for uint256-keyed unordered containers. The key is random for each
+ *  hasher, so peers can't pick hashes that pile up in one bucket.
+ */
+class CSaltedHasher
+{
+private:
+    uint64_t k0, k1;
+
+public:
+    CSaltedHasher();
+
+    size_t operator()(const uint256& hash) const
+    {
+        return SipHashUint256(k0, k1, hash);
+    }
+
+    size_t operator()(const uint256& hash, uint32_t n) const
+    {
+        return SipHashUint256Extra(k0, k1, hash, n);
+    }
+};
+
 #endif
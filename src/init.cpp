@@ -11,6 +11,7 @@
 #include "util.h"
 #include "ui_interface.h"
 #include "checkpoints.h"
+#include "sha256.h"
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/convenience.hpp>
@@ -87,6 +88,8 @@ void Shutdown(void* parg)
 //        CTxDB().Close();
         bitdb.Flush(false);
         StopNode();
+        txadmission.Stop();
+        blockwriter.Close();
         bitdb.Flush(true);
         boost::filesystem::remove(GetPidFile());
         UnregisterWallet(pwalletMain);
@@ -94,6 +97,7 @@ void Shutdown(void* parg)
         NewThread(ExitTimeout, NULL);
         MilliSleep(50);
         printf("MotaCoin exited\n\n");
+        StopLogWriter();
         fExit = true;
 #ifndef QT_GUI
         // ensure non-UI client gets exited here, but let Bitcoin-Qt reach 'return 0;' in bitcoin.cpp
@@ -155,12 +159,13 @@ std::string HelpMessage()
         "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n" +
         "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 25)") + "\n" +
         "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n" +
+        "  -blocksync=<mode>      " + _("When to fsync block files: block, commit or none (default: commit)") + "\n" +
         "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n" +
         "  -proxy=<ip:port>       " + _("Connect through socks proxy") + "\n" +
         "  -socks=<n>             " + _("Select the version of socks proxy to use (4-5, default: 5)") + "\n" +
         "  -tor=<ip:port>         " + _("Use proxy to reach tor hidden services (default: same as -proxy)") + "\n"
         "  -dns                   " + _("Allow DNS lookups for -addnode, -seednode and -connect") + "\n" +
-        "  -port=<port>           " + _("Listen for connections on <port> (default: 50000 or testnet: 26000)") + "\n" +
+        "  -port=<port>           " + _("Listen for connections on <port> (default: 50000, testnet: 26000 or regtest: 26100)") + "\n" +
         "  -maxconnections=<n>    " + _("Maintain at most <n> connections to peers (default: 125)") + "\n" +
         "  -addnode=<ip>          " + _("Add a node to connect to and attempt to keep the connection open") + "\n" +
         "  -connect=<ip>          " + _("Connect only to the specified node(s)") + "\n" +
@@ -196,8 +201,10 @@ std::string HelpMessage()
         "  -daemon                " + _("Run in the background as a daemon and accept commands") + "\n" +
 #endif
         "  -testnet               " + _("Use the test network") + "\n" +
+        "  -regtest               " + _("Use a private test network where blocks are mined on demand with the generate command") + "\n" +
         "  -debug                 " + _("Output extra debugging information. Implies all other -debug* options") + "\n" +
         "  -debugnet              " + _("Output extra network debugging information") + "\n" +
+        "  -loglevel=<cat>:<lvl>  " + _("Set the log level of a category (net, mempool, stake, db, rpc) to none, info or debug") + "\n" +
         "  -logtimestamps         " + _("Prepend debug output with timestamp") + "\n" +
         "  -shrinkdebugfile       " + _("Shrink debug.log file on client startup (default: 1 when no -debug)") + "\n" +
         "  -printtoconsole        " + _("Send trace/debug info to console instead of debug.log file") + "\n" +
@@ -206,11 +213,15 @@ std::string HelpMessage()
 #endif
         "  -rpcuser=<user>        " + _("Username for JSON-RPC connections") + "\n" +
         "  -rpcpassword=<pw>      " + _("Password for JSON-RPC connections") + "\n" +
-        "  -rpcport=<port>        " + _("Listen for JSON-RPC connections on <port> (default: 17421 or testnet: 23521)") + "\n" +
+        "  -rpcport=<port>        " + _("Listen for JSON-RPC connections on <port> (default: 17421, testnet: 23521 or regtest: 23621)") + "\n" +
         "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified IP address") + "\n" +
         "  -rpcconnect=<ip>       " + _("Send commands to node running on <ip> (default: 127.0.0.1)") + "\n" +
         "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n" +
         "  -walletnotify=<cmd>    " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n" +
+        "  -txadmissionthreads=<n> " + _("Verify relayed transactions on <n> threads outside the main lock (0 = inline, default: number of cores)") + "\n" +
+        "  -perfstats             " + _("Time message handling, block connection, database access and RPC calls for getperfstats (default: 1)") + "\n" +
+        "  -perfstatsfile=<file>  " + _("Write the timings to <file> in Prometheus text format") + "\n" +
+        "  -perfstatsinterval=<n> " + _("Rewrite -perfstatsfile every <n> seconds (default: 60)") + "\n" +
         "  -confchange            " + _("Require a confirmations for change (default: 0)") + "\n" +
         "  -enforcecanonical      " + _("Enforce transaction scripts to use canonical PUSH operators (default: 1)") + "\n" +
         "  -minimizecoinage       " + _("Minimize weight consumption (experimental) (default: 0)") + "\n" +
@@ -218,11 +229,15 @@ std::string HelpMessage()
         "  -upgradewallet         " + _("Upgrade wallet to latest format") + "\n" +
         "  -keypool=<n>           " + _("Set key pool size to <n> (default: 100)") + "\n" +
         "  -rescan                " + _("Rescan the block chain for missing wallet transactions") + "\n" +
+        "  -walletflushinterval=<n> " + _("Flush the wallet to disk after it has been idle for <n> seconds (default: 2)") + "\n" +
+        "  -walletverify=<mode>   " + _("Check private keys against their public keys on wallet load: full or lazy (default: full)") + "\n" +
     	"  -combinethreshold=<n>  " + _("Set stake combine threshold after 14 days within range (default: 250, max: 2500)") + "\n" + 
         "  -salvagewallet         " + _("Attempt to recover private keys from a corrupt wallet.dat") + "\n" +
+        "  -txindexspenders       " + _("Also index the positions of spending transactions (used by -checklevel 4 and above)") + "\n" +
         "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 2500, 0 = all)") + "\n" +
         "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
         "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file") + "\n" +
+        "  -reindex               " + _("Rebuild the block and transaction index from the blk000?.dat files on disk") + "\n" +
 
         "\n" + _("Block creation options:") + "\n" +
         "  -blockminsize=<n>      "   + _("Set minimum block size in bytes (default: 0)") + "\n" +
@@ -305,9 +320,16 @@ bool AppInit2()
 
     nDerivationMethodIndex = 0;
 
-    fTestNet = GetBoolArg("-testnet");
+    fRegTest = GetBoolArg("-regtest");
+    if (fRegTest && GetBoolArg("-testnet"))
+        return InitError(_("-testnet and -regtest can't be used together."));
+    fTestNet = GetBoolArg("-testnet") || fRegTest;
     //fTestNet = true;
-    if (fTestNet) {
+    if (fRegTest) {
+        // regtest nodes only talk to peers given with -connect or -addnode
+        SoftSetBoolArg("-irc", false);
+        SoftSetBoolArg("-dnsseed", false);
+    } else if (fTestNet) {
         SoftSetBoolArg("-irc", true);
     }
 
@@ -354,6 +376,20 @@ bool AppInit2()
     else
         fDebugNet = GetBoolArg("-debugnet");
 
+    for (int i = 0; i < LOG_CATEGORIES; i++)
+        nLogLevel[i] = fDebug ? LOGLEVEL_DEBUG : LOGLEVEL_INFO;
+    if (fDebugNet)
+        nLogLevel[LOG_NET] = LOGLEVEL_DEBUG;
+    BOOST_FOREACH(string strLogLevel, mapMultiArgs["-loglevel"])
+    {
+        size_t nColon = strLogLevel.find(':');
+        int nCategory = LogCategoryFromName(strLogLevel.substr(0, nColon));
+        int nLevel = (nColon == string::npos) ? -1 : LogLevelFromName(strLogLevel.substr(nColon + 1));
+        if (nCategory < 0 || nLevel < 0)
+            return InitError(strprintf(_("Invalid -loglevel: '%s'"), strLogLevel.c_str()));
+        nLogLevel[nCategory] = nLevel;
+    }
+
     bitdb.SetDetach(GetBoolArg("-detachdb", false));
 
 #if !defined(WIN32) && !defined(QT_GUI)
@@ -380,6 +416,7 @@ bool AppInit2()
     fPrintToConsole = GetBoolArg("-printtoconsole");
     fPrintToDebugger = GetBoolArg("-printtodebugger");
     fLogTimestamps = GetBoolArg("-logtimestamps");
+    fPerfStats = GetBoolArg("-perfstats", true);
 
     if (mapArgs.count("-timeout"))
     {
@@ -447,9 +484,11 @@ bool AppInit2()
 
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
+    StartLogWriter();
     printf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     printf("MotaCoin version %s (%s)\n", FormatFullVersion().c_str(), CLIENT_DATE.c_str());
     printf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
+    printf("Using SHA256D64 implementation: %s\n", SHA256D64Implementation().c_str());
     if (!fLogTimestamps)
         printf("Startup time: %s\n", DateTimeStrFormat("%x %H:%M:%S", GetTime()).c_str());
     printf("Default data directory %s\n", GetDefaultDataDir().string().c_str());
@@ -514,6 +553,16 @@ bool AppInit2()
     if (nSocksVersion != 4 && nSocksVersion != 5)
         return InitError(strprintf(_("Unknown -socks proxy version requested: %i"), nSocksVersion));
 
+    std::string strBlockSync = GetArg("-blocksync", "commit");
+    if (strBlockSync == "block")
+        blockwriter.nSyncMode = BLOCKSYNC_BLOCK;
+    else if (strBlockSync == "commit")
+        blockwriter.nSyncMode = BLOCKSYNC_COMMIT;
+    else if (strBlockSync == "none")
+        blockwriter.nSyncMode = BLOCKSYNC_NONE;
+    else
+        return InitError(strprintf(_("Unknown -blocksync mode: '%s'"), strBlockSync.c_str()));
+
     if (mapArgs.count("-onlynet")) {
         std::set<enum Network> nets;
         BOOST_FOREACH(std::string snet, mapMultiArgs["-onlynet"]) {
@@ -646,12 +695,26 @@ bool AppInit2()
         return false;
     }
 
+    // The index is rebuilt from scratch; the block files are kept and read back below
+    if (GetBoolArg("-reindex"))
+    {
+        fReindex = true;
+        boost::filesystem::remove_all(GetDataDir() / "txleveldb");
+    }
+
     uiInterface.InitMessage(_("Loading block index..."));
     printf("Loading block index...\n");
     nStart = GetTimeMillis();
     if (!LoadBlockIndex())
         return InitError(_("Error loading blkindex.dat"));
 
+    if (fReindex)
+    {
+        uiInterface.InitMessage(_("Reindexing blocks on disk..."));
+        ReindexBlockFiles();
+        fReindex = false;
+    }
+
 
     // as LoadBlockIndex can take several minutes, it's possible the user
     // requested to kill bitcoin-qt during the last operation. If so, exit.
@@ -673,7 +736,7 @@ bool AppInit2()
     {
         string strMatch = mapArgs["-printblock"];
         int nFound = 0;
-        for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+        for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
         {
             uint256 hash = (*mi).first;
             if (strncmp(hash.ToString().c_str(), strMatch.c_str(), strMatch.size()) == 0)
@@ -831,9 +894,15 @@ bool AppInit2()
     printf("mapWallet.size() = %" PRIszu "\n",       pwalletMain->mapWallet.size());
     printf("mapAddressBook.size() = %" PRIszu "\n",  pwalletMain->mapAddressBook.size());
 
+    int nAdmissionThreads = GetArg("-txadmissionthreads", boost::thread::hardware_concurrency());
+    txadmission.Start(std::max(0, std::min(nAdmissionThreads, 16)));
+
     if (!NewThread(StartNode, NULL))
         InitError(_("Error: could not start node"));
 
+    if (fPerfStats && mapArgs.count("-perfstatsfile"))
+        NewThread(ThreadPerfStatsDump, NULL);
+
     if (fServer) {
 	printf("fServer=true - ThreadRPCServer from AppInit2\n");
         NewThread(ThreadRPCServer, NULL);
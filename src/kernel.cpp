@@ -97,10 +97,10 @@ static bool SelectBlockFromCandidates(vector<pair<int64_t, uint256> >& vSortedBy
             continue;
         // compute the selection hash by hashing its proof-hash and the
         // previous proof-of-stake modifier
-        uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
-        CDataStream ss(SER_GETHASH, 0);
+        uint256 hashProof = pindex->IsProofOfStake()? pindex->GetProofOfStakeHash() : pindex->GetBlockHash();
+        CHashWriter ss(SER_GETHASH, 0);
         ss << hashProof << nStakeModifierPrev;
-        uint256 hashSelection = Hash(ss.begin(), ss.end());
+        uint256 hashSelection = ss.GetHash();
         // the selection hash is divided by 2**32 so that proof-of-stake block
         // is always favored over proof-of-work block. this is to preserve
         // the energy efficiency property
@@ -118,7 +118,7 @@ static bool SelectBlockFromCandidates(vector<pair<int64_t, uint256> >& vSortedBy
             *pindexSelected = (const CBlockIndex*) pindex;
         }
     }
-    if (fDebug && GetBoolArg("-printstakemodifier"))
+    if (LogAccept(LOG_STAKE) && GetBoolArg("-printstakemodifier"))
         printf("SelectBlockFromCandidates: selection hash=%s\n", hashBest.ToString().c_str());
     return fSelected;
 }
@@ -150,7 +150,7 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     int64_t nModifierTime = 0;
     if (!GetLastStakeModifier(pindexPrev, nStakeModifier, nModifierTime))
         return error("ComputeNextStakeModifier: unable to get last modifier");
-    if (fDebug)
+    if (LogAccept(LOG_STAKE))
     {
         printf("ComputeNextStakeModifier: prev modifier=0x%016" PRIx64 " time=%s\n", nStakeModifier, DateTimeStrFormat(nModifierTime).c_str());
     }
@@ -187,12 +187,12 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
         // add the selected block from candidates to selected list
         mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
-        if (fDebug && GetBoolArg("-printstakemodifier"))
+        if (LogAccept(LOG_STAKE) && GetBoolArg("-printstakemodifier"))
             printf("ComputeNextStakeModifier: selected round %d stop=%s height=%d bit=%d\n", nRound, DateTimeStrFormat(nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
     }
 
     // Print selection map for visualization of the selected blocks
-    if (fDebug && GetBoolArg("-printstakemodifier"))
+    if (LogAccept(LOG_STAKE) && GetBoolArg("-printstakemodifier"))
     {
         string strSelectionMap = "";
         // '-' indicates proof-of-work blocks not selected
@@ -213,7 +213,7 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         }
         printf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap.c_str());
     }
-    if (fDebug)
+    if (LogAccept(LOG_STAKE))
     {
         printf("ComputeNextStakeModifier: new modifier=0x%016" PRIx64 " time=%s\n", nStakeModifierNew, DateTimeStrFormat(pindexPrev->GetBlockTime()).c_str());
     }
@@ -289,20 +289,34 @@ the wallet will not begin a new round of hashing until after a certain amount of
 can be found in main.cpp bitcoinminer(). This means that there will be 1-5 seconds of hashing with the CPU once every few minutes, compared to
 continued hashing with the CPU.
 **/
-uint256 stakeHash(unsigned int nTimeTx, unsigned int nTxPrevTime, CDataStream ss, unsigned int prevoutIndex, unsigned int nTxPrevOffset, unsigned int nTimeBlockFrom)
+uint256 stakeHash(unsigned int nTimeTx, unsigned int nTxPrevTime, CHashWriter ss, unsigned int prevoutIndex, unsigned int nTxPrevOffset, unsigned int nTimeBlockFrom)
 {
 	ss << nTimeBlockFrom << nTxPrevOffset << nTxPrevTime << prevoutIndex << nTimeTx;
-	return Hash(ss.begin(), ss.end());
+	return ss.GetHash();
 }
 
 //HyperStake test hash vs target
-bool stakeTargetHit(uint256 hashProofOfStake, int64_t nTimeWeight, int64_t nValueIn, CBigNum bnTargetPerCoinDay)
+bool stakeTargetHit(const uint256& hashProofOfStake, int64_t nTimeWeight, int64_t nValueIn, unsigned int nBits)
 {	
-	//get the stake weight
-	CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
-	
+	bool fTargetNegative, fTargetOverflow;
+	arith_uint256 bnTargetPerCoinDay;
+	bnTargetPerCoinDay.SetCompact(nBits, &fTargetNegative, &fTargetOverflow);
+
+	//get the stake weight, working on magnitudes so that the divisions truncate toward zero
+	bool fWeightNegative = (nValueIn < 0) != (nTimeWeight < 0);
+	uint64_t nValueAbs = nValueIn < 0 ? -(uint64_t)nValueIn : nValueIn;
+	uint64_t nTimeWeightAbs = nTimeWeight < 0 ? -(uint64_t)nTimeWeight : nTimeWeight;
+	arith_uint512 bnCoinDayWeight = arith_uint512(nValueAbs) * arith_uint512(nTimeWeightAbs) / (uint32_t)COIN / (uint32_t)(24 * 60 * 60);
+
+	// a hash is never below zero or a negative product
+	if (!bnCoinDayWeight || (!bnTargetPerCoinDay && !fTargetOverflow) || fWeightNegative != fTargetNegative)
+		return false;
+	// a target of 2^256 or more is above any hash
+	if (fTargetOverflow)
+		return true;
+
 	// Now check if proof-of-stake hash meets target protocol
-	return (CBigNum(hashProofOfStake) < bnCoinDayWeight * bnTargetPerCoinDay);
+	return (arith_uint512(arith_uint256(hashProofOfStake)) < bnCoinDayWeight * arith_uint512(bnTargetPerCoinDay));
 }
 
 //instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
@@ -320,10 +334,6 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
 	if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
 		return error("CheckStakeKernelHash() : min age violation");
 	
-	//grab difficulty
-	CBigNum bnTargetPerCoinDay;
-	bnTargetPerCoinDay.SetCompact(nBits);
-	
 	//grab stake modifier - HyperStake improves hashing by only grabbing this once per utxo
 	uint64_t nStakeModifier = 0;
 	int nStakeModifierHeight = 0;
@@ -331,15 +341,15 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
 	if (!GetKernelStakeModifier(blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake))
 		return false;
 		
-	//create data stream once instead of repeating it in the loop
-	CDataStream ss(SER_GETHASH, 0);
+	//hash the stake modifier once; each iteration continues from a copy of this state
+	CHashWriter ss(SER_GETHASH, 0);
 	ss << nStakeModifier;
 	
 	//if wallet is simply checking to make sure a hash is valid
 	if(fCheck)
 	{
 		hashProofOfStake = stakeHash(nTimeTx, nTxPrevTime, ss, prevout.n, nTxPrevOffset, nTimeBlockFrom); 
-		return stakeTargetHit(hashProofOfStake, GetWeight((int64_t)nTxPrevTime, (int64_t)nTimeTx), nValueIn, bnTargetPerCoinDay);
+		return stakeTargetHit(hashProofOfStake, GetWeight((int64_t)nTxPrevTime, (int64_t)nTimeTx), nValueIn, nBits);
 	}
 	
     bool fSuccess = false;
@@ -352,12 +362,12 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
 		hashProofOfStake = stakeHash(nTryTime, nTxPrevTime, ss, prevout.n, nTxPrevOffset, nTimeBlockFrom); 
 
 		// if stake hash does not meet the target then continue to next iteration
-		if(!stakeTargetHit(hashProofOfStake, GetWeight((int64_t)nTxPrevTime, (int64_t)nTimeTx), nValueIn, bnTargetPerCoinDay))
+		if(!stakeTargetHit(hashProofOfStake, GetWeight((int64_t)nTxPrevTime, (int64_t)nTimeTx), nValueIn, nBits))
 			continue;
 		
 		fSuccess = true; // if we make it this far then we have successfully created a stake hash 
 		nTimeTx = nTryTime;
-		if (fDebug || fPrintProofOfStake)
+		if (LogAccept(LOG_STAKE) || fPrintProofOfStake)
 		{
 			printf("CheckStakeKernelHash() : using modifier 0x%016" PRIx64 " at height=%d timestamp=%s for block from height=%d timestamp=%s\n",
 				nStakeModifier, nStakeModifierHeight, 
@@ -399,11 +409,11 @@ bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hash
     // Read block header
     CBlock block;
     if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
-        return fDebug? error("CheckProofOfStake() : read block failed") : false; // unable to read block of previous transaction
+        return LogAccept(LOG_STAKE)? error("CheckProofOfStake() : read block failed") : false; // unable to read block of previous transaction
 
 	unsigned int nInterval = 0;
 	unsigned int nTxTime = tx.nTime;
-    if (!CheckStakeKernelHash(nBits, block, txindex.pos.nTxPos - txindex.pos.nBlockPos, txPrev, txin.prevout, nTxTime, nInterval, true, hashProofOfStake, fDebug))
+    if (!CheckStakeKernelHash(nBits, block, txindex.pos.nTxPos - txindex.pos.nBlockPos, txPrev, txin.prevout, nTxTime, nInterval, true, hashProofOfStake, LogAccept(LOG_STAKE)))
         return tx.DoS(1, error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s", tx.GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str())); // may occur during initial download or if behind on block chain sync
 
     return true;
@@ -421,11 +431,11 @@ unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex)
 {
     assert (pindex->pprev || pindex->GetBlockHash() == (!fTestNet ? hashGenesisBlock : hashGenesisBlockTestNet));
     // Hash previous checksum with flags, hashProofOfStake and nStakeModifier
-    CDataStream ss(SER_GETHASH, 0);
+    CHashWriter ss(SER_GETHASH, 0);
     if (pindex->pprev)
         ss << pindex->pprev->nStakeModifierChecksum;
-    ss << pindex->nFlags << pindex->hashProofOfStake << pindex->nStakeModifier;
-    uint256 hashChecksum = Hash(ss.begin(), ss.end());
+    ss << pindex->nFlags << pindex->GetProofOfStakeHash() << pindex->nStakeModifier;
+    uint256 hashChecksum = ss.GetHash();
     hashChecksum >>= (256 - 32);
     return hashChecksum.Get64();
 }
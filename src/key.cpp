@@ -8,6 +8,10 @@
 #include <openssl/ecdsa.h>
 #include <openssl/obj_mac.h>
 
+#ifdef USE_SECP256K1
+#include <secp256k1.h>
+#endif
+
 #include "key.h"
 
 // Generate a private key from just the secret parameter
@@ -257,6 +261,35 @@ CPrivKey CKey::GetPrivKey() const
     return vchPrivKey;
 }
 
+bool CKey::GetSecretFromPrivKey(const CPrivKey& vchPrivKey, CSecret& vchSecret)
+{
+    // ECPrivateKey ::= SEQUENCE { version INTEGER (1), privateKey OCTET STRING, ... }
+    const unsigned char* pbegin = vchPrivKey.empty() ? NULL : &vchPrivKey[0];
+    const unsigned char* pend = pbegin + vchPrivKey.size();
+    if (pend - pbegin < 2 || pbegin[0] != 0x30)
+        return false;
+    pbegin++;
+    if (*pbegin & 0x80)
+    {
+        unsigned int nLenBytes = *pbegin & 0x7f;
+        if (nLenBytes < 1 || nLenBytes > 2 || pend - pbegin < (ptrdiff_t)(1 + nLenBytes))
+            return false;
+        pbegin += 1 + nLenBytes;
+    }
+    else
+        pbegin++;
+    if (pend - pbegin < 5 || pbegin[0] != 0x02 || pbegin[1] != 0x01 || pbegin[2] != 0x01 || pbegin[3] != 0x04)
+        return false;
+    // Older OpenSSL versions strip leading zero bytes of the secret
+    unsigned int nSecretLen = pbegin[4];
+    pbegin += 5;
+    if (nSecretLen < 1 || nSecretLen > 32 || pend - pbegin < (ptrdiff_t)nSecretLen)
+        return false;
+    vchSecret.assign(32, 0);
+    memcpy(&vchSecret[32 - nSecretLen], pbegin, nSecretLen);
+    return true;
+}
+
 bool CKey::SetPubKey(const CPubKey& vchPubKey)
 {
     const unsigned char* pbegin = &vchPubKey.vchPubKey[0];
@@ -391,9 +424,26 @@ bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& v
 }
 
 bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+#ifdef USE_SECP256K1
+    int nResult = fSet ? Secp256k1Verify(GetPubKey().Raw(), hash, vchSig) : -1;
+    if (nResult >= 0)
+    {
+        if (nResult != 1)
+            printf("CKey::Verify: \n\thash=%s, \n\tvchSig=%s\n\tsecp256k1_ecdsa_verify=%d\n",
+                hash.ToString().c_str(),
+                HexStr(vchSig.begin(), vchSig.end(), true).c_str(),
+                nResult);
+        return nResult == 1;
+    }
+#endif
+    return VerifyOpenSSL(hash, vchSig);
+}
+
+bool CKey::VerifyOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig)
 {
     // -1 = error, 0 = bad sig, 1 = good
-    int verifyResult = ECDSA_verify(0, (unsigned char*)&hash, sizeof(hash), &vchSig[0], vchSig.size(), pkey);
+    int verifyResult = ECDSA_verify(0, (unsigned char*)&hash, sizeof(hash), vchSig.empty() ? NULL : &vchSig[0], vchSig.size(), pkey);
     
     if (verifyResult != 1) {
         printf("CKey::Verify: \n\thash=%s, \n\tvchSig=%s\n\tECDSA_verify=%d\n", 
@@ -431,3 +481,95 @@ bool CKey::IsValid()
     key2.SetSecret(secret, fCompr);
     return GetPubKey() == key2.GetPubKey();
 }
+
+bool CPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const
+{
+#ifdef USE_SECP256K1
+    int nResult = Secp256k1Verify(vchPubKey, hash, vchSig);
+    if (nResult >= 0)
+        return nResult == 1;
+#endif
+    CKey key;
+    if (!key.SetPubKey(*this))
+        return false;
+    return key.VerifyOpenSSL(hash, vchSig);
+}
+
+#ifdef USE_SECP256K1
+// The verification context is created once: creating it builds the
+// precomputed multiplication tables, and it is read-only afterwards, so all
+// threads share it without locking.
+static const secp256k1_context* GetSecp256k1VerifyContext()
+{
+    static const secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+    return ctx;
+}
+
+// Copy one DER INTEGER into a 32-byte big-endian field. Negative and
+// non-minimal encodings are refused, as is anything wider than 256 bits.
+static bool ParseDERInteger(const unsigned char* p, unsigned int nLen, unsigned char* pout)
+{
+    if (p[0] & 0x80)
+        return false;
+    if (nLen > 1 && p[0] == 0 && !(p[1] & 0x80))
+        return false;
+    if (p[0] == 0)
+    {
+        p++;
+        nLen--;
+    }
+    if (nLen > 32)
+        return false;
+    memset(pout, 0, 32 - nLen);
+    memcpy(pout + 32 - nLen, p, nLen);
+    return true;
+}
+
+// Recognise strictly canonical DER signatures only:
+//   0x30 [len] 0x02 [lenR] [R] 0x02 [lenS] [S]
+// with short-form lengths and minimal positive integers. Every OpenSSL
+// version decodes these the same way. Anything else (lax BER that older
+// OpenSSL accepts, or trailing garbage that newer OpenSSL rejects) is left
+// to OpenSSL so that it keeps exactly the result it had before.
+static bool ParseCanonicalDERSignature(const std::vector<unsigned char>& vchSig, unsigned char* pcompact)
+{
+    unsigned int nSize = vchSig.size();
+    if (nSize < 8 || nSize > 72)
+        return false;
+    if (vchSig[0] != 0x30 || vchSig[1] != nSize - 2)
+        return false;
+    unsigned int nLenR = vchSig[3];
+    if (vchSig[2] != 0x02 || nLenR == 0 || 5 + nLenR >= nSize)
+        return false;
+    unsigned int nLenS = vchSig[5 + nLenR];
+    if (vchSig[4 + nLenR] != 0x02 || nLenS == 0 || 6 + nLenR + nLenS != nSize)
+        return false;
+    return ParseDERInteger(&vchSig[4], nLenR, pcompact) &&
+           ParseDERInteger(&vchSig[6 + nLenR], nLenS, pcompact + 32);
+}
+
+int Secp256k1Verify(const std::vector<unsigned char>& vchPubKey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    if (vchPubKey.size() != 33 && vchPubKey.size() != 65)
+        return -1;
+
+    unsigned char compact[64];
+    if (!ParseCanonicalDERSignature(vchSig, compact))
+        return -1;
+
+    const secp256k1_context* ctx = GetSecp256k1VerifyContext();
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, &vchPubKey[0], vchPubKey.size()))
+        return -1;
+
+    // r or s >= the group order: OpenSSL rejects these too
+    secp256k1_ecdsa_signature sig;
+    if (!secp256k1_ecdsa_signature_parse_compact(ctx, &sig, compact))
+        return 0;
+
+    // libsecp256k1 only accepts low-S signatures; OpenSSL accepts both
+    secp256k1_ecdsa_signature_normalize(ctx, &sig, &sig);
+
+    return secp256k1_ecdsa_verify(ctx, &sig, hash.begin(), &pubkey) == 1 ? 1 : 0;
+}
+#endif
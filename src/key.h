@@ -97,6 +97,10 @@ public:
     std::vector<unsigned char> Raw() const {
         return vchPubKey;
     }
+
+    // Check a DER signature of hash against this key without building an
+    // OpenSSL EC_KEY when the secp256k1 backend can handle it
+    bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
 };
 
 
@@ -135,6 +139,9 @@ public:
     bool SetSecret(const CSecret& vchSecret, bool fCompressed = false);
     CSecret GetSecret(bool &fCompressed) const;
     CPrivKey GetPrivKey() const;
+    // Extract the 32-byte secret from a DER encoded private key as produced by
+    // GetPrivKey(), without any elliptic curve operations or consistency checks.
+    static bool GetSecretFromPrivKey(const CPrivKey& vchPrivKey, CSecret& vchSecret);
     bool SetPubKey(const CPubKey& vchPubKey);
     CPubKey GetPubKey() const;
 
@@ -154,10 +161,20 @@ public:
 
     bool Verify(uint256 hash, const std::vector<unsigned char>& vchSig);
 
+    // Verify with OpenSSL only, regardless of the backend selected at build time
+    bool VerifyOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig);
+
     // Verify a compact signature
     bool VerifyCompact(uint256 hash, const std::vector<unsigned char>& vchSig);
 
     bool IsValid();
 };
 
+#ifdef USE_SECP256K1
+// Verify a signature with libsecp256k1. Returns 1 for a good signature, 0 for
+// a bad one, and -1 if the key or signature encoding is one the caller must
+// hand to OpenSSL instead to get exactly the same answer as before.
+int Secp256k1Verify(const std::vector<unsigned char>& vchPubKey, const uint256& hash, const std::vector<unsigned char>& vchSig);
+#endif
+
 #endif
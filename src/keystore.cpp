@@ -27,6 +27,17 @@ bool CBasicKeyStore::AddKey(const CKey& key)
     return true;
 }
 
+bool CBasicKeyStore::AddSecret(const CPubKey& vchPubKey, const CSecret& vchSecret, bool fCompressed)
+{
+    if (vchSecret.size() != 32)
+        return false;
+    {
+        LOCK(cs_KeyStore);
+        mapKeys[vchPubKey.GetID()] = make_pair(vchSecret, fCompressed);
+    }
+    return true;
+}
+
 bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 {
     {
@@ -140,6 +151,25 @@ bool CCryptoKeyStore::AddKey(const CKey& key)
     return true;
 }
 
+bool CCryptoKeyStore::AddSecret(const CPubKey& vchPubKey, const CSecret& vchSecret, bool fCompressed)
+{
+    {
+        LOCK(cs_KeyStore);
+        if (!IsCrypted())
+            return CBasicKeyStore::AddSecret(vchPubKey, vchSecret, fCompressed);
+
+        if (IsLocked())
+            return false;
+
+        std::vector<unsigned char> vchCryptedSecret;
+        if (!EncryptSecret(vMasterKey, vchSecret, vchPubKey.GetHash(), vchCryptedSecret))
+            return false;
+
+        if (!AddCryptedKey(vchPubKey, vchCryptedSecret))
+            return false;
+    }
+    return true;
+}
 
 bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
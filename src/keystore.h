@@ -24,6 +24,10 @@ public:
     // Add a key to the store.
     virtual bool AddKey(const CKey& key) =0;
 
+    // Add a key to the store given its already known public key and secret,
+    // without performing any elliptic curve operations.
+    virtual bool AddSecret(const CPubKey& vchPubKey, const CSecret& vchSecret, bool fCompressed) =0;
+
     // Check whether a key corresponding to a given address is present in the store.
     virtual bool HaveKey(const CKeyID &address) const =0;
     virtual bool GetKey(const CKeyID &address, CKey& keyOut) const =0;
@@ -57,6 +61,7 @@ protected:
 
 public:
     bool AddKey(const CKey& key);
+    bool AddSecret(const CPubKey& vchPubKey, const CSecret& vchSecret, bool fCompressed);
     bool HaveKey(const CKeyID &address) const
     {
         bool result;
@@ -148,6 +153,7 @@ public:
 
     virtual bool AddCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret);
     bool AddKey(const CKey& key);
+    bool AddSecret(const CPubKey& vchPubKey, const CSecret& vchSecret, bool fCompressed);
     bool HaveKey(const CKeyID &address) const
     {
         {
@@ -12,6 +12,7 @@
 #include "init.h"
 #include "ui_interface.h"
 #include "kernel.h"
+#include "sha256.h"
 #include "types/camount.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -33,16 +34,21 @@ set<CWallet*> setpwalletRegistered;
 CCriticalSection cs_main;
 
 CTxMemPool mempool;
+CTxAdmissionQueue txadmission;
 unsigned int nTransactionsUpdated = 0;
 
-map<uint256, CBlockIndex*> mapBlockIndex;
-set<pair<COutPoint, unsigned int> > setStakeSeen;
+BlockMap mapBlockIndex;
+StakeSeenSet setStakeSeen;
+static CArena<CBlockIndex> arenaBlockIndex;
+static CArena<CBlockIndexStake> arenaBlockIndexStake;
 
-static CBigNum bnProofOfWorkLimit(~uint256(0) >> 20); // "standard" scrypt target limit for proof of work, results with 0,000244140625 proof-of-work difficulty
-static CBigNum bnProofOfStakeLimit(~uint256(0) >> 24);
+static arith_uint256 bnProofOfWorkLimit(~arith_uint256(0) >> 20); // "standard" scrypt target limit for proof of work, results with 0,000244140625 proof-of-work difficulty
+static arith_uint256 bnProofOfStakeLimit(~arith_uint256(0) >> 24);
 
-static CBigNum bnProofOfWorkLimitTestNet(~uint256(0) >> 16);
-static CBigNum bnProofOfStakeLimitTestNet(~uint256(0) >> 30);
+static arith_uint256 bnProofOfWorkLimitTestNet(~arith_uint256(0) >> 16);
+static arith_uint256 bnProofOfStakeLimitTestNet(~arith_uint256(0) >> 30);
+
+static arith_uint256 bnProofOfWorkLimitRegTest(~arith_uint256(0) >> 1); // about two hashes per block
 
 unsigned int nTargetSpacing = 4.3 * 60; // 4 minute 20 sec
 unsigned int nStakeMinAge = 15 * 60; // 15 minutes
@@ -58,15 +64,16 @@ uint256 nBestInvalidTrust = 0;
 uint256 hashBestChain = 0;
 CBlockIndex* pindexBest = NULL;
 int64_t nTimeBestReceived = 0;
+bool fReindex = false;
 
 CMedianFilter<int> cPeerBlockCounts(5, 0); // Amount of blocks that other nodes claim to have
 
-map<uint256, CBlock*> mapOrphanBlocks;
-multimap<uint256, CBlock*> mapOrphanBlocksByPrev;
-set<pair<COutPoint, unsigned int> > setStakeSeenOrphan;
+std::unordered_map<uint256, CBlock*, CSaltedHasher> mapOrphanBlocks;
+std::unordered_multimap<uint256, CBlock*, CSaltedHasher> mapOrphanBlocksByPrev;
+StakeSeenSet setStakeSeenOrphan;
 
 map<uint256, CTransaction> mapOrphanTransactions;
-map<uint256, set<uint256> > mapOrphanTransactionsByPrev;
+std::unordered_map<uint256, set<uint256>, CSaltedHasher> mapOrphanTransactionsByPrev;
 map<unsigned int, unsigned int> mapHashedBlocks; // for liteStake
 
 // Constant stuff for coinbase transactions we create:
@@ -185,6 +192,23 @@ void ResendWalletTransactions(bool fForce)
         pwallet->ResendWalletTransactions(fForce);
 }
 
+// batch the wallet writes of all wallets while in scope
+class CWalletsWriteBatch
+{
+public:
+    CWalletsWriteBatch()
+    {
+        BOOST_FOREACH(CWallet* pwallet, setpwalletRegistered)
+            pwallet->BeginWriteBatch();
+    }
+
+    ~CWalletsWriteBatch()
+    {
+        BOOST_FOREACH(CWallet* pwallet, setpwalletRegistered)
+            pwallet->EndWriteBatch();
+    }
+};
+
 
 
 
@@ -448,7 +472,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock* pblock)
     }
 
     // Is the tx in a block that's in the main chain
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -548,6 +572,7 @@ int64_t CTransaction::GetMinFee(unsigned int nBlockSize, enum GetMinFee_mode mod
 bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
                         bool* pfMissingInputs)
 {
+    CPerfTimer timer("mempool.accept");
     if (pfMissingInputs)
         *pfMissingInputs = false;
 
@@ -660,7 +685,7 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
                 // At default rate it would take over a month to fill 1GB
                 if (dFreeCount > GetArg("-limitfreerelay", 15)*10*1000 && !IsFromMe(tx))
                     return error("CTxMemPool::accept() : free transaction rejected by rate limiter");
-                if (fDebug)
+                if (LogAccept(LOG_MEMPOOL))
                     printf("Rate limit dFreeCount: %g => %g\n", dFreeCount, dFreeCount+nSize);
                 dFreeCount += nSize;
             }
@@ -679,7 +704,8 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
         LOCK(cs);
         if (ptxOld)
         {
-            printf("CTxMemPool::accept() : replacing tx %s with new version\n", ptxOld->GetHash().ToString().c_str());
+            if (LogAccept(LOG_MEMPOOL, LOGLEVEL_INFO))
+                printf("CTxMemPool::accept() : replacing tx %s with new version\n", ptxOld->GetHash().ToString().c_str());
             remove(*ptxOld);
         }
         addUnchecked(hash, tx);
@@ -690,9 +716,10 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
     if (ptxOld)
         EraseFromWallets(ptxOld->GetHash());
 
-    printf("CTxMemPool::accept() : accepted %s (poolsz %" PRIszu ")\n",
-           hash.ToString().substr(0,10).c_str(),
-           mapTx.size());
+    if (LogAccept(LOG_MEMPOOL, LOGLEVEL_INFO))
+        printf("CTxMemPool::accept() : accepted %s (poolsz %" PRIszu ")\n",
+               hash.ToString().substr(0,10).c_str(),
+               mapTx.size());
     return true;
 }
 
@@ -725,7 +752,7 @@ bool CTxMemPool::remove(const CTransaction &tx, bool fRecursive)
         {
             if (fRecursive) {
                 for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                    std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
+                    std::unordered_map<COutPoint, CInPoint, COutPointHasher>::iterator it = mapNextTx.find(COutPoint(hash, i));
                     if (it != mapNextTx.end())
                         remove(*it->second.ptx, true);
                 }
@@ -744,7 +771,7 @@ bool CTxMemPool::removeConflicts(const CTransaction &tx)
     // Remove transactions which depend on inputs of tx, recursively
     LOCK(cs);
     BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-        std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(txin.prevout);
+        std::unordered_map<COutPoint, CInPoint, COutPointHasher>::iterator it = mapNextTx.find(txin.prevout);
         if (it != mapNextTx.end()) {
             const CTransaction &txConflict = *it->second.ptx;
             if (txConflict != tx)
@@ -768,7 +795,7 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 
     LOCK(cs);
     vtxid.reserve(mapTx.size());
-    for (map<uint256, CTransaction>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
+    for (std::unordered_map<uint256, CTransaction, CSaltedHasher>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
         vtxid.push_back((*mi).first);
 }
 
@@ -781,7 +808,7 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(CBlockIndex* &pindexRet) const
         return 0;
 
     // Find the block it claims to be in
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -872,7 +899,7 @@ int CTxIndex::GetDepthInMainChain() const
     if (!block.ReadFromDisk(pos.nFile, pos.nBlockPos, false))
         return 0;
     // Find the block in the index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+    BlockMap::iterator mi = mapBlockIndex.find(block.GetHash());
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1138,10 +1165,13 @@ static const int nTargetSpacingWorkMax = 3 * nStakeTargetSpacing; // ~9 minutes
 //
 // maximum nBits value could possible be required nTime after
 //
-unsigned int ComputeMaxBits(CBigNum bnTargetLimit, unsigned int nBase, int64_t nTime)
+unsigned int ComputeMaxBits(const arith_uint256& bnTargetLimit, unsigned int nBase, int64_t nTime)
 {
-    CBigNum bnResult;
-    bnResult.SetCompact(nBase);
+    bool fOverflow;
+    arith_uint256 bnResult;
+    bnResult.SetCompact(nBase, NULL, &fOverflow);
+    if (fOverflow)
+        return bnTargetLimit.GetCompact();
     bnResult *= 2;
     while (nTime > 0 && bnResult < bnTargetLimit)
     {
@@ -1183,7 +1213,7 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
 
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
-    CBigNum bnTargetLimit = bnProofOfWorkLimit;
+    arith_uint256 bnTargetLimit = bnProofOfWorkLimit;
 
     if(fProofOfStake)
     {
@@ -1194,6 +1224,10 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
     if (pindexLast == NULL)
         return bnTargetLimit.GetCompact(); // genesis block
 
+    // Regtest blocks come in bursts from the generate command, so never retarget
+    if (fRegTest)
+        return bnTargetLimit.GetCompact();
+
     const CBlockIndex* pindexPrev = GetLastBlockIndex(pindexLast, fProofOfStake);
     if (pindexPrev->pprev == NULL)
         return bnTargetLimit.GetCompact(); // first block
@@ -1207,13 +1241,18 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
 
     // ppcoin: target change every block
     // ppcoin: retarget with exponential moving toward target spacing
-    CBigNum bnNew;
-    bnNew.SetCompact(pindexPrev->nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnPrev;
+    bnPrev.SetCompact(pindexPrev->nBits, &fNegative, &fOverflow);
 
     int nTargetSpacing = nStakeTargetSpacing;
     int nInterval = nTargetTimespan / nTargetSpacing;
-    bnNew *= ((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
-    bnNew /= ((nInterval + 1) * nTargetSpacing);
+    int nMultiplier = (nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing;
+
+    // The product can exceed 256 bits for large nActualSpacing
+    arith_uint512 bnNew(bnPrev);
+    bnNew *= (uint32_t)std::max(nMultiplier, 0);
+    bnNew /= (uint32_t)((nInterval + 1) * nTargetSpacing);
     
     
     printf(">> Height = %d, fProofOfStake = %d, nInterval = %" PRId64 ", nTargetSpacing = %" PRId64 ", nActualSpacing = %" PRId64 "\n", 
@@ -1222,23 +1261,25 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
         pindexPrev->GetBlockTime(), pindexPrev->nHeight, pindexPrevPrev->GetBlockTime(), pindexPrevPrev->nHeight);  
     
 
-    if (bnNew <= 0 || bnNew > bnTargetLimit)
-        bnNew = bnTargetLimit;
+    // A negative or overflowing previous target stays out of range after scaling
+    if (fNegative || fOverflow || !bnNew || bnNew > arith_uint512(bnTargetLimit))
+        return bnTargetLimit.GetCompact();
 
-    return bnNew.GetCompact();
+    return arith_uint256(bnNew).GetCompact();
 }
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits)
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
     // Check range
-    if (bnTarget <= 0 || bnTarget > bnProofOfWorkLimit)
+    if (fNegative || fOverflow || !bnTarget || bnTarget > bnProofOfWorkLimit)
         return error("CheckProofOfWork() : nBits below minimum work");
 
     // Check proof of work matches claimed amount
-    if (hash > bnTarget.getuint256())
+    if (arith_uint256(hash) > bnTarget)
         return error("CheckProofOfWork() : hash doesn't match nBits");
 
     return true;
@@ -1318,11 +1359,11 @@ bool CTransaction::DisconnectInputs(CTxDB& txdb)
             if (!txdb.ReadTxIndex(prevout.hash, txindex))
                 return error("DisconnectInputs() : ReadTxIndex failed");
 
-            if (prevout.n >= txindex.vSpent.size())
+            if (prevout.n >= txindex.GetOutputCount())
                 return error("DisconnectInputs() : prevout.n out of range");
 
             // Mark outpoint as not spent
-            txindex.vSpent[prevout.n].SetNull();
+            txindex.MarkUnspent(prevout.n);
 
             // Write back
             if (!txdb.UpdateTxIndex(prevout.hash, txindex))
@@ -1386,7 +1427,7 @@ bool CTransaction::FetchInputs(CTxDB& txdb, const map<uint256, CTxIndex>& mapTes
                 txPrev = mempool.lookup(prevout.hash);
             }
             if (!fFound)
-                txindex.vSpent.resize(txPrev.vout.size());
+                txindex.SetOutputCount(txPrev.vout.size());
         }
         else
         {
@@ -1403,12 +1444,12 @@ bool CTransaction::FetchInputs(CTxDB& txdb, const map<uint256, CTxIndex>& mapTes
         assert(inputsRet.count(prevout.hash) != 0);
         const CTxIndex& txindex = inputsRet[prevout.hash].first;
         const CTransaction& txPrev = inputsRet[prevout.hash].second;
-        if (prevout.n >= txPrev.vout.size() || prevout.n >= txindex.vSpent.size())
+        if (prevout.n >= txPrev.vout.size() || prevout.n >= txindex.GetOutputCount())
         {
             // Revisit this if/when transaction replacement is implemented and allows
             // adding inputs:
             fInvalid = true;
-            return DoS(100, error("FetchInputs() : %s prevout.n out of range %d %" PRIszu " %" PRIszu " prev tx %s\n%s", GetHash().ToString().substr(0,10).c_str(), prevout.n, txPrev.vout.size(), txindex.vSpent.size(), prevout.hash.ToString().substr(0,10).c_str(), txPrev.ToString().c_str()));
+            return DoS(100, error("FetchInputs() : %s prevout.n out of range %d %" PRIszu " %u prev tx %s\n%s", GetHash().ToString().substr(0,10).c_str(), prevout.n, txPrev.vout.size(), txindex.GetOutputCount(), prevout.hash.ToString().substr(0,10).c_str(), txPrev.ToString().c_str()));
         }
     }
 
@@ -1475,8 +1516,8 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
             CTxIndex& txindex = inputs[prevout.hash].first;
             CTransaction& txPrev = inputs[prevout.hash].second;
 
-            if (prevout.n >= txPrev.vout.size() || prevout.n >= txindex.vSpent.size())
-                return DoS(100, error("ConnectInputs() : %s prevout.n out of range %d %" PRIszu " %" PRIszu " prev tx %s\n%s", GetHash().ToString().substr(0,10).c_str(), prevout.n, txPrev.vout.size(), txindex.vSpent.size(), prevout.hash.ToString().substr(0,10).c_str(), txPrev.ToString().c_str()));
+            if (prevout.n >= txPrev.vout.size() || prevout.n >= txindex.GetOutputCount())
+                return DoS(100, error("ConnectInputs() : %s prevout.n out of range %d %" PRIszu " %u prev tx %s\n%s", GetHash().ToString().substr(0,10).c_str(), prevout.n, txPrev.vout.size(), txindex.GetOutputCount(), prevout.hash.ToString().substr(0,10).c_str(), txPrev.ToString().c_str()));
 
             // If prev is coinbase or coinstake, check that it's matured
             if (txPrev.IsCoinBase() || txPrev.IsCoinStake())
@@ -1497,6 +1538,7 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
         // The first loop above does all the inexpensive checks.
         // Only if ALL inputs pass do we perform expensive ECDSA signature checks.
         // Helps prevent CPU exhaustion attacks.
+        CSignatureHasher hasher(*this);
         for (unsigned int i = 0; i < vin.size(); i++)
         {
             COutPoint prevout = vin[i].prevout;
@@ -1507,8 +1549,8 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
             // Check for conflicts (double-spend)
             // This doesn't trigger the DoS code on purpose; if it did, it would make it easier
             // for an attacker to attempt to split the network.
-            if (!txindex.vSpent[prevout.n].IsNull())
-                return fMiner ? false : error("ConnectInputs() : %s prev tx already used at %s", GetHash().ToString().substr(0,10).c_str(), txindex.vSpent[prevout.n].ToString().c_str());
+            if (txindex.IsSpent(prevout.n))
+                return fMiner ? false : error("ConnectInputs() : %s prev tx %s:%u already used", GetHash().ToString().substr(0,10).c_str(), prevout.hash.ToString().substr(0,10).c_str(), prevout.n);
 
             // Skip ECDSA signature verification when connecting blocks (fBlock=true)
             // before the last blockchain checkpoint. This is safe because block merkle hashes are
@@ -1516,14 +1558,14 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
             if (!(fBlock && (nBestHeight < Checkpoints::GetTotalBlocksEstimate())))
             {
                 // Verify signature
-                if (!VerifySignature(txPrev, *this, i, 0))
+                if (!VerifySignature(txPrev, *this, i, 0, &hasher))
                 {
                     return DoS(100,error("ConnectInputs() : %s VerifySignature failed", GetHash().ToString().substr(0,10).c_str()));
                 }
             }
 
             // Mark outpoints as spent
-            txindex.vSpent[prevout.n] = posThisTx;
+            txindex.MarkSpent(prevout.n, posThisTx);
 
             // Write back
             if (fBlock || fMiner)
@@ -1649,7 +1691,7 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex)
 bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
 {
     // Check it again in case a previous version let a bad block in, but skip BlockSig checking
-    if (!CheckBlock(!fJustCheck, !fJustCheck, false))
+    if (!fChecked && !CheckBlock(!fJustCheck, !fJustCheck, false))
         return false;
 
     //// issue here: it doesn't know the version
@@ -1667,6 +1709,8 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     int64_t nValueOut = 0;
     int64_t nStakeReward = 0;
     unsigned int nSigOps = 0;
+    int64_t nTimeStart = GetTimeMicros();
+    int64_t nTimeFetch = 0, nTimeVerify = 0;
     BOOST_FOREACH(CTransaction& tx, vtx)
     {
         uint256 hashTx = tx.GetHash();
@@ -1684,11 +1728,8 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
         // two in the chain that violate it. This prevents exploiting the issue against nodes in their
         // initial block download.
         CTxIndex txindexOld;
-        if (txdb.ReadTxIndex(hashTx, txindexOld)) {
-            BOOST_FOREACH(CDiskTxPos &pos, txindexOld.vSpent)
-                if (pos.IsNull())
-                    return false;
-        }
+        if (txdb.ReadTxIndex(hashTx, txindexOld) && !txindexOld.IsFullySpent())
+            return false;
 
         nSigOps += tx.GetLegacySigOpCount();
         if (nSigOps > MAX_BLOCK_SIGOPS)
@@ -1704,8 +1745,10 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
         else
         {
             bool fInvalid;
+            int64_t nTimeTx = GetTimeMicros();
             if (!tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid))
                 return false;
+            nTimeFetch += GetTimeMicros() - nTimeTx;
 
             // Add in sigops done by pay-to-script-hash inputs;
             // this is to prevent a "rogue miner" from creating
@@ -1723,8 +1766,10 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
             if (tx.IsCoinStake())
                 nStakeReward = nTxValueOut - nTxValueIn;
 
+            nTimeTx = GetTimeMicros();
             if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false))
                 return false;
+            nTimeVerify += GetTimeMicros() - nTimeTx;
         }
 
         mapQueuedChanges[hashTx] = CTxIndex(posThisTx, tx.vout.size());
@@ -1763,10 +1808,18 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     if (!txdb.WriteBlockIndex(CDiskBlockIndex(pindex)))
         return error("Connect() : WriteBlockIndex for pindex failed");
 
+    // ConnectInputs time is mostly script verification
+    PerfRecord("connectblock.fetchinputs", nTimeFetch);
+    PerfRecord("connectblock.verify", nTimeVerify);
+
     if (fJustCheck)
+    {
+        PerfRecord("connectblock.check", GetTimeMicros() - nTimeStart);
         return true;
+    }
 
     // Write queued txindex changes
+    int64_t nTimeIndex = GetTimeMicros();
     for (map<uint256, CTxIndex>::iterator mi = mapQueuedChanges.begin(); mi != mapQueuedChanges.end(); ++mi)
     {
         if (!txdb.UpdateTxIndex((*mi).first, (*mi).second))
@@ -1782,11 +1835,16 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
         if (!txdb.WriteBlockIndex(blockindexPrev))
             return error("ConnectBlock() : WriteBlockIndex failed");
     }
+    int64_t nTimeWallet = GetTimeMicros();
+    PerfRecord("connectblock.txindex", nTimeWallet - nTimeIndex);
 
     // Watch for transactions paying to me
     BOOST_FOREACH(CTransaction& tx, vtx)
         SyncWithWallets(tx, this, true);
 
+    int64_t nTimeEnd = GetTimeMicros();
+    PerfRecord("connectblock.walletsync", nTimeEnd - nTimeWallet);
+    PerfRecord("connectblock", nTimeEnd - nTimeStart);
     return true;
 }
 
@@ -1918,6 +1976,9 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
 {
     uint256 hash = GetHash();
 
+    // Write the wallet transactions touched by this block (or reorganization) together
+    CWalletsWriteBatch walletBatch;
+
     if (!txdb.TxnBegin())
         return error("SetBestChain() : TxnBegin failed");
 
@@ -2042,7 +2103,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
 // age (trust score) of competing branches.
 bool CTransaction::GetCoinAge(CTxDB& txdb, uint64_t& nCoinAge) const
 {
-    CBigNum bnCentSecond = 0;  // coin age in the unit of cent-seconds
+    arith_uint256 bnCentSecond = 0;  // coin age in the unit of cent-seconds
     nCoinAge = 0;
 
     if (IsCoinBase())
@@ -2069,16 +2130,16 @@ bool CTransaction::GetCoinAge(CTxDB& txdb, uint64_t& nCoinAge) const
             continue; // only count coins meeting min age requirement
 
         int64_t nValueIn = txPrev.vout[txin.prevout.n].nValue;
-        bnCentSecond += CBigNum(nValueIn) * (nTime-txPrev.nTime) / CENT;
+        bnCentSecond += arith_uint256((uint64_t)nValueIn) * (uint32_t)(nTime-txPrev.nTime) / (uint32_t)CENT;
 
-        if (fDebug && GetBoolArg("-printcoinage"))
-            printf("coin age nValueIn=%" PRId64 " nTimeDiff=%d bnCentSecond=%s\n", nValueIn, nTime - txPrev.nTime, bnCentSecond.ToString().c_str());
+        if (LogAccept(LOG_STAKE) && GetBoolArg("-printcoinage"))
+            printf("coin age nValueIn=%" PRId64 " nTimeDiff=%d bnCentSecond=%s\n", nValueIn, nTime - txPrev.nTime, CBigNum(bnCentSecond.getuint256()).ToString().c_str());
     }
 
-    CBigNum bnCoinDay = bnCentSecond * CENT / (24 * 60 * 60);
-    if (fDebug && GetBoolArg("-printcoinage"))
-        printf("coin age bnCoinDay=%s\n", bnCoinDay.ToString().c_str());
-    nCoinAge = bnCoinDay.getuint64();
+    arith_uint256 bnCoinDay = bnCentSecond * (uint32_t)CENT / (uint32_t)(24 * 60 * 60);
+    if (LogAccept(LOG_STAKE) && GetBoolArg("-printcoinage"))
+        printf("coin age bnCoinDay=%s\n", CBigNum(bnCoinDay.getuint256()).ToString().c_str());
+    nCoinAge = bnCoinDay.GetLow64();
     return true;
 }
 
@@ -2099,11 +2160,26 @@ bool CBlock::GetCoinAge(uint64_t& nCoinAge) const
 
     if (nCoinAge == 0) // block coin age minimum 1 coin-day
         nCoinAge = 1;
-    if (fDebug && GetBoolArg("-printcoinage"))
+    if (LogAccept(LOG_STAKE) && GetBoolArg("-printcoinage"))
         printf("block coin age total nCoinDays=%" PRId64 "\n", nCoinAge);
     return true;
 }
 
+CBlockIndex* NewBlockIndex()
+{
+    return arenaBlockIndex.New();
+}
+
+CBlockIndex* NewBlockIndex(unsigned int nFile, unsigned int nBlockPos, CBlock& block)
+{
+    return arenaBlockIndex.New(nFile, nBlockPos, block);
+}
+
+CBlockIndexStake* NewBlockIndexStake(const COutPoint& prevoutStake, unsigned int nStakeTime)
+{
+    return arenaBlockIndexStake.New(prevoutStake, nStakeTime);
+}
+
 bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const uint256& hashProofOfStake)
 {
     // Check for duplicate
@@ -2112,11 +2188,9 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         return error("AddToBlockIndex() : %s already exists", hash.ToString().substr(0,20).c_str());
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(nFile, nBlockPos, *this);
-    if (!pindexNew)
-        return error("AddToBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = NewBlockIndex(nFile, nBlockPos, *this);
     pindexNew->phashBlock = &hash;
-    map<uint256, CBlockIndex*>::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
     {
         pindexNew->pprev = (*miPrev).second;
@@ -2131,7 +2205,8 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         return error("AddToBlockIndex() : SetStakeEntropyBit() failed");
 
     // MotaCoin: record proof-of-stake hash value
-    pindexNew->hashProofOfStake = hashProofOfStake;
+    if (pindexNew->pstake)
+        pindexNew->pstake->hashProofOfStake = hashProofOfStake;
 
     // MotaCoin: compute stake modifier
     uint64_t nStakeModifier = 0;
@@ -2144,9 +2219,9 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         return error("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=0x%016" PRIx64 " pindexNew->nStakeModifierChecksum=0x%08" PRIx64, pindexNew->nHeight, nStakeModifier, pindexNew->nStakeModifierChecksum);
 
     // Add to mapBlockIndex
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
+    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+        setStakeSeen.insert(pindexNew->GetProofOfStake());
     pindexNew->phashBlock = &((*mi).first);
 
     // Write to disk block index
@@ -2272,7 +2347,7 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
     return true;
 }
 
-bool CBlock::AcceptBlock()
+bool CBlock::AcceptBlock(unsigned int nFileStored, unsigned int nBlockPosStored)
 {
     // Check for duplicate
     uint256 hash = GetHash();
@@ -2280,7 +2355,7 @@ bool CBlock::AcceptBlock()
         return error("AcceptBlock() : block already in mapBlockIndex");
 
     // Get prev block index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashPrevBlock);
     if (mi == mapBlockIndex.end())
         return DoS(10, error("AcceptBlock() : prev block not found"));
     CBlockIndex* pindexPrev = (*mi).second;
@@ -2430,12 +2505,15 @@ bool CBlock::AcceptBlock()
         return DoS(100, error("AcceptBlock() : block height mismatch in coinbase"));
 
     // Write block to history file
-    if (!CheckDiskSpace(::GetSerializeSize(*this, SER_DISK, CLIENT_VERSION)))
-        return error("AcceptBlock() : out of disk space");
-    unsigned int nFile = -1;
-    unsigned int nBlockPos = 0;
-    if (!WriteToDisk(nFile, nBlockPos))
-        return error("AcceptBlock() : WriteToDisk failed");
+    unsigned int nFile = nFileStored;
+    unsigned int nBlockPos = nBlockPosStored;
+    if (nFileStored == 0)
+    {
+        if (!CheckDiskSpace(::GetSerializeSize(*this, SER_DISK, CLIENT_VERSION)))
+            return error("AcceptBlock() : out of disk space");
+        if (!WriteToDisk(nFile, nBlockPos))
+            return error("AcceptBlock() : WriteToDisk failed");
+    }
     if (!AddToBlockIndex(nFile, nBlockPos, hashProofOfStake))
         return error("AcceptBlock() : AddToBlockIndex failed");
 
@@ -2457,13 +2535,20 @@ bool CBlock::AcceptBlock()
 
 uint256 CBlockIndex::GetBlockTrust() const
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
-    if (bnTarget <= 0)
+    // A target of 2^256 or more takes no work at all
+    if (fNegative || fOverflow || !bnTarget)
         return 0;
 
-    return ((CBigNum(1)<<256) / (bnTarget+1)).getuint256();
+    // 2^256 / (bnTarget+1) does not fit in 256 bits, but it is equal to
+    // ~bnTarget / (bnTarget+1) + 1 (with bnTarget+1 wrapping to zero only
+    // for a target of 2^256-1, whose trust is 1).
+    if (!~bnTarget)
+        return 1;
+    return arith_uint256(~bnTarget / (bnTarget + 1) + 1).getuint256();
 }
 
 bool CBlockIndex::IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned int nRequired, unsigned int nToCheck)
@@ -2504,16 +2589,17 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     {
         // Extra checks to prevent "fill up memory by spamming with bogus blocks"
         int64_t deltaTime = pblock->GetBlockTime() - pcheckpoint->nTime;
-        CBigNum bnNewBlock;
-        bnNewBlock.SetCompact(pblock->nBits);
-        CBigNum bnRequired;
+        bool fNegative, fOverflow;
+        arith_uint256 bnNewBlock;
+        bnNewBlock.SetCompact(pblock->nBits, &fNegative, &fOverflow);
+        arith_uint256 bnRequired;
 
         if (pblock->IsProofOfStake())
             bnRequired.SetCompact(ComputeMinStake(GetLastBlockIndex(pcheckpoint, true)->nBits, deltaTime, pblock->nTime));
         else
             bnRequired.SetCompact(ComputeMinWork(GetLastBlockIndex(pcheckpoint, false)->nBits, deltaTime));
 
-        if (bnNewBlock > bnRequired)
+        if (fOverflow || (!fNegative && bnNewBlock > bnRequired))
         {
             if (pfrom)
                 pfrom->Misbehaving(100);
@@ -2565,9 +2651,9 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     for (unsigned int i = 0; i < vWorkQueue.size(); i++)
     {
         uint256 hashPrev = vWorkQueue[i];
-        for (multimap<uint256, CBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
-             mi != mapOrphanBlocksByPrev.upper_bound(hashPrev);
-             ++mi)
+        typedef std::unordered_multimap<uint256, CBlock*, CSaltedHasher>::iterator OrphanIter;
+        pair<OrphanIter, OrphanIter> range = mapOrphanBlocksByPrev.equal_range(hashPrev);
+        for (OrphanIter mi = range.first; mi != range.second; ++mi)
         {
             CBlock* pblockOrphan = (*mi).second;
             if (pblockOrphan->AcceptBlock())
@@ -2666,12 +2752,9 @@ bool CBlock::CheckBlockSignature() const
     if (whichType == TX_PUBKEY)
     {
         valtype& vchPubKey = vSolutions[0];
-        CKey key;
-        if (!key.SetPubKey(vchPubKey))
-            return false;
         if (vchBlockSig.empty())
             return false;
-        return key.Verify(GetHash(), vchBlockSig);
+        return CPubKey(vchPubKey).Verify(GetHash(), vchBlockSig);
     }
 
     return false;
@@ -2710,24 +2793,35 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
 
 
 
-uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid) {
-    if (height == 0) {
-        // hash at height 0 is the txids themself
-        return vTxid[pos];
-    } else {
-        // calculate left hash
-        uint256 left = CalcHash(height-1, pos*2, vTxid), right;
-        // calculate right hash if not beyong the end of the array - copy left hash otherwise1
-        if (pos*2+1 < CalcTreeWidth(height-1))
-            right = CalcHash(height-1, pos*2+1, vTxid);
-        else
-            right = left;
-        // combine subhashes
-        return Hash(BEGIN(left), END(left), BEGIN(right), END(right));
+void ComputeMerkleTree(std::vector<uint256>& vTree)
+{
+    // Each pair of adjacent nodes is already laid out as one 64-byte input
+    BOOST_STATIC_ASSERT(sizeof(uint256) == 32);
+    unsigned int j = 0;
+    for (unsigned int nSize = vTree.size(); nSize > 1; nSize = (nSize + 1) / 2)
+    {
+        unsigned int nPairs = nSize / 2;
+        vTree.resize(j + nSize + (nSize + 1) / 2);
+        SHA256D64((unsigned char*)&vTree[j + nSize], (const unsigned char*)&vTree[j], nPairs);
+        // An odd node at the end of a level is paired with itself
+        if (nSize & 1)
+        {
+            const uint256& last = vTree[j + nSize - 1];
+            vTree[j + nSize + nPairs] = Hash(BEGIN(last), END(last), BEGIN(last), END(last));
+        }
+        j += nSize;
     }
 }
 
-void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch) {
+uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTree) {
+    // levels are stored one after the other, starting with the txids
+    unsigned int nOffset = 0;
+    for (int h = 0; h < height; h++)
+        nOffset += CalcTreeWidth(h);
+    return vTree[nOffset + pos];
+}
+
+void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTree, const std::vector<bool> &vMatch) {
     // determine whether this node is the parent of at least one matched txid
     bool fParentOfMatch = false;
     for (unsigned int p = pos << height; p < (pos+1) << height && p < nTransactions; p++)
@@ -2736,12 +2830,12 @@ void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const st
     vBits.push_back(fParentOfMatch);
     if (height==0 || !fParentOfMatch) {
         // if at height 0, or nothing interesting below, store hash and stop
-        vHash.push_back(CalcHash(height, pos, vTxid));
+        vHash.push_back(CalcHash(height, pos, vTree));
     } else {
         // otherwise, don't store any hash, but descend into the subtrees
-        TraverseAndBuild(height-1, pos*2, vTxid, vMatch);
+        TraverseAndBuild(height-1, pos*2, vTree, vMatch);
         if (pos*2+1 < CalcTreeWidth(height-1))
-            TraverseAndBuild(height-1, pos*2+1, vTxid, vMatch);
+            TraverseAndBuild(height-1, pos*2+1, vTree, vMatch);
     }
 }
 
@@ -2785,8 +2879,12 @@ CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256> &vTxid, const
     while (CalcTreeWidth(nHeight) > 1)
         nHeight++;
 
-    // traverse the partial tree
-    TraverseAndBuild(nHeight, 0, vTxid, vMatch);
+    // hash the whole tree once, level by level, then traverse the partial tree
+    std::vector<uint256> vTree;
+    vTree.reserve(nTransactions * 2 + 16);
+    vTree.assign(vTxid.begin(), vTxid.end());
+    ComputeMerkleTree(vTree);
+    TraverseAndBuild(nHeight, 0, vTree, vMatch);
 }
 
 CPartialMerkleTree::CPartialMerkleTree() : nTransactions(0), fBad(true) {}
@@ -2842,7 +2940,7 @@ bool CheckDiskSpace(uint64_t nAdditionalBytes)
     return true;
 }
 
-static boost::filesystem::path BlockFilePath(unsigned int nFile)
+boost::filesystem::path BlockFilePath(unsigned int nFile)
 {
     string strBlockFn = strprintf("blk%04u.dat", nFile);
     return GetDataDir() / strBlockFn;
@@ -2866,29 +2964,6 @@ FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszM
     return file;
 }
 
-static unsigned int nCurrentBlockFile = 1;
-
-FILE* AppendBlockFile(unsigned int& nFileRet)
-{
-    nFileRet = 0;
-    while (true)
-    {
-        FILE* file = OpenBlockFile(nCurrentBlockFile, 0, "ab");
-        if (!file)
-            return NULL;
-        if (fseek(file, 0, SEEK_END) != 0)
-            return NULL;
-        // FAT32 file size max 4GB, fseek and ftell max 2GB, so we must stay under 2GB
-        if (ftell(file) < (long)(0x7F000000 - MAX_SIZE))
-        {
-            nFileRet = nCurrentBlockFile;
-            return file;
-        }
-        fclose(file);
-        nCurrentBlockFile++;
-    }
-}
-
 bool LoadBlockIndex(bool fAllowNew)
 {
     CBigNum bnTrustedModulus;
@@ -2905,6 +2980,17 @@ bool LoadBlockIndex(bool fAllowNew)
         nStakeMinAge = 15 * 60; // test net min age is 1 hour
         nCoinbaseMaturity = 10; // test maturity is 10 blocks
         nModifierInterval = 60;
+
+        if (fRegTest)
+        {
+            pchMessageStart[0] = 0x30;
+            pchMessageStart[1] = 0x4A;
+            pchMessageStart[2] = 0x52;
+            pchMessageStart[3] = 0x54;
+
+            bnProofOfWorkLimit = bnProofOfWorkLimitRegTest;
+            nStakeMinAge = 60;
+        }
     }
     else
     {
@@ -2922,6 +3008,9 @@ bool LoadBlockIndex(bool fAllowNew)
     CTxDB txdb("cr+");
     if (!txdb.LoadBlockIndex())
         return false;
+    printf("LoadBlockIndex(): %" PRIszu " entries, %" PRIszu " proof-of-stake, %" PRIszu "KiB\n",
+           arenaBlockIndex.size(), arenaBlockIndexStake.size(),
+           (arenaBlockIndex.DynamicMemoryUsage() + arenaBlockIndexStake.DynamicMemoryUsage()) / 1024);
 
     //
     // Init with genesis block
@@ -2950,17 +3039,18 @@ bool LoadBlockIndex(bool fAllowNew)
         block.hashMerkleRoot = block.BuildMerkleTree();
         block.nVersion = 1;
         block.nTime    = 1521404888; // Sunday, March 18, 2018 12:00:00 PM GMT-07:00
-        block.nBits    = bnProofOfWorkLimit.GetCompact();
+        // regtest shares the testnet genesis block
+        block.nBits    = (fRegTest ? bnProofOfWorkLimitTestNet : bnProofOfWorkLimit).GetCompact();
         block.nNonce   = 145590;
         if(fTestNet)
         {
-            block.nNonce   = 0;
+            block.nNonce   = 433535;
         }
         if (false  && (block.GetHash() != hashGenesisBlock)) {
 
         // This will figure out a valid hash and Nonce if you're
         // creating a different genesis block:
-            uint256 hashTarget = CBigNum().SetCompact(block.nBits).getuint256();
+            uint256 hashTarget = arith_uint256().SetCompact(block.nBits).getuint256();
             while (block.GetHash() > hashTarget)
                {
                    ++block.nNonce;
@@ -2987,11 +3077,15 @@ bool LoadBlockIndex(bool fAllowNew)
         assert(block.GetHash() == (!fTestNet ? hashGenesisBlock : hashGenesisBlockTestNet));
         assert(block.CheckBlock());
 
-        // Start new block file
-        unsigned int nFile;
-        unsigned int nBlockPos;
-        if (!block.WriteToDisk(nFile, nBlockPos))
-            return error("LoadBlockIndex() : writing genesis block to disk failed");
+        // Start new block file, or with -reindex use the copy at its start
+        unsigned int nFile = 1;
+        unsigned int nBlockPos = sizeof(pchMessageStart) + sizeof(unsigned int);
+        CBlock blockStored;
+        if (!fReindex || !blockStored.ReadFromDisk(nFile, nBlockPos, false) || blockStored.GetHash() != block.GetHash())
+        {
+            if (!block.WriteToDisk(nFile, nBlockPos))
+                return error("LoadBlockIndex() : writing genesis block to disk failed");
+        }
         if (!block.AddToBlockIndex(nFile, nBlockPos, 0))
             return error("LoadBlockIndex() : genesis block not accepted");
 
@@ -3024,7 +3118,7 @@ void PrintBlockTree()
 {
     // pre-compute tree structure
     map<CBlockIndex*, vector<CBlockIndex*> > mapNext;
-    for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+    for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
     {
         CBlockIndex* pindex = (*mi).second;
         mapNext[pindex->pprev].push_back(pindex);
@@ -3154,6 +3248,247 @@ bool LoadExternalBlockFile(FILE* fileIn)
     return nLoaded > 0;
 }
 
+// Blocks read ahead of the one being connected during -reindex
+static const unsigned int MAX_REINDEX_QUEUE_BYTES = 64 * 1024 * 1024;
+
+/** -reindex pipeline: a reader thread scans the block files, worker threads
+ *  deserialize, hash and run the context-free CheckBlock(), and the caller
+ *  connects the blocks in file order.
+ */
+class CReindexQueue
+{
+public:
+    struct CItem
+    {
+        unsigned int nFile;
+        unsigned int nBlockPos;
+        unsigned int nSize;
+        std::vector<unsigned char> vchBlock;
+        CBlock block;
+        uint256 hash;
+        bool fValid;
+        bool fDone;
+    };
+
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<CItem*> queue;           // in file order, for the caller
+    std::deque<CItem*> queueUnchecked;  // for the workers
+    unsigned int nQueuedBytes;
+    bool fReaderDone;
+    bool fStop;
+    boost::thread_group threads;
+
+    void ReaderThread();
+    void WorkerThread();
+
+public:
+    CReindexQueue() : nQueuedBytes(0), fReaderDone(false), fStop(false) {}
+    ~CReindexQueue() { Stop(); }
+
+    void Start(int nThreads);
+    void Stop();
+
+    // Next block in file order once it has been checked; NULL at the end.
+    // The caller owns the item.
+    CItem* Pop();
+};
+
+void CReindexQueue::Start(int nThreads)
+{
+    threads.create_thread(boost::bind(&CReindexQueue::ReaderThread, this));
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CReindexQueue::WorkerThread, this));
+}
+
+void CReindexQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        cond.notify_all();
+    }
+    threads.join_all();
+
+    BOOST_FOREACH(CItem* item, queue)
+        delete item;
+    queue.clear();
+    queueUnchecked.clear();
+}
+
+void CReindexQueue::ReaderThread()
+{
+    RenameThread("MotaCoin-reindex");
+    try
+    {
+        for (unsigned int nFile = 1; ; nFile++)
+        {
+            FILE* file = OpenBlockFile(nFile, 0, "rb");
+            if (!file)
+                break;
+            CBlockFileScanner scanner(file);
+            CItem* item = new CItem();
+            while (scanner.Next(item->nBlockPos, item->vchBlock))
+            {
+                item->nFile = nFile;
+                item->nSize = item->vchBlock.size();
+                item->fValid = false;
+                item->fDone = false;
+
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fStop && !queue.empty() && nQueuedBytes + item->nSize > MAX_REINDEX_QUEUE_BYTES)
+                    cond.wait(lock);
+                if (fStop)
+                    break;
+                queue.push_back(item);
+                queueUnchecked.push_back(item);
+                nQueuedBytes += item->nSize;
+                cond.notify_all();
+                item = new CItem();
+            }
+            delete item;
+            if (fStop)
+                break;
+        }
+    }
+    catch (std::exception& e) {
+        PrintExceptionContinue(&e, "CReindexQueue::ReaderThread()");
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fReaderDone = true;
+    cond.notify_all();
+}
+
+void CReindexQueue::WorkerThread()
+{
+    RenameThread("MotaCoin-reindexchk");
+    while (true)
+    {
+        CItem* item;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStop && queueUnchecked.empty())
+                cond.wait(lock);
+            if (fStop)
+                return;
+            item = queueUnchecked.front();
+            queueUnchecked.pop_front();
+        }
+
+        try {
+            CMemoryReader reader(&item->vchBlock[0], &item->vchBlock[0] + item->vchBlock.size(), SER_DISK, CLIENT_VERSION);
+            reader >> item->block;
+            item->hash = item->block.GetHash();
+            item->fValid = item->block.CheckBlock(true, true, false);
+            item->block.fChecked = item->fValid;
+        }
+        catch (std::exception& e) {
+            item->fValid = false;
+        }
+        std::vector<unsigned char>().swap(item->vchBlock);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        item->fDone = true;
+        cond.notify_all();
+    }
+}
+
+CReindexQueue::CItem* CReindexQueue::Pop()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!fStop && !(queue.empty() ? fReaderDone : queue.front()->fDone))
+        cond.wait(lock);
+    if (fStop || queue.empty())
+        return NULL;
+    CItem* item = queue.front();
+    queue.pop_front();
+    nQueuedBytes -= item->nSize;
+    cond.notify_all();
+    return item;
+}
+
+// Connect a block read back from the block files at its stored position.
+// CheckBlock() has already run; the proof-of-stake block signature is only
+// verified past the last checkpoint, below it the chain is fixed by the
+// checkpoint hashes.
+static bool ReindexAcceptBlock(CReindexQueue::CItem* item)
+{
+    LOCK(cs_main);
+    CBlock& block = item->block;
+    if (mapBlockIndex.count(item->hash))
+        return false;
+    if (block.IsProofOfStake())
+    {
+        if (setStakeSeen.count(block.GetProofOfStake()))
+            return error("ReindexAcceptBlock() : duplicate proof-of-stake for block %s", item->hash.ToString().c_str());
+        int nHeight = mapBlockIndex[block.hashPrevBlock]->nHeight + 1;
+        if (nHeight > Checkpoints::GetTotalBlocksEstimate() && !block.CheckBlockSignature())
+            return error("ReindexAcceptBlock() : bad proof-of-stake block signature in block %s", item->hash.ToString().c_str());
+    }
+    return block.AcceptBlock(item->nFile, item->nBlockPos);
+}
+
+// Rebuild the block index and transaction index from the blk*.dat files in
+// place, without ProcessBlock() or copying any block data
+bool ReindexBlockFiles()
+{
+    int64_t nStart = GetTimeMillis();
+    int nThreads = max((int)boost::thread::hardware_concurrency() - 1, 1);
+    printf("Reindexing block files using %d threads\n", nThreads);
+
+    int nLoaded = 0;
+    int nSkipped = 0;
+    multimap<uint256, CReindexQueue::CItem*> mapWaiting; // blocks stored before their parent, by parent hash
+    CReindexQueue reindexqueue;
+    reindexqueue.Start(nThreads);
+    CReindexQueue::CItem* item;
+    while (!fRequestShutdown && (item = reindexqueue.Pop()) != NULL)
+    {
+        if (!item->fValid || mapBlockIndex.count(item->hash))
+        {
+            nSkipped++;
+            delete item;
+            continue;
+        }
+        if (!mapBlockIndex.count(item->block.hashPrevBlock))
+        {
+            mapWaiting.insert(make_pair(item->block.hashPrevBlock, item));
+            continue;
+        }
+
+        vector<CReindexQueue::CItem*> vWorkQueue;
+        vWorkQueue.push_back(item);
+        for (unsigned int i = 0; i < vWorkQueue.size(); i++)
+        {
+            CReindexQueue::CItem* itemConnect = vWorkQueue[i];
+            if (ReindexAcceptBlock(itemConnect))
+            {
+                if (++nLoaded % 10000 == 0)
+                    printf("Reindexed %d blocks, height %d\n", nLoaded, nBestHeight);
+                multimap<uint256, CReindexQueue::CItem*>::iterator mi = mapWaiting.lower_bound(itemConnect->hash);
+                while (mi != mapWaiting.upper_bound(itemConnect->hash))
+                {
+                    vWorkQueue.push_back((*mi).second);
+                    mapWaiting.erase(mi++);
+                }
+            }
+            else
+                nSkipped++;
+            delete itemConnect;
+        }
+    }
+    reindexqueue.Stop();
+
+    nSkipped += mapWaiting.size();
+    for (multimap<uint256, CReindexQueue::CItem*>::iterator mi = mapWaiting.begin(); mi != mapWaiting.end(); ++mi)
+        delete (*mi).second;
+
+    printf("Reindexed %d blocks (%d skipped), height %d, in %" PRId64 "ms\n", nLoaded, nSkipped, nBestHeight, GetTimeMillis() - nStart);
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CAlert
@@ -3244,6 +3579,7 @@ bool static AlreadyHave(CTxDB& txdb, const CInv& inv)
             txInMap = (mempool.exists(inv.hash));
             }
         return txInMap ||
+               txadmission.IsQueued(inv.hash) ||
                mapOrphanTransactions.count(inv.hash) ||
                txdb.ContainsTx(inv.hash);
         }
@@ -3264,11 +3600,247 @@ bool static AlreadyHave(CTxDB& txdb, const CInv& inv)
 // a large 4-byte int at any alignment.
 unsigned char pchMessageStart[4] = { 0x30, 0x4A, 0x30, 0x4A };
 
+// The part of CTxMemPool::accept that depends neither on the chain tip nor
+// on the memory pool contents. Scripts are verified against whichever inputs
+// can be read, so that ConnectInputs finds their signatures in the signature
+// cache when it runs again under cs_main. Does not need cs_main.
+bool static PrecheckTransaction(CTransaction& tx)
+{
+    if (!tx.CheckTransaction())
+        return error("PrecheckTransaction() : CheckTransaction failed");
+
+    if (tx.IsCoinBase())
+        return tx.DoS(100, error("PrecheckTransaction() : coinbase as individual tx"));
+
+    if (tx.IsCoinStake())
+        return tx.DoS(100, error("PrecheckTransaction() : coinstake as individual tx"));
+
+    if ((int64_t)tx.nLockTime > std::numeric_limits<int>::max())
+        return error("PrecheckTransaction() : not accepting nLockTime beyond 2038 yet");
+
+    if (!fTestNet && !tx.IsStandard())
+        return error("PrecheckTransaction() : nonstandard transaction type");
+
+    CTxDB txdb("r");
+    CSignatureHasher hasher(tx);
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        const COutPoint& prevout = tx.vin[i].prevout;
+        CTransaction txPrev;
+        bool fFound = false;
+        {
+            LOCK(mempool.cs);
+            if (mempool.exists(prevout.hash))
+            {
+                txPrev = mempool.lookup(prevout.hash);
+                fFound = true;
+            }
+        }
+        // Missing or out of range inputs are left for the commit stage to judge
+        if (!fFound && !txdb.ReadDiskTx(prevout.hash, txPrev))
+            continue;
+        if (prevout.n >= txPrev.vout.size())
+            continue;
+
+        if (!VerifySignature(txPrev, tx, i, 0, &hasher))
+            return tx.DoS(100, error("PrecheckTransaction() : %s VerifySignature failed", tx.GetHash().ToString().substr(0,10).c_str()));
+    }
+
+    return true;
+}
+
+// Commit a transaction from pfrom (NULL for an orphan whose parents have
+// arrived) to the memory pool, and retry the orphans that depended on it.
+// Requires cs_main.
+void static ProcessTransaction(CNode* pfrom, CTransaction& tx)
+{
+    vector<uint256> vWorkQueue;
+    vector<uint256> vEraseQueue;
+    CTxDB txdb("r");
+    CInv inv(MSG_TX, tx.GetHash());
+
+    bool fMissingInputs = false;
+    if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: checking AcceptToMemoryPool\n");
+    if (tx.AcceptToMemoryPool(txdb, true, &fMissingInputs))
+    {
+        if (pfrom == NULL)
+            printf("   accepted orphan tx %s\n", inv.hash.ToString().substr(0,10).c_str());
+        if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: Accepted to memory pool\n");
+        SyncWithWallets(tx, NULL, true);
+        if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: Synced with wallet\n");
+        RelayTransaction(tx, inv.hash);
+        if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: Relayed transaction\n");
+        mapAlreadyAskedFor.erase(inv);
+        vWorkQueue.push_back(inv.hash);
+        vEraseQueue.push_back(inv.hash);
+
+        if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: Processing orphans\n");
+        // Recursively process any orphan transactions that depended on this one
+        for (unsigned int i = 0; i < vWorkQueue.size(); i++)
+        {
+            uint256 hashPrev = vWorkQueue[i];
+            for (set<uint256>::iterator mi = mapOrphanTransactionsByPrev[hashPrev].begin();
+                 mi != mapOrphanTransactionsByPrev[hashPrev].end();
+                 ++mi)
+            {
+                const uint256& orphanTxHash = *mi;
+                CTransaction& orphanTx = mapOrphanTransactions[orphanTxHash];
+                bool fMissingInputs2 = false;
+
+                // Let the admission workers verify it; they commit it
+                // (and its own orphans) through this function
+                if (txadmission.Push(NULL, orphanTx))
+                    continue;
+
+                if (orphanTx.AcceptToMemoryPool(txdb, true, &fMissingInputs2))
+                {
+                    printf("   accepted orphan tx %s\n", orphanTxHash.ToString().substr(0,10).c_str());
+                    SyncWithWallets(orphanTx, NULL, true);
+                    RelayTransaction(orphanTx, orphanTxHash);
+                    mapAlreadyAskedFor.erase(CInv(MSG_TX, orphanTxHash));
+                    vWorkQueue.push_back(orphanTxHash);
+                    vEraseQueue.push_back(orphanTxHash);
+                }
+                else if (!fMissingInputs2)
+                {
+                    // invalid orphan
+                    vEraseQueue.push_back(orphanTxHash);
+                    printf("   removed invalid orphan tx %s\n", orphanTxHash.ToString().substr(0,10).c_str());
+                }
+            }
+        }
+
+        if (LogAccept(LOG_MEMPOOL)) printf("ProcessMessage-tx: Erasing orphans\n");
+        BOOST_FOREACH(uint256 hash, vEraseQueue)
+            EraseOrphanTx(hash);
+    }
+    else if (fMissingInputs)
+    {
+        AddOrphanTx(tx);
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nEvicted = LimitOrphanTxSize(MAX_ORPHAN_TRANSACTIONS);
+        if (nEvicted > 0)
+            printf("mapOrphan overflow, removed %u tx\n", nEvicted);
+    }
+    else if (pfrom == NULL)
+    {
+        // invalid orphan
+        EraseOrphanTx(inv.hash);
+        printf("   removed invalid orphan tx %s\n", inv.hash.ToString().substr(0,10).c_str());
+    }
+    if (pfrom && tx.nDoS) pfrom->Misbehaving(tx.nDoS);
+}
+
+void CTxAdmissionQueue::Start(int nThreads)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (fRunning || nThreads <= 0)
+        return;
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CTxAdmissionQueue::Thread, this));
+    fRunning = true;
+    printf("Transaction admission using %d threads\n", nThreads);
+}
+
+void CTxAdmissionQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fRunning)
+            return;
+        fRunning = false;
+        cond.notify_all();
+    }
+    threads.join_all();
+
+    // Whatever was still queued is dropped; peers will announce it again
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (std::deque<std::pair<CNode*, CTransaction> >::iterator it = queue.begin(); it != queue.end(); ++it)
+        if (it->first)
+            it->first->Release();
+    queue.clear();
+    setQueued.clear();
+}
+
+bool CTxAdmissionQueue::Push(CNode* pfrom, const CTransaction& tx)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    // A full queue pushes back: the caller then processes inline under
+    // cs_main, which throttles the message handler thread
+    if (!fRunning || queue.size() >= MAX_TX_ADMISSION_QUEUE)
+        return false;
+    if (!setQueued.insert(tx.GetHash()).second)
+        return true;
+    if (pfrom)
+        pfrom->AddRef();
+    queue.push_back(std::make_pair(pfrom, tx));
+    cond.notify_one();
+    return true;
+}
+
+bool CTxAdmissionQueue::IsQueued(const uint256& hash)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return setQueued.count(hash) != 0;
+}
+
+void CTxAdmissionQueue::Thread()
+{
+    RenameThread("MotaCoin-txadmit");
+    while (true)
+    {
+        std::pair<CNode*, CTransaction> item;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (fRunning && queue.empty())
+                cond.wait(lock);
+            if (!fRunning)
+                return;
+            item = queue.front();
+            queue.pop_front();
+        }
+        CNode* pfrom = item.first;
+        CTransaction& tx = item.second;
+        uint256 hash = tx.GetHash();
+
+        try
+        {
+            // Orphans are always committed, so the orphan pool is updated
+            // whatever the outcome; peers' transactions that fail the
+            // pre-check are dropped here, taking cs_main only to score the
+            // peer, as the message handler does
+            if (PrecheckTransaction(tx) || pfrom == NULL)
+            {
+                LOCK(cs_main);
+                if (!fShutdown)
+                    ProcessTransaction(pfrom, tx);
+            }
+            else if (tx.nDoS)
+            {
+                LOCK(cs_main);
+                pfrom->Misbehaving(tx.nDoS);
+            }
+        }
+        catch (std::exception& e) {
+            PrintExceptionContinue(&e, "CTxAdmissionQueue::Thread()");
+        } catch (...) {
+            PrintExceptionContinue(NULL, "CTxAdmissionQueue::Thread()");
+        }
+
+        if (pfrom)
+            pfrom->Release();
+        boost::unique_lock<boost::mutex> lock(mutex);
+        setQueued.erase(hash);
+    }
+}
+
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 {
     static map<CService, CPubKey> mapReuseKey;
     RandAddSeedPerfmon();
-    if (fDebug)
+    if (LogAccept(LOG_NET))
         printf("received: %s (%" PRIszu " bytes) from %s\n", strCommand.c_str(), vRecv.size(), pfrom->addrName.c_str());
     if (mapArgs.count("-dropmessagestest") && GetRand(atoi(mapArgs["-dropmessagestest"])) == 0)
     {
@@ -3569,7 +4141,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             pfrom->AddInventoryKnown(inv);
 
             bool fAlreadyHave = AlreadyHave(txdb, inv);
-            if (fDebug)
+            if (LogAccept(LOG_NET))
                 printf("  got inventory: %s  %s\n", inv.ToString().c_str(), fAlreadyHave ? "have" : "new");
 
             if (!fAlreadyHave)
@@ -3581,7 +4153,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 // the last block in an inv bundle sent in response to getblocks. Try to detect
                 // this situation and push another getblocks to continue.
                 pfrom->PushGetBlocks(mapBlockIndex[inv.hash], uint256(0));
-                if (fDebug)
+                if (LogAccept(LOG_NET))
                     printf("force request: %s\n", inv.ToString().c_str());
             }
 
@@ -3601,20 +4173,20 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             return error("message getdata size() = %" PRIszu "", vInv.size());
         }
 
-        if (fDebugNet || (vInv.size() != 1))
+        if (LogAccept(LOG_NET) || (vInv.size() != 1))
             printf("received getdata (%" PRIszu " invsz)\n", vInv.size());
 
         BOOST_FOREACH(const CInv& inv, vInv)
         {
             if (fShutdown)
                 return true;
-            if (fDebugNet || (vInv.size() == 1))
+            if (LogAccept(LOG_NET) || (vInv.size() == 1))
                 printf("received getdata for: %s\n", inv.ToString().c_str());
 
             if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
             {
                 // Send block from disk
-                map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
+                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end())
                 {
                     CBlock block;
@@ -3732,7 +4304,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         CSyncCheckpoint checkpoint;
         vRecv >> checkpoint;
 
-        if (checkpoint.ProcessSyncCheckpoint(pfrom))
+        // regtest runs without sync checkpoints
+        if (!fRegTest && checkpoint.ProcessSyncCheckpoint(pfrom))
         {
             // Relay
             pfrom->hashCheckpointKnown = checkpoint.hashCheckpoint;
@@ -3754,7 +4327,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         {
             // If locator is null, return the hashStop block
             printf("If locator is null, return the hashStop block\n");
-            map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashStop);
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
             if (mi == mapBlockIndex.end())
                 return true;
             pindex = (*mi).second;
@@ -3779,83 +4352,25 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 break;
         }
         
-        if (fDebug) printf("Pushing headers\n");    
+        if (LogAccept(LOG_NET)) printf("Pushing headers\n");    
         pfrom->PushMessage("headers", vHeaders);
-        if (fDebug) printf("Pushed headers\n");    
+        if (LogAccept(LOG_NET)) printf("Pushed headers\n");    
     }
 
 
     else if (strCommand == "tx")
     {
-        vector<uint256> vWorkQueue;
-        vector<uint256> vEraseQueue;
-        CDataStream vMsg(vRecv);
-        CTxDB txdb("r");
         CTransaction tx;
         vRecv >> tx;
-        
-        
+
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        bool fMissingInputs = false;
-        if (fDebug) printf("ProcessMessage-tx: checking AcceptToMemoryPool\n");
-        if (tx.AcceptToMemoryPool(txdb, true, &fMissingInputs))
+        if (!txadmission.Push(pfrom, tx))
         {
-            if (fDebug) printf("ProcessMessage-tx: Accepted to memory pool\n");
-            SyncWithWallets(tx, NULL, true);
-            if (fDebug) printf("ProcessMessage-tx: Synced with wallet\n");
-            RelayTransaction(tx, inv.hash);
-            if (fDebug) printf("ProcessMessage-tx: Relayed transaction\n");
-            mapAlreadyAskedFor.erase(inv);
-            vWorkQueue.push_back(inv.hash);
-            vEraseQueue.push_back(inv.hash);
-
-            if (fDebug) printf("ProcessMessage-tx: Processing orphans\n");
-        // Recursively process any orphan transactions that depended on this one
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++)
-            {
-                uint256 hashPrev = vWorkQueue[i];
-                for (set<uint256>::iterator mi = mapOrphanTransactionsByPrev[hashPrev].begin();
-                     mi != mapOrphanTransactionsByPrev[hashPrev].end();
-                     ++mi)
-                {
-                    const uint256& orphanTxHash = *mi;
-                    CTransaction& orphanTx = mapOrphanTransactions[orphanTxHash];
-                    bool fMissingInputs2 = false;
-
-                    if (orphanTx.AcceptToMemoryPool(txdb, true, &fMissingInputs2))
-                    {
-                        printf("   accepted orphan tx %s\n", orphanTxHash.ToString().substr(0,10).c_str());
-                        SyncWithWallets(tx, NULL, true);
-                        RelayTransaction(orphanTx, orphanTxHash);
-                        mapAlreadyAskedFor.erase(CInv(MSG_TX, orphanTxHash));
-                        vWorkQueue.push_back(orphanTxHash);
-                        vEraseQueue.push_back(orphanTxHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        // invalid orphan
-                        vEraseQueue.push_back(orphanTxHash);
-                        printf("   removed invalid orphan tx %s\n", orphanTxHash.ToString().substr(0,10).c_str());
-                    }
-                }
-            }
-            
-            if (fDebug) printf("ProcessMessage-tx: Erasing orphans\n");
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
-                EraseOrphanTx(hash);
-        }
-        else if (fMissingInputs)
-        {
-            AddOrphanTx(tx);
-
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-            unsigned int nEvicted = LimitOrphanTxSize(MAX_ORPHAN_TRANSACTIONS);
-            if (nEvicted > 0)
-                printf("mapOrphan overflow, removed %u tx\n", nEvicted);
+            LOCK(cs_main);
+            ProcessTransaction(pfrom, tx);
         }
-        if (tx.nDoS) pfrom->Misbehaving(tx.nDoS);
     }
 
 
@@ -4076,6 +4591,25 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
     return true;
 }
 
+// Timing name of a message. Peers can send any command string, so the ones
+// ProcessMessage ignores are all counted together.
+static const char* GetMessagePerfName(const string& strCommand)
+{
+    static const char* const pszMessages[][2] = {
+        { "version", "msg.version" }, { "verack", "msg.verack" }, { "addr", "msg.addr" },
+        { "inv", "msg.inv" }, { "getdata", "msg.getdata" }, { "getblocks", "msg.getblocks" },
+        { "checkpoint", "msg.checkpoint" }, { "getheaders", "msg.getheaders" }, { "tx", "msg.tx" },
+        { "block", "msg.block" }, { "getaddr", "msg.getaddr" }, { "mempool", "msg.mempool" },
+        { "checkorder", "msg.checkorder" }, { "reply", "msg.reply" }, { "ping", "msg.ping" },
+        { "alert", "msg.alert" }, { "filterload", "msg.filterload" }, { "filteradd", "msg.filteradd" },
+        { "filterclear", "msg.filterclear" },
+    };
+    for (unsigned int i = 0; i < ARRAYLEN(pszMessages); i++)
+        if (strCommand == pszMessages[i][0])
+            return pszMessages[i][1];
+    return "msg.other";
+}
+
 bool ProcessMessages(CNode* pfrom)
 {
     CDataStream& vRecv = pfrom->vRecv;
@@ -4167,6 +4701,7 @@ bool ProcessMessages(CNode* pfrom)
         {
             {
                 LOCK(cs_main);
+                CPerfTimer timer(GetMessagePerfName(strCommand));
                 fRet = ProcessMessage(pfrom, strCommand, vMsg);
             }
             if (fShutdown)
@@ -4345,7 +4880,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             const CInv& inv = (*pto->mapAskFor.begin()).second;
             if (!AlreadyHave(txdb, inv))
             {
-                if (fDebugNet)
+                if (LogAccept(LOG_NET))
                     printf("sending getdata: %s\n", inv.ToString().c_str());
                 vGetData.push_back(inv);
                 if (vGetData.size() >= 1000)
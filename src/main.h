@@ -11,13 +11,20 @@
 #endif
 
 #include "bignum.h"
+#include "arith_uint256.h"
+#include "hash.h"
 #include "sync.h"
 #include "net.h"
 #include "script.h"
 #include "scrypt.h"
 #include "hashblock.h"
+#include "blockfile.h"
+#include "perfstats.h"
 
 #include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 
 class CWallet;
 class CBlock;
@@ -37,6 +44,8 @@ static const unsigned int MAX_BLOCK_SIZE = 1000000;
 static const unsigned int MAX_BLOCK_SIZE_GEN = MAX_BLOCK_SIZE/2;
 static const unsigned int MAX_BLOCK_SIGOPS = MAX_BLOCK_SIZE/50;
 static const unsigned int MAX_ORPHAN_TRANSACTIONS = MAX_BLOCK_SIZE/100;
+/** Transactions waiting for the admission workers before peers are throttled */
+static const unsigned int MAX_TX_ADMISSION_QUEUE = 5000;
 static const unsigned int MAX_INV_SZ = 50000;
 static const int64_t MIN_TX_FEE = 0.0000002* COIN;
 static const int64_t MIN_RELAY_TX_FEE = MIN_TX_FEE;
@@ -62,10 +71,13 @@ static const int fHaveUPnP = false;
 #endif
 
 static const uint256 hashGenesisBlock("00000fea25f87416682baa54946a1d156909d0959588eb573a0ae16a64230c61");
-static const uint256 hashGenesisBlockTestNet("00000fea25f87416682baa54946a1d156909d0959588eb573a0ae16a64230c61");
+static const uint256 hashGenesisBlockTestNet("000074ecbcba4154ec07e304bef33ba03a6bedc731be4d821d318602e291410f");
 
 inline int64_t GetClockDrift(int64_t nTime)
 {
+	// generate outruns the clock by a second every few blocks on regtest
+	if(fRegTest)
+		return 2 * 60 * 60;
 	if(nTime < BLOCK_SWITCH_TIME)
 		return 30 * 60;
 	else
@@ -75,8 +87,8 @@ inline int64_t GetClockDrift(int64_t nTime)
 extern int64_t devCoin;
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
-extern std::map<uint256, CBlockIndex*> mapBlockIndex;
-extern std::set<std::pair<COutPoint, unsigned int> > setStakeSeen;
+typedef std::unordered_map<uint256, CBlockIndex*, CSaltedHasher> BlockMap;
+extern BlockMap mapBlockIndex;
 extern CBlockIndex* pindexGenesisBlock;
 extern unsigned int nStakeMinAge;
 extern unsigned int nNodeLifespan;
@@ -95,7 +107,7 @@ extern int64_t nTimeBestReceived;
 extern CCriticalSection cs_setpwalletRegistered;
 extern std::set<CWallet*> setpwalletRegistered;
 extern unsigned char pchMessageStart[4];
-extern std::map<uint256, CBlock*> mapOrphanBlocks;
+extern std::unordered_map<uint256, CBlock*, CSaltedHasher> mapOrphanBlocks;
 extern std::map<unsigned int, unsigned int> mapHashedBlocks; // for liteStake
 
 // Settings
@@ -108,6 +120,7 @@ extern unsigned int nDerivationMethodIndex;
 
 extern bool fEnforceCanonical;
 extern bool fMinimizeCoinAge;
+extern bool fReindex;
 
 // Minimum disk space required - used in CheckDiskSpace()
 static const uint64_t nMinDiskSpace = 52428800;
@@ -121,16 +134,20 @@ void UnregisterWallet(CWallet* pwalletIn);
 void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL, bool fUpdate = false, bool fConnect = true);
 bool ProcessBlock(CNode* pfrom, CBlock* pblock);
 bool CheckDiskSpace(uint64_t nAdditionalBytes=0);
+boost::filesystem::path BlockFilePath(unsigned int nFile);
 FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode="rb");
-FILE* AppendBlockFile(unsigned int& nFileRet);
 bool LoadBlockIndex(bool fAllowNew=true);
 void PrintBlockTree();
 CBlockIndex* FindBlockByHeight(int nHeight);
 bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 bool LoadExternalBlockFile(FILE* fileIn);
+bool ReindexBlockFiles();
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits);
+/** Extend vTree, which holds the leaves of a merkle tree, with each higher
+ *  level up to the root. Every level is hashed in one SHA256D64 batch. */
+void ComputeMerkleTree(std::vector<uint256>& vTree);
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake);
 int64_t GetProofOfWorkReward(int nHeight, int64_t nFees);
 int64_t GetProofOfStakeReward(int64_t nCoinAge, unsigned int nBits, unsigned int nTime, int64_t nFees, int64_t nValueIn, uint256 prevHash);
@@ -253,6 +270,25 @@ public:
     }
 };
 
+/** Salted hasher for outpoint-keyed unordered containers */
+class COutPointHasher : private CSaltedHasher
+{
+public:
+    size_t operator()(const COutPoint& prevout) const
+    {
+        return CSaltedHasher::operator()(prevout.hash, prevout.n);
+    }
+
+    // (prevout, time) pairs identifying a coinstake
+    size_t operator()(const std::pair<COutPoint, unsigned int>& stake) const
+    {
+        return (*this)(stake.first) ^ stake.second;
+    }
+};
+
+typedef std::unordered_set<std::pair<COutPoint, unsigned int>, COutPointHasher> StakeSeenSet;
+extern StakeSeenSet setStakeSeen;
+
 
 
 
@@ -598,6 +634,13 @@ public:
 
     bool ReadFromDisk(CDiskTxPos pos, FILE** pfileRet=NULL)
     {
+        if (!pfileRet)
+        {
+            if (!blockfiles.Read(pos.nFile, pos.nTxPos, *this, SER_DISK))
+                return error("CTransaction::ReadFromDisk() : deserialize or I/O error");
+            return true;
+        }
+
         CAutoFile filein = CAutoFile(OpenBlockFile(pos.nFile, 0, pfileRet ? "rb+" : "rb"), SER_DISK, CLIENT_VERSION);
         if (!filein)
             return error("CTransaction::ReadFromDisk() : OpenBlockFile failed");
@@ -821,11 +864,11 @@ protected:
         return (nTransactions+(1 << height)-1) >> height;
     }
 
-    // calculate the hash of a node in the merkle tree (at leaf level: the txid's themself)
-    uint256 CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid);
+    // look up the hash of a node in the full merkle tree built by ComputeMerkleTree (at leaf level: the txid's themself)
+    uint256 CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTree);
 
     // recursive function that traverses tree nodes, storing the data as bits and hashes
-    void TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch);
+    void TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTree, const std::vector<bool> &vMatch);
 
     // recursive function that traverses tree nodes, consuming the bits and hashes produced by TraverseAndBuild.
     // it returns the hash of the respective node.
@@ -928,15 +971,23 @@ public:
 };
 
 
-/**  A txdb record that contains the disk location of a transaction and the
- * locations of transactions that spend its outputs.  vSpent is really only
- * used as a flag, but having the location is very helpful for debugging.
+/**  A txdb record that contains the disk location of a transaction and which
+ * of its outputs are spent.  The locations of the spending transactions are
+ * only needed for debugging, so they live in a separate table that is kept
+ * only with -txindexspenders.
  */
 class CTxIndex
 {
+private:
+    // Spent flag of each output
+    std::vector<bool> vfSpent;
+
+    // Spending positions set (or, when null, cleared) since this record was
+    // read; written to the optional spender table by CTxDB::UpdateTxIndex
+    std::map<unsigned int, CDiskTxPos> mapSpenders;
+
 public:
     CDiskTxPos pos;
-    std::vector<CDiskTxPos> vSpent;
 
     CTxIndex()
     {
@@ -946,21 +997,42 @@ public:
     CTxIndex(const CDiskTxPos& posIn, unsigned int nOutputs)
     {
         pos = posIn;
-        vSpent.resize(nOutputs);
+        vfSpent.resize(nOutputs);
     }
 
+    // The spent flags are stored as a bitmap, the position as varints; see
+    // CTxDB::ReadTxSpender for the positions of the spending transactions
     IMPLEMENT_SERIALIZE
     (
         if (!(nType & SER_GETHASH))
             READWRITE(nVersion);
-        READWRITE(pos);
-        READWRITE(vSpent);
+        CTxIndex &us = *(const_cast<CTxIndex*>(this));
+        READWRITE(VARINT(us.pos.nFile));
+        READWRITE(VARINT(us.pos.nBlockPos));
+        READWRITE(VARINT(us.pos.nTxPos));
+        unsigned int nOutputs = vfSpent.size();
+        READWRITE(VARINT(nOutputs));
+        std::vector<unsigned char> vBytes((nOutputs + 7) / 8);
+        if (fRead) {
+            if (!vBytes.empty())
+                READWRITE(REF(CFlatData(&vBytes[0], &vBytes[0] + vBytes.size())));
+            us.vfSpent.resize(nOutputs);
+            for (unsigned int p = 0; p < nOutputs; p++)
+                us.vfSpent[p] = (vBytes[p / 8] & (1 << (p % 8))) != 0;
+            us.mapSpenders.clear();
+        } else {
+            for (unsigned int p = 0; p < nOutputs; p++)
+                vBytes[p / 8] |= vfSpent[p] << (p % 8);
+            if (!vBytes.empty())
+                READWRITE(REF(CFlatData(&vBytes[0], &vBytes[0] + vBytes.size())));
+        }
     )
 
     void SetNull()
     {
         pos.SetNull();
-        vSpent.clear();
+        vfSpent.clear();
+        mapSpenders.clear();
     }
 
     bool IsNull()
@@ -968,10 +1040,50 @@ public:
         return pos.IsNull();
     }
 
+    unsigned int GetOutputCount() const
+    {
+        return vfSpent.size();
+    }
+
+    void SetOutputCount(unsigned int nOutputs)
+    {
+        vfSpent.resize(nOutputs);
+    }
+
+    bool IsSpent(unsigned int n) const
+    {
+        return vfSpent[n];
+    }
+
+    bool IsFullySpent() const
+    {
+        for (unsigned int n = 0; n < vfSpent.size(); n++)
+            if (!vfSpent[n])
+                return false;
+        return true;
+    }
+
+    void MarkSpent(unsigned int n, const CDiskTxPos& posSpender)
+    {
+        vfSpent[n] = true;
+        mapSpenders[n] = posSpender;
+    }
+
+    void MarkUnspent(unsigned int n)
+    {
+        vfSpent[n] = false;
+        mapSpenders[n].SetNull();
+    }
+
+    const std::map<unsigned int, CDiskTxPos>& GetChangedSpenders() const
+    {
+        return mapSpenders;
+    }
+
     friend bool operator==(const CTxIndex& a, const CTxIndex& b)
     {
-        return (a.pos    == b.pos &&
-                a.vSpent == b.vSpent);
+        return (a.pos     == b.pos &&
+                a.vfSpent == b.vfSpent);
     }
 
     friend bool operator!=(const CTxIndex& a, const CTxIndex& b)
@@ -1012,6 +1124,10 @@ public:
     mutable int nDoS;
     bool DoS(int nDoSIn, bool fIn) const { nDoS += nDoSIn; return fIn; }
 
+    // memory only: CheckBlock() with proof-of-work and merkle root checks
+    // already passed for this object (set by -reindex), ConnectBlock skips it
+    mutable bool fChecked;
+
     CBlock()
     {
         SetNull();
@@ -1047,6 +1163,7 @@ public:
         vchBlockSig.clear();
         vMerkleTree.clear();
         nDoS = 0;
+        fChecked = false;
     }
 
 	CBlockHeader GetBlockHeader() const
@@ -1099,19 +1216,10 @@ public:
     uint256 BuildMerkleTree() const
     {
         vMerkleTree.clear();
+        vMerkleTree.reserve(vtx.size() * 2 + 16);
         BOOST_FOREACH(const CTransaction& tx, vtx)
             vMerkleTree.push_back(tx.GetHash());
-        int j = 0;
-        for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
-        {
-            for (int i = 0; i < nSize; i += 2)
-            {
-                int i2 = std::min(i+1, nSize-1);
-                vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                                           BEGIN(vMerkleTree[j+i2]), END(vMerkleTree[j+i2])));
-            }
-            j += nSize;
-        }
+        ComputeMerkleTree(vMerkleTree);
         return (vMerkleTree.empty() ? 0 : vMerkleTree.back());
     }
 
@@ -1155,48 +1263,23 @@ public:
 
     bool WriteToDisk(unsigned int& nFileRet, unsigned int& nBlockPosRet)
     {
-        // Open history file to append
-        CAutoFile fileout = CAutoFile(AppendBlockFile(nFileRet), SER_DISK, CLIENT_VERSION);
-        if (!fileout)
-            return error("CBlock::WriteToDisk() : AppendBlockFile failed");
-
-        // Write index header
-        unsigned int nSize = fileout.GetSerializeSize(*this);
-        fileout << FLATDATA(pchMessageStart) << nSize;
-
-        // Write block
-        long fileOutPos = ftell(fileout);
-        if (fileOutPos < 0)
-            return error("CBlock::WriteToDisk() : ftell failed");
-        nBlockPosRet = fileOutPos;
-        fileout << *this;
-
-        // Flush stdio buffers and commit to disk before returning
-        fflush(fileout);
-        if (!IsInitialBlockDownload() || (nBestHeight+1) % 500 == 0)
-            FileCommit(fileout);
-
+        // Append to the open history file; it is fsynced according to -blocksync
+        if (!blockwriter.Append(*this, nFileRet, nBlockPosRet))
+            return error("CBlock::WriteToDisk() : append to block file failed");
         return true;
     }
 
     bool ReadFromDisk(unsigned int nFile, unsigned int nBlockPos, bool fReadTransactions=true)
     {
+        CPerfTimer timer(fReadTransactions ? "block.read" : "block.readheader");
         SetNull();
 
-        // Open history file to read
-        CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
-        if (!filein)
-            return error("CBlock::ReadFromDisk() : OpenBlockFile failed");
-        if (!fReadTransactions)
-            filein.nType |= SER_BLOCKHEADERONLY;
-
         // Read block
-        try {
-            filein >> *this;
-        }
-        catch (std::exception &e) {
+        int nType = SER_DISK;
+        if (!fReadTransactions)
+            nType |= SER_BLOCKHEADERONLY;
+        if (!blockfiles.Read(nFile, nBlockPos, *this, nType))
             return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
-        }
 
         // Check the header
         if (fReadTransactions && IsProofOfWork() && !CheckProofOfWork(GetHash(), nBits))
@@ -1235,7 +1318,8 @@ public:
     bool SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew);
     bool AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const uint256& hashProofOfStake);
     bool CheckBlock(bool fCheckPOW=true, bool fCheckMerkleRoot=true, bool fCheckSig=true) const;
-    bool AcceptBlock();
+    // nFileStored != 0 means the block is already stored at that position (-reindex)
+    bool AcceptBlock(unsigned int nFileStored=0, unsigned int nBlockPosStored=0);
     bool GetCoinAge(uint64_t& nCoinAge) const; // MotaCoin: calculate total coin age spent in block
     bool SignBlock(CWallet& keystore, int64_t nFees);
     bool CheckBlockSignature() const;
@@ -1249,6 +1333,26 @@ private:
 
 
 
+/** Proof-of-stake fields of a block index entry. They are only read when a
+ * single entry is inspected, so they live in a side table rather than in the
+ * CBlockIndex walked by chain traversals. Proof-of-work blocks have none.
+ */
+struct CBlockIndexStake
+{
+    COutPoint prevoutStake;
+    unsigned int nStakeTime;
+    uint256 hashProofOfStake;
+
+    CBlockIndexStake(const COutPoint& prevoutStakeIn, unsigned int nStakeTimeIn) :
+        prevoutStake(prevoutStakeIn), nStakeTime(nStakeTimeIn), hashProofOfStake(0) {}
+};
+
+/** Block index entries and their stake fields are allocated from arenas and
+ *  never freed. Like mapBlockIndex, they are guarded by cs_main. */
+CBlockIndex* NewBlockIndex();
+CBlockIndex* NewBlockIndex(unsigned int nFile, unsigned int nBlockPos, CBlock& block);
+CBlockIndexStake* NewBlockIndexStake(const COutPoint& prevoutStake, unsigned int nStakeTime);
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block.  pprev and pnext link a path through the
@@ -1259,17 +1363,13 @@ private:
 class CBlockIndex
 {
 public:
-    const uint256* phashBlock;
+    // Fields read on every hop of a chain walk come first, so that they
+    // share the entry's first cache line
     CBlockIndex* pprev;
     CBlockIndex* pnext;
-    unsigned int nFile;
-    unsigned int nBlockPos;
-    uint256 nChainTrust; // MotaCoin: trust score of block chain
+    const uint256* phashBlock;
+    uint64_t nStakeModifier; // hash modifier for proof-of-stake
     int nHeight;
-
-    int64_t nMint;
-    int64_t nMoneySupply;
-
     unsigned int nFlags;  // MotaCoin: block index flags
     enum  
     {
@@ -1277,21 +1377,23 @@ public:
         BLOCK_STAKE_ENTROPY  = (1 << 1), // entropy bit for stake modifier
         BLOCK_STAKE_MODIFIER = (1 << 2), // regenerated stake modifier
     };
+    unsigned int nTime;
+    unsigned int nBits;
+    int nVersion;
+    uint256 nChainTrust; // MotaCoin: trust score of block chain
 
-    uint64_t nStakeModifier; // hash modifier for proof-of-stake
+    unsigned int nFile;
+    unsigned int nBlockPos;
+    int64_t nMint;
+    int64_t nMoneySupply;
     unsigned int nStakeModifierChecksum; // checksum of index; in-memeory only
 
-    // proof-of-stake specific fields
-    COutPoint prevoutStake;
-    unsigned int nStakeTime;
-    uint256 hashProofOfStake;
-
-    // block header
-    int nVersion;
-    uint256 hashMerkleRoot;
-    unsigned int nTime;
-    unsigned int nBits;
+    // rest of the block header
     unsigned int nNonce;
+    uint256 hashMerkleRoot;
+
+    // proof-of-stake specific fields, NULL for proof-of-work blocks
+    CBlockIndexStake* pstake;
 
     CBlockIndex()
     {
@@ -1307,9 +1409,7 @@ public:
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
-        hashProofOfStake = 0;
-        prevoutStake.SetNull();
-        nStakeTime = 0;
+        pstake = NULL;
 
         nVersion       = 0;
         hashMerkleRoot = 0;
@@ -1332,17 +1432,11 @@ public:
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
-        hashProofOfStake = 0;
+        pstake = NULL;
         if (block.IsProofOfStake())
         {
             SetProofOfStake();
-            prevoutStake = block.vtx[1].vin[0].prevout;
-            nStakeTime = block.vtx[1].nTime;
-        }
-        else
-        {
-            prevoutStake.SetNull();
-            nStakeTime = 0;
+            pstake = NewBlockIndexStake(block.vtx[1].vin[0].prevout, block.vtx[1].nTime);
         }
 
         nVersion       = block.nVersion;
@@ -1443,6 +1537,26 @@ public:
         nFlags |= BLOCK_PROOF_OF_STAKE;
     }
 
+    COutPoint GetPrevoutStake() const
+    {
+        return pstake ? pstake->prevoutStake : COutPoint();
+    }
+
+    unsigned int GetStakeTime() const
+    {
+        return pstake ? pstake->nStakeTime : 0;
+    }
+
+    uint256 GetProofOfStakeHash() const
+    {
+        return pstake ? pstake->hashProofOfStake : 0;
+    }
+
+    std::pair<COutPoint, unsigned int> GetProofOfStake() const
+    {
+        return std::make_pair(GetPrevoutStake(), GetStakeTime());
+    }
+
     unsigned int GetStakeEntropyBit() const
     {
         return ((nFlags & BLOCK_STAKE_ENTROPY) >> 1);
@@ -1475,8 +1589,8 @@ public:
             FormatMoney(nMint).c_str(), FormatMoney(nMoneySupply).c_str(),
             GeneratedStakeModifier() ? "MOD" : "-", GetStakeEntropyBit(), IsProofOfStake()? "PoS" : "PoW",
             nStakeModifierChecksum, 
-            hashProofOfStake.ToString().c_str(),
-            prevoutStake.ToString().c_str(), nStakeTime,
+            GetProofOfStakeHash().ToString().c_str(),
+            GetPrevoutStake().ToString().c_str(), GetStakeTime(),
             hashMerkleRoot.ToString().c_str(),
             GetBlockHash().ToString().c_str());
     }
@@ -1499,17 +1613,28 @@ public:
     uint256 hashPrev;
     uint256 hashNext;
 
+    // proof-of-stake specific fields
+    COutPoint prevoutStake;
+    unsigned int nStakeTime;
+    uint256 hashProofOfStake;
+
     CDiskBlockIndex()
     {
         hashPrev = 0;
         hashNext = 0;
         blockHash = 0;
+        prevoutStake.SetNull();
+        nStakeTime = 0;
+        hashProofOfStake = 0;
     }
 
     explicit CDiskBlockIndex(CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : 0);
         hashNext = (pnext ? pnext->GetBlockHash() : 0);
+        prevoutStake = pindex->GetPrevoutStake();
+        nStakeTime = pindex->GetStakeTime();
+        hashProofOfStake = pindex->GetProofOfStakeHash();
     }
 
     IMPLEMENT_SERIALIZE
@@ -1611,7 +1736,7 @@ public:
 
     explicit CBlockLocator(uint256 hashBlock)
     {
-        std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
         if (mi != mapBlockIndex.end())
             Set((*mi).second);
     }
@@ -1662,7 +1787,7 @@ public:
         int nStep = 1;
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1681,7 +1806,7 @@ public:
         // Find the first block the caller has in the main chain
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1697,7 +1822,7 @@ public:
         // Find the first block the caller has in the main chain
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1728,8 +1853,8 @@ class CTxMemPool
 {
 public:
     mutable CCriticalSection cs;
-    std::map<uint256, CTransaction> mapTx;
-    std::map<COutPoint, CInPoint> mapNextTx;
+    std::unordered_map<uint256, CTransaction, CSaltedHasher> mapTx;
+    std::unordered_map<COutPoint, CInPoint, COutPointHasher> mapNextTx;
 
     bool accept(CTxDB& txdb, CTransaction &tx,
                 bool fCheckInputs, bool* pfMissingInputs);
@@ -1758,6 +1883,38 @@ public:
 
 extern CTxMemPool mempool;
 
+/** Admission pipeline for transactions relayed by peers. Worker threads run
+ *  the checks that do not depend on the chain tip (CheckTransaction,
+ *  standardness and script verification, which fills the signature cache)
+ *  without holding cs_main, then take cs_main only to commit the transaction
+ *  to the memory pool, where its signatures are found in the cache.
+ */
+class CTxAdmissionQueue
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<std::pair<CNode*, CTransaction> > queue;
+    std::set<uint256> setQueued;
+    boost::thread_group threads;
+    bool fRunning;
+
+    void Thread();
+
+public:
+    CTxAdmissionQueue() : fRunning(false) {}
+
+    void Start(int nThreads);
+    void Stop();
+
+    // Hand a transaction to the workers; pfrom may be NULL (orphans).
+    // Returns false if the caller must process it inline instead.
+    bool Push(CNode* pfrom, const CTransaction& tx);
+    bool IsQueued(const uint256& hash);
+};
+
+extern CTxAdmissionQueue txadmission;
+
 /** Used to relay blocks as header + vector<merkle branch>
  * to filtered nodes.
  */
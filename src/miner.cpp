@@ -109,6 +109,7 @@ public:
 // CreateNewBlock: create new block (without proof-of-work/proof-of-stake)
 CBlock* CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int64_t* pFees)
 {
+    CPerfTimer timer(fProofOfStake ? "createnewblock.pos" : "createnewblock.pow");
     bool fAllowChainSpending = false;
 
 
@@ -182,7 +183,7 @@ CBlock* CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int64_t* pFees)
         // This vector will be sorted into a priority queue:
         vector<TxPriority> vecPriority;
         vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTransaction>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+        for (std::unordered_map<uint256, CTransaction, CSaltedHasher>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
         {
             CTransaction& tx = (*mi).second;
             if (tx.IsCoinBase() || tx.IsCoinStake() || !tx.IsFinal())
@@ -549,7 +550,8 @@ void StakeMiner(CWallet *pwallet)
                 return;
         }
 
-        while (vNodes.empty() || IsInitialBlockDownload() || !pwallet->MintableCoins())
+        // A regtest node may be staking on its own
+        while ((vNodes.empty() && !fRegTest) || IsInitialBlockDownload() || !pwallet->MintableCoins())
         {
             nLastCoinStakeSearchInterval = 0;
             fTryToSync = true;
@@ -561,7 +563,7 @@ void StakeMiner(CWallet *pwallet)
         if (fTryToSync)
         {
             fTryToSync = false;
-            if (vNodes.size() < 3 || nBestHeight < GetNumBlocksOfPeers())
+            if ((vNodes.size() < 3 && !fRegTest) || nBestHeight < GetNumBlocksOfPeers())
             {
                 MilliSleep(60000);
                 continue;
@@ -0,0 +1,277 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "perfstats.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <set>
+
+using namespace std;
+
+bool fPerfStats = true;
+
+//
+// Each thread records into its own table, so timing a call costs two clock
+// reads and an uncontended lock. Readers walk the registry of live tables;
+// a thread's table is folded into the retired counters of its name when it
+// exits.
+//
+
+struct CPerfThreadStats
+{
+    boost::mutex mutex; // held by the owning thread while recording and by readers
+    string strThread;
+    map<const char*, CPerfHistogram> mapStatic;
+    PerfStatsMap mapDynamic;
+
+    CPerfThreadStats() : strThread("unnamed") {}
+
+    void MergeInto(PerfStatsMap& mapOut) const
+    {
+        for (map<const char*, CPerfHistogram>::const_iterator mi = mapStatic.begin(); mi != mapStatic.end(); ++mi)
+            mapOut[mi->first].Merge(mi->second);
+        for (PerfStatsMap::const_iterator mi = mapDynamic.begin(); mi != mapDynamic.end(); ++mi)
+            mapOut[mi->first].Merge(mi->second);
+    }
+};
+
+static void RetirePerfThreadStats(CPerfThreadStats* pstats);
+
+struct CPerfRegistry
+{
+    boost::mutex mutex;
+    set<CPerfThreadStats*> setThreads;
+    map<string, PerfStatsMap> mapRetired;
+    boost::thread_specific_ptr<CPerfThreadStats> current;
+
+    CPerfRegistry() : current(RetirePerfThreadStats) {}
+};
+
+// Never destroyed, as threads may still be recording while the process exits
+static CPerfRegistry& GetPerfRegistry()
+{
+    static CPerfRegistry* pregistry = new CPerfRegistry();
+    return *pregistry;
+}
+
+static void RetirePerfThreadStats(CPerfThreadStats* pstats)
+{
+    CPerfRegistry& registry = GetPerfRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    pstats->MergeInto(registry.mapRetired[pstats->strThread]);
+    registry.setThreads.erase(pstats);
+    delete pstats;
+}
+
+static CPerfThreadStats& GetPerfThreadStats()
+{
+    CPerfRegistry& registry = GetPerfRegistry();
+    CPerfThreadStats* pstats = registry.current.get();
+    if (pstats == NULL)
+    {
+        pstats = new CPerfThreadStats();
+        {
+            boost::mutex::scoped_lock lock(registry.mutex);
+            registry.setThreads.insert(pstats);
+        }
+        registry.current.reset(pstats);
+    }
+    return *pstats;
+}
+
+CPerfHistogram::CPerfHistogram() : nCount(0), nTotalMicros(0), nMaxMicros(0)
+{
+    for (int i = 0; i < PERF_HISTOGRAM_BUCKETS; i++)
+        vBucket[i] = 0;
+}
+
+void CPerfHistogram::Add(int64_t nMicros)
+{
+    if (nMicros < 0)
+        nMicros = 0;
+    nCount++;
+    nTotalMicros += nMicros;
+    if (nMicros > nMaxMicros)
+        nMaxMicros = nMicros;
+    int nBucket = 0;
+    while (nBucket < PERF_HISTOGRAM_BUCKETS - 1 && ((int64_t)1 << nBucket) < nMicros)
+        nBucket++;
+    vBucket[nBucket]++;
+}
+
+void CPerfHistogram::Merge(const CPerfHistogram& other)
+{
+    nCount += other.nCount;
+    nTotalMicros += other.nTotalMicros;
+    nMaxMicros = max(nMaxMicros, other.nMaxMicros);
+    for (int i = 0; i < PERF_HISTOGRAM_BUCKETS; i++)
+        vBucket[i] += other.vBucket[i];
+}
+
+int64_t CPerfHistogram::BucketLimit(int i)
+{
+    if (i >= PERF_HISTOGRAM_BUCKETS - 1)
+        return -1;
+    return (int64_t)1 << i;
+}
+
+void PerfRecord(const char* pszName, int64_t nMicros)
+{
+    if (!fPerfStats)
+        return;
+    CPerfThreadStats& stats = GetPerfThreadStats();
+    boost::mutex::scoped_lock lock(stats.mutex);
+    stats.mapStatic[pszName].Add(nMicros);
+}
+
+void PerfRecord(const string& strName, int64_t nMicros)
+{
+    if (!fPerfStats)
+        return;
+    CPerfThreadStats& stats = GetPerfThreadStats();
+    boost::mutex::scoped_lock lock(stats.mutex);
+    stats.mapDynamic[strName].Add(nMicros);
+}
+
+void PerfSetThreadName(const char* pszName)
+{
+    CPerfThreadStats& stats = GetPerfThreadStats();
+    boost::mutex::scoped_lock lock(stats.mutex);
+    stats.strThread = pszName;
+}
+
+void GetPerfStats(PerfStatsMap& mapTotal, map<string, PerfStatsMap>* pmapByThread)
+{
+    CPerfRegistry& registry = GetPerfRegistry();
+    map<string, PerfStatsMap> mapByThread;
+    {
+        boost::mutex::scoped_lock lock(registry.mutex);
+        mapByThread = registry.mapRetired;
+        BOOST_FOREACH(CPerfThreadStats* pstats, registry.setThreads)
+        {
+            boost::mutex::scoped_lock lockThread(pstats->mutex);
+            pstats->MergeInto(mapByThread[pstats->strThread]);
+        }
+    }
+
+    mapTotal.clear();
+    for (map<string, PerfStatsMap>::iterator mi = mapByThread.begin(); mi != mapByThread.end(); ++mi)
+        for (PerfStatsMap::iterator si = mi->second.begin(); si != mi->second.end(); ++si)
+            mapTotal[si->first].Merge(si->second);
+    if (pmapByThread)
+        pmapByThread->swap(mapByThread);
+}
+
+void ResetPerfStats()
+{
+    CPerfRegistry& registry = GetPerfRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    registry.mapRetired.clear();
+    BOOST_FOREACH(CPerfThreadStats* pstats, registry.setThreads)
+    {
+        boost::mutex::scoped_lock lockThread(pstats->mutex);
+        pstats->mapStatic.clear();
+        pstats->mapDynamic.clear();
+    }
+}
+
+string FormatPerfStatsPrometheus()
+{
+    PerfStatsMap mapTotal;
+    map<string, PerfStatsMap> mapByThread;
+    GetPerfStats(mapTotal, &mapByThread);
+
+    string strOut;
+    strOut += "# HELP motacoin_operation_duration_microseconds Latency of instrumented node operations.\n";
+    strOut += "# TYPE motacoin_operation_duration_microseconds histogram\n";
+    for (PerfStatsMap::iterator mi = mapTotal.begin(); mi != mapTotal.end(); ++mi)
+    {
+        const CPerfHistogram& histogram = mi->second;
+        const char* pszOp = mi->first.c_str();
+        uint64_t nCumulative = 0;
+        for (int i = 0; i < PERF_HISTOGRAM_BUCKETS - 1; i++)
+        {
+            nCumulative += histogram.vBucket[i];
+            strOut += strprintf("motacoin_operation_duration_microseconds_bucket{op=\"%s\",le=\"%" PRId64 "\"} %" PRIu64 "\n",
+                                pszOp, CPerfHistogram::BucketLimit(i), nCumulative);
+        }
+        strOut += strprintf("motacoin_operation_duration_microseconds_bucket{op=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", pszOp, histogram.nCount);
+        strOut += strprintf("motacoin_operation_duration_microseconds_sum{op=\"%s\"} %" PRId64 "\n", pszOp, histogram.nTotalMicros);
+        strOut += strprintf("motacoin_operation_duration_microseconds_count{op=\"%s\"} %" PRIu64 "\n", pszOp, histogram.nCount);
+    }
+
+    strOut += "# HELP motacoin_thread_operation_microseconds_total Time spent in each operation by thread.\n";
+    strOut += "# TYPE motacoin_thread_operation_microseconds_total counter\n";
+    for (map<string, PerfStatsMap>::iterator mi = mapByThread.begin(); mi != mapByThread.end(); ++mi)
+        for (PerfStatsMap::iterator si = mi->second.begin(); si != mi->second.end(); ++si)
+            strOut += strprintf("motacoin_thread_operation_microseconds_total{thread=\"%s\",op=\"%s\"} %" PRId64 "\n",
+                                mi->first.c_str(), si->first.c_str(), si->second.nTotalMicros);
+    return strOut;
+}
+
+static bool WritePerfStatsFile(const boost::filesystem::path& path)
+{
+    // Written aside and renamed over, so a scraper never sees half a file
+    boost::filesystem::path pathTmp(path.string() + ".new");
+    FILE* file = fopen(pathTmp.string().c_str(), "w");
+    if (!file)
+        return error("WritePerfStatsFile() : open %s failed", pathTmp.string().c_str());
+    string strOut = FormatPerfStatsPrometheus();
+    bool fOk = fwrite(strOut.data(), 1, strOut.size(), file) == strOut.size();
+    fOk = (fclose(file) == 0) && fOk;
+    if (!fOk || !RenameOver(pathTmp, path))
+        return error("WritePerfStatsFile() : write %s failed", path.string().c_str());
+    return true;
+}
+
+void ThreadPerfStatsDump(void* parg)
+{
+    RenameThread("MotaCoin-perfdump");
+
+    boost::filesystem::path path(GetArg("-perfstatsfile", ""));
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    int64_t nInterval = max((int64_t)1, GetArg("-perfstatsinterval", 60));
+
+    try
+    {
+        while (!fShutdown)
+        {
+            WritePerfStatsFile(path);
+            for (int64_t i = 0; i < nInterval && !fShutdown; i++)
+                MilliSleep(1000);
+        }
+    }
+    catch (std::exception& e) {
+        PrintException(&e, "ThreadPerfStatsDump()");
+    }
+    printf("ThreadPerfStatsDump exited\n");
+}
+
+CPerfTimer::CPerfTimer(const char* pszNameIn) : pszName(pszNameIn), nStart(fPerfStats ? GetTimeMicros() : -1)
+{
+}
+
+CPerfTimer::CPerfTimer(const char* pszPrefix, const string& strSuffix) : pszName(NULL), nStart(-1)
+{
+    if (fPerfStats)
+    {
+        strName = pszPrefix + strSuffix;
+        nStart = GetTimeMicros();
+    }
+}
+
+CPerfTimer::~CPerfTimer()
+{
+    if (nStart < 0)
+        return;
+    int64_t nElapsed = GetTimeMicros() - nStart;
+    if (pszName)
+        PerfRecord(pszName, nElapsed);
+    else
+        PerfRecord(strName, nElapsed);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_PERFSTATS_H
+#define BITCOIN_PERFSTATS_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+static const int PERF_HISTOGRAM_BUCKETS = 24;
+
+/** Latency distribution of one operation in power of two microsecond
+ * buckets: bucket 0 counts calls of at most 1us, bucket i calls in
+ * (2^(i-1), 2^i]us and the last bucket everything longer than that */
+class CPerfHistogram
+{
+public:
+    uint64_t nCount;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t vBucket[PERF_HISTOGRAM_BUCKETS];
+
+    CPerfHistogram();
+    void Add(int64_t nMicros);
+    void Merge(const CPerfHistogram& other);
+
+    /** Inclusive upper bound of bucket i in microseconds, -1 for the last */
+    static int64_t BucketLimit(int i);
+};
+
+typedef std::map<std::string, CPerfHistogram> PerfStatsMap;
+
+extern bool fPerfStats;
+
+/** Adds one sample of an operation to the calling thread's counters.
+ * pszName must be a string literal or otherwise live forever. */
+void PerfRecord(const char* pszName, int64_t nMicros);
+void PerfRecord(const std::string& strName, int64_t nMicros);
+
+/** Names the calling thread's counters; called by RenameThread */
+void PerfSetThreadName(const char* pszName);
+
+/** Counters summed over all threads, and optionally per thread name,
+ * including threads that have since exited */
+void GetPerfStats(PerfStatsMap& mapTotal, std::map<std::string, PerfStatsMap>* pmapByThread = NULL);
+void ResetPerfStats();
+
+/** All counters in the Prometheus text exposition format */
+std::string FormatPerfStatsPrometheus();
+
+/** Writes FormatPerfStatsPrometheus() to -perfstatsfile every
+ * -perfstatsinterval seconds */
+void ThreadPerfStatsDump(void* parg);
+
+/** Records the time from construction to destruction of the enclosing scope */
+class CPerfTimer
+{
+private:
+    const char* pszName;
+    std::string strName;
+    int64_t nStart;
+
+public:
+    explicit CPerfTimer(const char* pszNameIn);
+    /** For names that aren't literals: the name is strPrefix + strSuffix */
+    CPerfTimer(const char* pszPrefix, const std::string& strSuffix);
+    ~CPerfTimer();
+};
+
+#endif
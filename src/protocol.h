@@ -17,8 +17,11 @@
 #include "uint256.h"
 
 extern bool fTestNet;
+extern bool fRegTest;
 static inline unsigned short GetDefaultPort(const bool testnet = fTestNet)
 {
+    if (testnet && fRegTest)
+        return 26100;
     return testnet ? 26000 : 17420;
 }
 
@@ -162,7 +162,7 @@ void RPCExecutor::request(const QString &command)
         else if (result.type() == json_spirit::str_type)
             strPrint = result.get_str();
         else
-            strPrint = write_string(result, true);
+            strPrint = WriteJSON(result, true);
 
         Q_EMIT reply(RPCConsole::CMD_REPLY, QString::fromStdString(strPrint));
     }
@@ -176,7 +176,7 @@ void RPCExecutor::request(const QString &command)
         }
         catch(std::runtime_error &) // raised when converting to invalid type, i.e. missing code or message
         {   // Show raw JSON object
-            Q_EMIT reply(RPCConsole::CMD_ERROR, QString::fromStdString(write_string(json_spirit::Value(objError), false)));
+            Q_EMIT reply(RPCConsole::CMD_ERROR, QString::fromStdString(WriteJSON(json_spirit::Value(objError))));
         }
     }
     catch (std::exception& e)
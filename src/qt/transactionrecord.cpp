@@ -165,7 +165,7 @@ void TransactionRecord::updateStatus(const CWalletTx &wtx)
 
     // Find the block the tx is in
     CBlockIndex* pindex = NULL;
-    std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(wtx.hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(wtx.hashBlock);
     if (mi != mapBlockIndex.end())
         pindex = (*mi).second;
 
@@ -241,6 +241,13 @@ bool TransactionRecord::statusUpdateNeeded()
     return status.cur_num_blocks != nBestHeight;
 }
 
+bool TransactionRecord::statusSettled() const
+{
+    return status.cur_num_blocks != -1 &&
+           status.status == TransactionStatus::HaveConfirmations &&
+           status.maturity == TransactionStatus::Mature;
+}
+
 std::string TransactionRecord::getTxID()
 {
     return hash.ToString() + strprintf("-%03d", idx);
@@ -125,6 +125,11 @@ public:
     /** Return whether a status update is needed.
      */
     bool statusUpdateNeeded();
+
+    /** Return whether the cached status is final as far as new blocks are concerned
+        (confirmed and mature), so rows need not be refreshed when the tip moves.
+     */
+    bool statusSettled() const;
 };
 
 #endif // TRANSACTIONRECORD_H
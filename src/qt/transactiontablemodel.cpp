@@ -20,6 +20,8 @@
 #include <QDateTime>
 #include <QtAlgorithms>
 
+#include <boost/bind/bind.hpp>
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter,
@@ -59,8 +61,8 @@ public:
     TransactionTableModel *parent;
 
     /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+     * Sorted by sha256, so that records of a transaction can be found
+     * with a binary search.
      */
     QList<TransactionRecord> cachedWallet;
 
@@ -72,12 +74,15 @@ public:
         cachedWallet.clear();
         {
             LOCK(wallet->cs_wallet);
-            for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+            cachedWallet.reserve(wallet->mapWallet.size());
+            for(WalletTxMap::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
             {
                 if(TransactionRecord::showTransaction(it->second))
                     cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
             }
         }
+        // mapWallet is unordered; keep the records of each transaction in their order
+        qStableSort(cachedWallet.begin(), cachedWallet.end(), TxLessThan());
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -92,7 +97,7 @@ public:
             LOCK(wallet->cs_wallet);
 
             // Find transaction in wallet
-            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+            WalletTxMap::iterator mi = wallet->mapWallet.find(hash);
             bool inWallet = mi != wallet->mapWallet.end();
 
             // Find bounds of this transaction in model
@@ -161,8 +166,15 @@ public:
                 parent->endRemoveRows();
                 break;
             case CT_UPDATED:
-                // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
-                // visible transactions.
+                // Miscellaneous updates -- invalidate the cached status of this transaction's rows only,
+                // the status itself is recomputed lazily when the rows are next shown.
+                if(inModel)
+                {
+                    for(QList<TransactionRecord>::iterator it = lower; it != upper; ++it)
+                        it->status.cur_num_blocks = -1;
+                    Q_EMIT parent->dataChanged(parent->index(lowerIndex, TransactionTableModel::Status),
+                                               parent->index(upperIndex-1, TransactionTableModel::Amount));
+                }
                 break;
             }
         }
@@ -186,7 +198,7 @@ public:
             {
                 {
                     LOCK(wallet->cs_wallet);
-                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
+                    WalletTxMap::iterator mi = wallet->mapWallet.find(rec->hash);
 
                     if(mi != wallet->mapWallet.end())
                     {
@@ -206,7 +218,7 @@ public:
     {
         {
             LOCK(wallet->cs_wallet);
-            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
+            WalletTxMap::iterator mi = wallet->mapWallet.find(rec->hash);
             if(mi != wallet->mapWallet.end())
             {
                 return TransactionDesc::toHTML(wallet, mi->second);
@@ -222,21 +234,26 @@ TransactionTableModel::TransactionTableModel(CWallet* wallet, WalletModel *paren
         wallet(wallet),
         walletModel(parent),
         priv(new TransactionTablePriv(wallet, this)),
-        cachedNumBlocks(0)
+        cachedNumBlocks(0),
+        cachedBestBlock(0)
 {
     columns << QString() << tr("Date") << tr("Type") << tr("Address") << tr("Amount");
 
     priv->refreshWallet();
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateConfirmations()));
-    timer->start(MODEL_UPDATE_DELAY);
+    // Block notifications arrive in bursts while syncing; collapse each burst into one update
+    confirmationsTimer = new QTimer(this);
+    confirmationsTimer->setSingleShot(true);
+    connect(confirmationsTimer, SIGNAL(timeout()), this, SLOT(updateConfirmations()));
 
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
+
+    subscribeToCoreSignals();
 }
 
 TransactionTableModel::~TransactionTableModel()
 {
+    unsubscribeFromCoreSignals();
     delete priv;
 }
 
@@ -248,17 +265,66 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status)
     priv->updateWallet(updated, status);
 }
 
+void TransactionTableModel::updateNumBlocks()
+{
+    if(!confirmationsTimer->isActive())
+        confirmationsTimer->start(MODEL_UPDATE_DELAY);
+}
+
 void TransactionTableModel::updateConfirmations()
 {
-    if(nBestHeight != cachedNumBlocks)
+    bool fReorganized;
     {
+        TRY_LOCK(cs_main, lockMain);
+        if(!lockMain)
+        {
+            // Busy connecting blocks; try again shortly
+            confirmationsTimer->start(MODEL_UPDATE_DELAY);
+            return;
+        }
+        if(nBestHeight == cachedNumBlocks && pindexBest == cachedBestBlock)
+            return;
+        // The chain went back or switched branches if the last tip we showed
+        // is no longer part of it
+        fReorganized = nBestHeight < cachedNumBlocks ||
+                       (cachedBestBlock && !cachedBestBlock->IsInMainChain());
         cachedNumBlocks = nBestHeight;
-        // Blocks came in since last poll.
+        cachedBestBlock = pindexBest;
+    }
+
+    int size = priv->size();
+    if(fReorganized)
+    {
+        // Settled rows may have lost their confirmations: recompute every status,
+        //  even where the height is unchanged
+        for(int row = 0; row < size; ++row)
+            priv->cachedWallet[row].status.cur_num_blocks = -1;
+        if(size > 0)
+            Q_EMIT dataChanged(index(0, Status), index(size-1, Amount));
+    }
+    else
+    {
+        // Blocks came in since last update.
         // Invalidate status (number of confirmations) and (possibly) description
-        //  for all rows. Qt is smart enough to only actually request the data for the
-        //  visible rows.
-        Q_EMIT dataChanged(index(0, Status), index(priv->size()-1, Status));
-        Q_EMIT dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
+        //  for the rows whose status can still change. Confirmed, mature rows are skipped:
+        //  signalling them would make sorting/filtering proxies re-query (and recompute
+        //  the depth of) every transaction in the wallet. Their depth is still refreshed
+        //  whenever the view asks for them.
+        int first = -1;
+        for(int row = 0; row <= size; ++row)
+        {
+            bool changed = (row < size) && !priv->cachedWallet[row].statusSettled();
+            if(changed && first < 0)
+            {
+                first = row;
+            }
+            else if(!changed && first >= 0)
+            {
+                Q_EMIT dataChanged(index(first, Status), index(row-1, Status));
+                Q_EMIT dataChanged(index(first, ToAddress), index(row-1, ToAddress));
+                first = -1;
+            }
+        }
     }
 }
 
@@ -507,7 +573,11 @@ QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
 {
     if(!index.isValid())
         return QVariant();
-    TransactionRecord *rec = static_cast<TransactionRecord*>(index.internalPointer());
+    // Look the record up again rather than trusting internalPointer(), so its status
+    //  is brought up to date even for rows no dataChanged was emitted for
+    TransactionRecord *rec = priv->index(index.row());
+    if(!rec)
+        return QVariant();
 
     switch(role)
     {
@@ -646,3 +716,21 @@ void TransactionTableModel::updateDisplayUnit()
     // Q_EMIT dataChanged to update Amount column with the current unit
     Q_EMIT dataChanged(index(0, Amount), index(priv->size()-1, Amount));
 }
+
+// Handlers for core signals
+static void NotifyBlocksChanged(TransactionTableModel *ttm)
+{
+    QMetaObject::invokeMethod(ttm, "updateNumBlocks", Qt::QueuedConnection);
+}
+
+void TransactionTableModel::subscribeToCoreSignals()
+{
+    // Connect signals to client
+    uiInterface.NotifyBlocksChanged.connect(boost::bind(NotifyBlocksChanged, this));
+}
+
+void TransactionTableModel::unsubscribeFromCoreSignals()
+{
+    // Disconnect signals from client
+    uiInterface.NotifyBlocksChanged.disconnect(boost::bind(NotifyBlocksChanged, this));
+}
@@ -5,9 +5,11 @@
 #include <QStringList>
 
 class CWallet;
+class CBlockIndex;
 class TransactionTablePriv;
 class TransactionRecord;
 class WalletModel;
+class QTimer;
 
 /** UI model for the transaction table of a wallet.
  */
@@ -62,6 +64,11 @@ private:
     QStringList columns;
     TransactionTablePriv *priv;
     int cachedNumBlocks;
+    const CBlockIndex *cachedBestBlock;
+    QTimer *confirmationsTimer;
+
+    void subscribeToCoreSignals();
+    void unsubscribeFromCoreSignals();
 
     QString lookupAddress(const std::string &address, bool tooltip) const;
     QVariant addressColor(const TransactionRecord *wtx) const;
@@ -77,6 +84,8 @@ private:
 public Q_SLOTS:
     void updateTransaction(const QString &hash, int status);
     void updateConfirmations();
+    /* New blocks arrived: schedule (coalesced) confirmation updates */
+    void updateNumBlocks();
     void updateDisplayUnit();
 
     friend class TransactionTablePriv;
@@ -0,0 +1,693 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <locale.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#include <vector>
+
+#include "rpcjson.h"
+
+using namespace json_spirit;
+
+namespace {
+
+enum JSONTokenType
+{
+    TOK_OBJ,
+    TOK_ARR,
+    TOK_STR,
+    TOK_TRUE,
+    TOK_FALSE,
+    TOK_NULL,
+    TOK_INT,
+    TOK_UINT,
+    TOK_REAL,
+};
+
+struct JSONToken
+{
+    int nType;
+    size_t nSize;       // members of an object, elements of an array, bytes of a string
+    size_t nOffset;     // where a string's bytes start in the string pool
+    int64_t nInt;
+    double dReal;
+
+    explicit JSONToken(int nTypeIn) : nType(nTypeIn), nSize(0), nOffset(0), nInt(0), dReal(0) {}
+};
+
+inline bool IsSpace(char c)
+{
+    // space_p, the skipper json_spirit parses with
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool IsHexDigit(char c)
+{
+    return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+inline int HexValue(char c)
+{
+    // json_spirit's hex_to_num: anything that isn't a hex digit counts as 0
+    if (IsDigit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return 0;
+}
+
+/** Append the contents of a string literal with its escapes replaced, the
+ *  way json_spirit's substitute_esc_chars does it: unknown escapes vanish,
+ *  \x and \u take the following hex digits only if there are enough left,
+ *  and \u keeps just the low byte of the code point.
+ */
+void AppendUnescaped(std::string& str, const char* pbegin, const char* pend)
+{
+    const char* pstart = pbegin;
+    for (const char* p = pbegin; p < pend - 1; ++p)
+    {
+        if (*p != '\\')
+            continue;
+        str.append(pstart, p);
+        ++p;
+        switch (*p)
+        {
+        case 't':  str += '\t'; break;
+        case 'b':  str += '\b'; break;
+        case 'f':  str += '\f'; break;
+        case 'n':  str += '\n'; break;
+        case 'r':  str += '\r'; break;
+        case '\\': str += '\\'; break;
+        case '/':  str += '/';  break;
+        case '"':  str += '"';  break;
+        case 'x':
+            if (pend - p >= 3)
+            {
+                str += (char)((HexValue(p[1]) << 4) + HexValue(p[2]));
+                p += 2;
+            }
+            break;
+        case 'u':
+            if (pend - p >= 5)
+            {
+                str += (char)((HexValue(p[1]) << 12) + (HexValue(p[2]) << 8) +
+                              (HexValue(p[3]) << 4) + HexValue(p[4]));
+                p += 4;
+            }
+            break;
+        }
+        pstart = p + 1;
+    }
+    str.append(pstart, pend);
+}
+
+double ParseReal(const char* pbegin, const char* pend)
+{
+    // Up to 15 significant digits and a power of ten up to 1e22 are both
+    // exact doubles, so a single multiplication or division rounds correctly
+    // and gives what strtod would. That covers amounts and fees.
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    const char* p = pbegin;
+    bool fNegative = false;
+    if (*p == '+' || *p == '-')
+        fNegative = (*p++ == '-');
+    uint64_t nMantissa = 0;
+    int nDigits = 0;
+    int nExponent = 0;
+    for (bool fFraction = false; p != pend; ++p)
+    {
+        if (*p == '.' && !fFraction)
+        {
+            fFraction = true;
+            continue;
+        }
+        if (!IsDigit(*p))
+            break;
+        if (nMantissa != 0 || *p != '0')
+            nDigits++;
+        if (nDigits > 15)
+            break;
+        nMantissa = nMantissa * 10 + (*p - '0');
+        if (fFraction)
+            nExponent--;
+    }
+    if (nDigits <= 15 && p != pend)
+    {
+        // The exponent, which is all that can follow
+        const char* q = p + 1;
+        bool fNegativeExp = false;
+        if (*q == '+' || *q == '-')
+            fNegativeExp = (*q++ == '-');
+        int nExp = 0;
+        for (; q != pend && nExp < 1000; ++q)
+            nExp = nExp * 10 + (*q - '0');
+        nExponent += fNegativeExp ? -nExp : nExp;
+    }
+    if (nDigits <= 15 && nExponent >= -22 && nExponent <= 22)
+    {
+        double d = (double)nMantissa;
+        d = (nExponent < 0) ? d / pow10[-nExponent] : d * pow10[nExponent];
+        return fNegative ? -d : d;
+    }
+
+    // strtod reads the decimal separator of LC_NUMERIC, which the GUI sets
+    // from the environment
+    std::string str(pbegin, pend);
+    const char* pszPoint = localeconv()->decimal_point;
+    if (strcmp(pszPoint, ".") != 0)
+    {
+        size_t nPos = str.find('.');
+        if (nPos != std::string::npos)
+            str.replace(nPos, 1, pszPoint);
+    }
+    return strtod(str.c_str(), NULL);
+}
+
+/** Reads JSON text in two passes. Tokenize() checks the syntax and records
+ *  every value as a flat token, with strings unescaped into one pool and each
+ *  container's size filled in when it closes. Build() then creates the
+ *  json_spirit::Value tree top down, so arrays and objects are reserved once
+ *  instead of being copied as they grow.
+ */
+class CJSONReader
+{
+public:
+    CJSONReader(const char* pbeginIn, const char* pendIn) : p(pbeginIn), pend(pendIn), nNext(0) {}
+
+    bool Tokenize();
+
+    void Build(Value& value);
+
+private:
+    const char* p;
+    const char* pend;
+    std::vector<JSONToken> vTokens;
+    std::string strPool;
+    size_t nNext;
+
+    void SkipSpace()
+    {
+        while (p != pend && IsSpace(*p))
+            ++p;
+    }
+
+    bool ReadString();
+    bool ReadKey();
+    bool ReadNumber();
+    bool ReadScalar();
+
+    static Value Shell(const JSONToken& tok);
+    void Fill(Value& value, const JSONToken& tok);
+};
+
+bool CJSONReader::ReadString()
+{
+    // A backslash escapes whatever follows it, except that \x must be
+    // followed by a hex digit. memchr finds the quotes and backslashes
+    // faster than looking at each byte.
+    const char* pstart = p + 1;
+    const char* q = pstart;
+    bool fEscaped = false;
+    for (;;)
+    {
+        const char* pquote = (const char*)memchr(q, '"', pend - q);
+        if (pquote == NULL)
+            return false;
+        const char* pbackslash = (const char*)memchr(q, '\\', pquote - q);
+        if (pbackslash == NULL)
+        {
+            q = pquote;
+            break;
+        }
+        fEscaped = true;
+        q = pbackslash + 1;
+        if (q == pend)
+            return false;
+        if ((*q == 'x' || *q == 'X') && (q + 1 == pend || !IsHexDigit(q[1])))
+            return false;
+        ++q;
+    }
+
+    JSONToken tok(TOK_STR);
+    tok.nOffset = strPool.size();
+    if (fEscaped)
+        AppendUnescaped(strPool, pstart, q);
+    else
+        strPool.append(pstart, q);
+    tok.nSize = strPool.size() - tok.nOffset;
+    vTokens.push_back(tok);
+    p = q + 1;
+    return true;
+}
+
+bool CJSONReader::ReadKey()
+{
+    SkipSpace();
+    if (p == pend || *p != '"' || !ReadString())
+        return false;
+    SkipSpace();
+    if (p == pend || *p != ':')
+        return false;
+    ++p;
+    return true;
+}
+
+bool CJSONReader::ReadNumber()
+{
+    // A real needs a '.' or an exponent, and may lack digits on one side of
+    // the '.' (strict_real_p). Anything else is an int64, or a uint64 if it
+    // is unsigned and too big for int64.
+    const char* pstart = p;
+    const char* q = p;
+    if (q != pend && (*q == '+' || *q == '-'))
+        ++q;
+    const char* pdigits = q;
+    while (q != pend && IsDigit(*q))
+        ++q;
+    const char* pdigitsEnd = q;
+
+    bool fReal = false;
+    bool fDot = (q != pend && *q == '.');
+    if (fDot)
+    {
+        const char* pfrac = ++q;
+        while (q != pend && IsDigit(*q))
+            ++q;
+        fReal = (pdigitsEnd != pdigits || q != pfrac);
+    }
+    if ((fReal || pdigitsEnd != pdigits) && q != pend && (*q == 'e' || *q == 'E'))
+    {
+        const char* r = q + 1;
+        if (r != pend && (*r == '+' || *r == '-'))
+            ++r;
+        const char* pexp = r;
+        while (r != pend && IsDigit(*r))
+            ++r;
+        fReal = (r != pexp);
+        q = r;
+    }
+    if (fReal)
+    {
+        JSONToken tok(TOK_REAL);
+        tok.dReal = ParseReal(pstart, q);
+        vTokens.push_back(tok);
+        p = q;
+        return true;
+    }
+
+    if (pdigitsEnd == pdigits)
+        return false;
+    uint64_t n = 0;
+    for (const char* r = pdigits; r != pdigitsEnd; ++r)
+    {
+        unsigned int nDigit = *r - '0';
+        if (n > (UINT64_MAX - nDigit) / 10)
+            return false;
+        n = n * 10 + nDigit;
+    }
+    JSONToken tok(TOK_INT);
+    if (*pstart == '-')
+    {
+        if (n > (uint64_t)INT64_MAX + 1)
+            return false;
+        tok.nInt = (int64_t)(0 - n);
+    }
+    else if (n <= (uint64_t)INT64_MAX)
+        tok.nInt = (int64_t)n;
+    else if (*pstart != '+')
+    {
+        tok.nType = TOK_UINT;
+        tok.nInt = (int64_t)n;
+    }
+    else
+        return false;
+    vTokens.push_back(tok);
+    p = pdigitsEnd;
+    return true;
+}
+
+bool CJSONReader::ReadScalar()
+{
+    if (*p == '"')
+        return ReadString();
+
+    static const struct { const char* psz; size_t nLen; int nType; } literals[] = {
+        { "true", 4, TOK_TRUE }, { "false", 5, TOK_FALSE }, { "null", 4, TOK_NULL },
+    };
+    for (unsigned int i = 0; i < sizeof(literals) / sizeof(literals[0]); i++)
+    {
+        if (*p == literals[i].psz[0])
+        {
+            if ((size_t)(pend - p) < literals[i].nLen || memcmp(p, literals[i].psz, literals[i].nLen) != 0)
+                return false;
+            vTokens.push_back(JSONToken(literals[i].nType));
+            p += literals[i].nLen;
+            return true;
+        }
+    }
+
+    return ReadNumber();
+}
+
+bool CJSONReader::Tokenize()
+{
+    // Indexes of the tokens of the objects and arrays still open
+    std::vector<size_t> vOpen;
+    vTokens.reserve(16);
+    strPool.reserve(pend - p);
+
+    for (;;)
+    {
+        // A value is expected here
+        SkipSpace();
+        if (p == pend)
+            return false;
+        if (*p == '{' || *p == '[')
+        {
+            bool fObject = (*p++ == '{');
+            vOpen.push_back(vTokens.size());
+            vTokens.push_back(JSONToken(fObject ? TOK_OBJ : TOK_ARR));
+            SkipSpace();
+            if (p == pend || *p != (fObject ? '}' : ']'))
+            {
+                if (fObject && !ReadKey())
+                    return false;
+                continue;
+            }
+            ++p;
+            vOpen.pop_back();
+        }
+        else if (!ReadScalar())
+            return false;
+
+        // A value is complete: count it in its container, then either move
+        // on to the next element or close the container, which completes it
+        for (;;)
+        {
+            if (vOpen.empty())
+                return true; // like json_spirit, ignore whatever follows
+            JSONToken& tokOpen = vTokens[vOpen.back()];
+            bool fObject = (tokOpen.nType == TOK_OBJ);
+            tokOpen.nSize++;
+            SkipSpace();
+            if (p == pend)
+                return false;
+            if (*p == ',')
+            {
+                ++p;
+                if (fObject && !ReadKey())
+                    return false;
+                break;
+            }
+            if (*p != (fObject ? '}' : ']'))
+                return false;
+            ++p;
+            vOpen.pop_back();
+        }
+    }
+}
+
+Value CJSONReader::Shell(const JSONToken& tok)
+{
+    switch (tok.nType)
+    {
+    case TOK_OBJ:   return Object();
+    case TOK_ARR:   return Array();
+    case TOK_STR:   return "";
+    case TOK_TRUE:  return true;
+    case TOK_FALSE: return false;
+    case TOK_INT:   return tok.nInt;
+    case TOK_UINT:  return (uint64_t)tok.nInt;
+    case TOK_REAL:  return tok.dReal;
+    }
+    return Value();
+}
+
+void CJSONReader::Fill(Value& value, const JSONToken& tok)
+{
+    // Children are put in place as shells and filled there: Value has no
+    // move constructor, so adding a finished child would copy all of it
+    switch (tok.nType)
+    {
+    case TOK_OBJ:
+    {
+        Object& obj = value.get_obj();
+        obj.reserve(tok.nSize);
+        for (size_t i = 0; i < tok.nSize; i++)
+        {
+            const JSONToken& tokKey = vTokens[nNext++];
+            const JSONToken& tokValue = vTokens[nNext++];
+            obj.emplace_back(std::string(), Shell(tokValue));
+            obj.back().name_.assign(strPool, tokKey.nOffset, tokKey.nSize);
+            Fill(obj.back().value_, tokValue);
+        }
+        break;
+    }
+    case TOK_ARR:
+    {
+        Array& arr = value.get_array();
+        arr.reserve(tok.nSize);
+        for (size_t i = 0; i < tok.nSize; i++)
+        {
+            const JSONToken& tokValue = vTokens[nNext++];
+            arr.push_back(Shell(tokValue));
+            Fill(arr.back(), tokValue);
+        }
+        break;
+    }
+    case TOK_STR:
+        // Value only hands out its string as const, but the string it holds
+        // isn't, so fill it in rather than copying it in
+        const_cast<std::string&>(value.get_str()).assign(strPool, tok.nOffset, tok.nSize);
+        break;
+    }
+}
+
+void CJSONReader::Build(Value& value)
+{
+    const JSONToken& tok = vTokens[nNext++];
+    value = Shell(tok);
+    Fill(value, tok);
+}
+
+/** Appends the JSON text of a value to a string, following
+ *  json_spirit::Generator output for output.
+ */
+class CJSONWriter
+{
+public:
+    CJSONWriter(std::string& strIn, bool fPrettyIn) : str(strIn), fPretty(fPrettyIn), nIndent(0) {}
+
+    void Write(const Value& value);
+
+private:
+    std::string& str;
+    bool fPretty;
+    int nIndent;
+
+    void WriteString(const std::string& s);
+    void WriteInt(const Value& value);
+    void WriteReal(double d);
+
+    void Indent()
+    {
+        if (fPretty)
+            str.append(4 * nIndent, ' ');
+    }
+
+    void NewLine()
+    {
+        if (fPretty)
+            str += '\n';
+    }
+};
+
+void CJSONWriter::WriteString(const std::string& s)
+{
+    static const char hexdigits[] = "0123456789ABCDEF";
+
+    str += '"';
+    const char* pbegin = s.data();
+    const char* pend = pbegin + s.size();
+    const char* pstart = pbegin;
+    for (const char* p = pbegin; p != pend; ++p)
+    {
+        unsigned char c = *p;
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+            continue;
+        str.append(pstart, p);
+        pstart = p + 1;
+        switch (c)
+        {
+        case '"':  str += "\\\""; break;
+        case '\\': str += "\\\\"; break;
+        case '\b': str += "\\b";  break;
+        case '\f': str += "\\f";  break;
+        case '\n': str += "\\n";  break;
+        case '\r': str += "\\r";  break;
+        case '\t': str += "\\t";  break;
+        default:
+            // Bytes above 0x7e are written raw if the locale calls them
+            // printable, as add_esc_chars does
+            if (iswprint(c))
+                str += (char)c;
+            else
+            {
+                char buf[6] = { '\\', 'u', '0', '0', hexdigits[c >> 4], hexdigits[c & 0xf] };
+                str.append(buf, 6);
+            }
+        }
+    }
+    str.append(pstart, pend);
+    str += '"';
+}
+
+void CJSONWriter::WriteInt(const Value& value)
+{
+    char buf[24];
+    char* pend = buf + sizeof(buf);
+    char* p = pend;
+    bool fNegative = !value.is_uint64() && value.get_int64() < 0;
+    uint64_t n = value.get_uint64();
+    if (fNegative)
+        n = 0 - n;
+    do
+    {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    if (fNegative)
+        *--p = '-';
+    str.append(p, pend);
+}
+
+void CJSONWriter::WriteReal(double d)
+{
+    // Amounts scaled by 1e8 land within a rounding error of an integer, and
+    // when the scaled value is nowhere near a half (the error is under 1/16
+    // below 1e15), rounding it gives the digits %.8f would
+    double dScaled = fabs(d) * 1e8;
+    if (dScaled < 1e15 && fabs(dScaled - floor(dScaled) - 0.5) > 0.125)
+    {
+        uint64_t n = (uint64_t)floor(dScaled + 0.5);
+        char buf[32];
+        char* pend = buf + sizeof(buf);
+        char* p = pend;
+        for (int i = 0; i < 8; i++, n /= 10)
+            *--p = '0' + n % 10;
+        *--p = '.';
+        do
+        {
+            *--p = '0' + n % 10;
+            n /= 10;
+        } while (n != 0);
+        if (signbit(d))
+            *--p = '-';
+        str.append(p, pend);
+        return;
+    }
+
+    // The same digits as std::fixed << std::setprecision(8), but printf
+    // follows LC_NUMERIC, so put the '.' back if the locale uses another
+    // decimal separator
+    char buf[512];
+    int nLen = snprintf(buf, sizeof(buf), "%.8f", d);
+    if (nLen < 0 || nLen >= (int)sizeof(buf))
+        nLen = strlen(buf);
+    const char* pszPoint = localeconv()->decimal_point;
+    if (strcmp(pszPoint, ".") == 0)
+    {
+        str.append(buf, nLen);
+        return;
+    }
+    std::string strReal(buf, nLen);
+    size_t nPos = strReal.find(pszPoint);
+    if (nPos != std::string::npos)
+        strReal.replace(nPos, strlen(pszPoint), ".");
+    str += strReal;
+}
+
+void CJSONWriter::Write(const Value& value)
+{
+    switch (value.type())
+    {
+    case obj_type:
+    {
+        const Object& obj = value.get_obj();
+        str += '{';
+        NewLine();
+        nIndent++;
+        for (Object::const_iterator it = obj.begin(); it != obj.end(); ++it)
+        {
+            Indent();
+            WriteString(it->name_);
+            str += fPretty ? " : " : ":";
+            Write(it->value_);
+            if (it + 1 != obj.end())
+                str += ',';
+            NewLine();
+        }
+        nIndent--;
+        Indent();
+        str += '}';
+        break;
+    }
+    case array_type:
+    {
+        const Array& arr = value.get_array();
+        str += '[';
+        NewLine();
+        nIndent++;
+        for (Array::const_iterator it = arr.begin(); it != arr.end(); ++it)
+        {
+            Indent();
+            Write(*it);
+            if (it + 1 != arr.end())
+                str += ',';
+            NewLine();
+        }
+        nIndent--;
+        Indent();
+        str += ']';
+        break;
+    }
+    case str_type:  WriteString(value.get_str()); break;
+    case bool_type: str += value.get_bool() ? "true" : "false"; break;
+    case int_type:  WriteInt(value); break;
+    case real_type: WriteReal(value.get_real()); break;
+    case null_type: str += "null"; break;
+    }
+}
+
+}
+
+bool ParseJSON(const std::string& strJSON, Value& valRet)
+{
+    CJSONReader reader(strJSON.data(), strJSON.data() + strJSON.size());
+    if (!reader.Tokenize())
+        return false;
+    reader.Build(valRet);
+    return true;
+}
+
+std::string WriteJSON(const Value& value, bool fPretty)
+{
+    std::string str;
+    str.reserve(256);
+    CJSONWriter(str, fPretty).Write(value);
+    return str;
+}
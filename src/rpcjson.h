@@ -0,0 +1,25 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_RPCJSON_H
+#define BITCOIN_RPCJSON_H
+
+#include <string>
+
+#include "json/json_spirit_value.h"
+
+/** Parse JSON text into a json_spirit::Value. Accepts exactly what
+ *  json_spirit::read_string accepts, including its escapes (\xHH, and \uHHHH
+ *  truncated to one byte) and its habit of ignoring text after the first
+ *  complete value, but tokenizes in a single pass and builds each array and
+ *  object at its final size. valRet is left untouched on failure.
+ */
+bool ParseJSON(const std::string& strJSON, json_spirit::Value& valRet);
+
+/** Serialize a json_spirit::Value, producing the same text as
+ *  json_spirit::write_string (reals as %.8f, non-printable characters as
+ *  \u00XX, four-space indentation when fPretty) by appending to one string.
+ */
+std::string WriteJSON(const json_spirit::Value& value, bool fPretty = false);
+
+#endif
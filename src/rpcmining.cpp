@@ -530,3 +530,46 @@ Value submitblock(const Array& params, bool fHelp)
     return Value::null;
 }
 
+
+Value generate(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "generate <nblocks>\n"
+            "Mines <nblocks> proof-of-work blocks on top of the best chain right away (regtest only).\n"
+            "Returns the hashes of the new blocks.");
+
+    if (!fRegTest)
+        throw JSONRPCError(RPC_MISC_ERROR, "generate is only available with -regtest");
+
+    int64_t nGenerate = params[0].get_int64();
+    if (nGenerate < 0 || nBestHeight + nGenerate > LAST_POW_BLOCK)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid number of blocks");
+
+    CReserveKey reservekey(pwalletMain);
+    static unsigned int nExtraNonce = 0;
+    Array blockHashes;
+    while (nGenerate-- > 0)
+    {
+        unique_ptr<CBlock> pblock(CreateNewBlock(pwalletMain));
+        if (!pblock.get())
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+
+        // Blocks come faster than the clock ticks, so stay just past the median time
+        pblock->nTime = pblock->vtx[0].nTime = max(pindexBest->GetPastTimeLimit() + 1, GetAdjustedTime());
+        IncrementExtraNonce(pblock.get(), pindexBest, nExtraNonce);
+
+        uint256 hashTarget = CBigNum().SetCompact(pblock->nBits).getuint256();
+        while (pblock->GetHash() > hashTarget)
+        {
+            if (++pblock->nNonce == 0)
+                IncrementExtraNonce(pblock.get(), pindexBest, nExtraNonce);
+        }
+
+        if (!CheckWork(pblock.get(), *pwalletMain, reservekey))
+            throw JSONRPCError(RPC_MISC_ERROR, "Generated block was not accepted");
+        blockHashes.push_back(pblock->GetHash().GetHex());
+    }
+
+    return blockHashes;
+}
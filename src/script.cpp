@@ -19,7 +19,7 @@ using namespace boost;
 #include "sync.h"
 #include "util.h"
 
-bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher=NULL);
 
 static const valtype vchFalse(0);
 static const valtype vchZero(0);
@@ -323,7 +323,7 @@ static bool IsCanonicalSignature(const valtype &vchSig) {
     return true;
 }
 
-bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType)
+bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher)
 {
     CAutoBN_CTX pctx;
     CScript::const_iterator pc = script.begin();
@@ -1016,7 +1016,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, co
 
                     bool fCanonicalSignature = IsCanonicalSignature(vchSig);
                     bool fCanonicalPubKey = IsCanonicalPubKey(vchPubKey);
-                    bool fCheckSig = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                    bool fCheckSig = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType, phasher);
 
                     bool fSuccess = fCanonicalSignature && fCanonicalPubKey &&
                         fCheckSig;
@@ -1084,7 +1084,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, co
 
                         // Check signature
                         bool fOk = IsCanonicalSignature(vchSig) && IsCanonicalPubKey(vchPubKey) &&
-                            CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                            CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType, phasher);
 
                         if (fOk)
                         {
@@ -1199,13 +1199,68 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
     }
 
     // Serialize and hash
-    CDataStream ss(SER_GETHASH, 0);
-    ss.reserve(10000);
+    CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
     if (fDebug) {
-        printf("DEBUG: SignatureHash() : ss=%s", HexStr(ss.begin(), ss.end()).c_str());
+        CDataStream ssDebug(SER_GETHASH, 0);
+        ssDebug << txTmp << nHashType;
+        printf("DEBUG: SignatureHash() : ss=%s", HexStr(ssDebug.begin(), ssDebug.end()).c_str());
     }
-    return Hash(ss.begin(), ss.end());
+    return ss.GetHash();
+}
+
+CSignatureHasher::CSignatureHasher(const CTransaction& txToIn) : txTo(txToIn), nBlankInputSize(0)
+{
+}
+
+void CSignatureHasher::Init()
+{
+    // Every input as it is hashed when it is not the one being signed
+    CDataStream ssInputs(SER_GETHASH, 0);
+    BOOST_FOREACH(const CTxIn& txin, txTo.vin)
+        ssInputs << CTxIn(txin.prevout, CScript(), txin.nSequence);
+    vchBlankInputs.assign(ssInputs.begin(), ssInputs.end());
+    if (!txTo.vin.empty())
+        nBlankInputSize = vchBlankInputs.size() / txTo.vin.size();
+
+    CDataStream ssTail(SER_GETHASH, 0);
+    ssTail << txTo.vout << txTo.nLockTime;
+    vchTail.assign(ssTail.begin(), ssTail.end());
+
+    // State before the first input
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << txTo.nVersion << txTo.nTime;
+    WriteCompactSize(ss, txTo.vin.size());
+    vMidstate.push_back(ss);
+}
+
+uint256 CSignatureHasher::SignatureHash(CScript scriptCode, unsigned int nIn, int nHashType)
+{
+    if (nIn >= txTo.vin.size() || (nHashType & SIGHASH_ANYONECANPAY) ||
+        (nHashType & 0x1f) == SIGHASH_NONE || (nHashType & 0x1f) == SIGHASH_SINGLE)
+        return ::SignatureHash(scriptCode, txTo, nIn, nHashType);
+
+    if (vMidstate.empty())
+        Init();
+
+    // Same as SignatureHash(): codeseparators are not hashed
+    scriptCode.FindAndDelete(CScript(OP_CODESEPARATOR));
+
+    // Extend the cached states up to this input
+    while (vMidstate.size() <= nIn)
+    {
+        CHashWriter ssNext(vMidstate.back());
+        ssNext.write((const char*)&vchBlankInputs[(vMidstate.size() - 1) * nBlankInputSize], nBlankInputSize);
+        vMidstate.push_back(ssNext);
+    }
+
+    CHashWriter ss(vMidstate[nIn]);
+    ss << txTo.vin[nIn].prevout << scriptCode << txTo.vin[nIn].nSequence;
+    if (nIn + 1 < txTo.vin.size())
+        ss.write((const char*)&vchBlankInputs[(nIn + 1) * nBlankInputSize], (txTo.vin.size() - nIn - 1) * nBlankInputSize);
+    ss.write((const char*)&vchTail[0], vchTail.size());
+    ss << nHashType;
+    return ss.GetHash();
 }
 
 
@@ -1266,7 +1321,7 @@ public:
 };
 
 bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode,
-              const CTransaction& txTo, unsigned int nIn, int nHashType)
+              const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher)
 {
     static CSignatureCache signatureCache;
 
@@ -1283,19 +1338,13 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
     }
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
+    uint256 sighash = phasher ? phasher->SignatureHash(scriptCode, nIn, nHashType) : SignatureHash(scriptCode, txTo, nIn, nHashType);
 
     if (signatureCache.Get(sighash, vchSig, vchPubKey))
         return true;
 
-    CKey key;
-    if (!key.SetPubKey(vchPubKey)) {
-        printf("CheckSig: !key.SetPubKey(vchPubKey)\n");
-        return false;
-    }
-
-    if (!key.Verify(sighash, vchSig)) {    
-        printf("CheckSig: !key.Verify(sighash, vchSig)\n");
+    if (!CPubKey(vchPubKey).Verify(sighash, vchSig)) {
+        printf("CheckSig: !CPubKey(vchPubKey).Verify(sighash, vchSig)\n");
         return false;
     }
 
@@ -1702,17 +1751,17 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, vecto
 }
 
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CTransaction& txTo, unsigned int nIn,
-                  int nHashType)
+                  int nHashType, CSignatureHasher* phasher)
 {
     vector<vector<unsigned char> > stack, stackCopy;
-    if (!EvalScript(stack, scriptSig, txTo, nIn, nHashType)) {
+    if (!EvalScript(stack, scriptSig, txTo, nIn, nHashType, phasher)) {
         printf("ERROR VerifyScript: !EvalScript(stack, scriptSig, txTo, nIn, nHashType)\n");
         return false;
     }
 
     stackCopy = stack;
 
-    if (!EvalScript(stack, scriptPubKey, txTo, nIn, nHashType)) {
+    if (!EvalScript(stack, scriptPubKey, txTo, nIn, nHashType, phasher)) {
         printf("ERROR VerifyScript: !EvalScript(stack, scriptPubKey, txTo, nIn, nHashType)\n");
         return false;
     }
@@ -1738,7 +1787,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
         CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
         popstack(stackCopy);
 
-        if (!EvalScript(stackCopy, pubKey2, txTo, nIn, nHashType)) {
+        if (!EvalScript(stackCopy, pubKey2, txTo, nIn, nHashType, phasher)) {
             printf("ERROR VerifyScript: !EvalScript(stackCopy, pubKey2, txTo, nIn, nHashType)\n");
             return false;
         }
@@ -1758,14 +1807,14 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
 }
 
 
-bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType)
+bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher)
 {
     assert(nIn < txTo.vin.size());
     CTxIn& txin = txTo.vin[nIn];
 
     // Leave out the signature from the hash, since a signature can't sign itself.
     // The checksig op will also drop the signatures from its hash.
-    uint256 hash = SignatureHash(fromPubKey, txTo, nIn, nHashType);
+    uint256 hash = phasher ? phasher->SignatureHash(fromPubKey, nIn, nHashType) : SignatureHash(fromPubKey, txTo, nIn, nHashType);
 
     txnouttype whichType;
     if (!Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType))
@@ -1779,7 +1828,7 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransa
         CScript subscript = txin.scriptSig;
 
         // Recompute txn hash using subscript in place of scriptPubKey:
-        uint256 hash2 = SignatureHash(subscript, txTo, nIn, nHashType);
+        uint256 hash2 = phasher ? phasher->SignatureHash(subscript, nIn, nHashType) : SignatureHash(subscript, txTo, nIn, nHashType);
 
         txnouttype subType;
         bool fSolved =
@@ -1790,10 +1839,10 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransa
     }
 
     // Test solution
-    return VerifyScript(txin.scriptSig, fromPubKey, txTo, nIn, 0);
+    return VerifyScript(txin.scriptSig, fromPubKey, txTo, nIn, 0, phasher);
 }
 
-bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType)
+bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher)
 {
     assert(nIn < txTo.vin.size());
     CTxIn& txin = txTo.vin[nIn];
@@ -1801,10 +1850,10 @@ bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTrans
     assert(txin.prevout.hash == txFrom.GetHash());
     const CTxOut& txout = txFrom.vout[txin.prevout.n];
 
-    return SignSignature(keystore, txout.scriptPubKey, txTo, nIn, nHashType);
+    return SignSignature(keystore, txout.scriptPubKey, txTo, nIn, nHashType, phasher);
 }
 
-bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType)
+bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher)
 {
     assert(nIn < txTo.vin.size());
     const CTxIn& txin = txTo.vin[nIn];    
@@ -1822,7 +1871,7 @@ bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsig
         return false;
     }
 
-    if (!VerifyScript(txin.scriptSig, txout.scriptPubKey, txTo, nIn, nHashType)) {
+    if (!VerifyScript(txin.scriptSig, txout.scriptPubKey, txTo, nIn, nHashType, phasher)) {
         printf("ERROR VerifySignature: txin.scriptSig [%s], txout.scriptPubKey [%s]\n", 
             HexStr(txin.scriptSig.begin(), txin.scriptSig.end(), true).c_str(), 
             HexStr(txout.scriptPubKey.begin(), txout.scriptPubKey.end(), true).c_str());
@@ -594,7 +594,33 @@ public:
 
 
 
-bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/** Signature hashing state shared by all inputs of one transaction.
+ * For SIGHASH_ALL the serialization of every input with a blank scriptSig,
+ * and of the outputs and lock time, is built once, and the SHA-256 state after
+ * each input prefix is kept; hashing input n then only serializes its own
+ * scriptCode instead of copying and re-serializing the whole transaction.
+ * The state is built on first use; other hash types fall back to
+ * SignatureHash(). Only the scriptSigs of txTo may change while the hasher
+ * is in use.
+ */
+class CSignatureHasher
+{
+private:
+    const CTransaction& txTo;
+    unsigned int nBlankInputSize;
+    std::vector<unsigned char> vchBlankInputs;
+    std::vector<unsigned char> vchTail;
+    std::vector<CHashWriter> vMidstate;
+
+    void Init();
+
+public:
+    CSignatureHasher(const CTransaction& txToIn);
+    uint256 SignatureHash(CScript scriptCode, unsigned int nIn, int nHashType);
+};
+
+uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher=NULL);
 bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<std::vector<unsigned char> >& vSolutionsRet);
 int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char> >& vSolutions);
 bool IsStandard(const CScript& scriptPubKey);
@@ -603,11 +629,11 @@ bool IsMine(const CKeyStore& keystore, const CTxDestination &dest);
 void ExtractAffectedKeys(const CKeyStore &keystore, const CScript& scriptPubKey, std::vector<CKeyID> &vKeys);
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet);
 bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<CTxDestination>& addressRet, int& nRequiredRet);
-bool SignSignature(const CKeyStore& keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
-bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
+bool SignSignature(const CKeyStore& keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL, CSignatureHasher* phasher=NULL);
+bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL, CSignatureHasher* phasher=NULL);
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CTransaction& txTo, unsigned int nIn,
-                  int nHashType);
-bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType);
+                  int nHashType, CSignatureHasher* phasher=NULL);
+bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType, CSignatureHasher* phasher=NULL);
 
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
@@ -0,0 +1,337 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sha256.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+// The vector helpers are always inlined, so their nominal calling convention
+// never applies
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#ifdef __GNUC__
+#define SHA256_INLINE inline __attribute__((always_inline))
+#else
+#define SHA256_INLINE inline
+#endif
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+SHA256_INLINE uint32_t ReadBE32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+SHA256_INLINE void WriteBE32(unsigned char* p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+/* The round function is written once for a type V holding one 32-bit word
+ * per lane: plain uint32_t for one input at a time, or a GCC vector type to
+ * hash 4 or 8 inputs side by side. When inlined into a function compiled for
+ * SSE4.1 or AVX2 the vector operations become single instructions.
+ */
+template<typename V> SHA256_INLINE V Splat(uint32_t x)
+{
+    uint32_t a[sizeof(V) / 4];
+    for (unsigned int i = 0; i < sizeof(V) / 4; i++)
+        a[i] = x;
+    V v;
+    memcpy(&v, a, sizeof(v));
+    return v;
+}
+
+template<typename V> SHA256_INLINE V Rotr(V x, int n) { return (x >> n) | (x << (32 - n)); }
+template<typename V> SHA256_INLINE V Ch(V x, V y, V z) { return z ^ (x & (y ^ z)); }
+template<typename V> SHA256_INLINE V Maj(V x, V y, V z) { return (x & y) | (z & (x | y)); }
+template<typename V> SHA256_INLINE V Sigma0(V x) { return Rotr(x, 2) ^ Rotr(x, 13) ^ Rotr(x, 22); }
+template<typename V> SHA256_INLINE V Sigma1(V x) { return Rotr(x, 6) ^ Rotr(x, 11) ^ Rotr(x, 25); }
+template<typename V> SHA256_INLINE V sigma0(V x) { return Rotr(x, 7) ^ Rotr(x, 18) ^ (x >> 3); }
+template<typename V> SHA256_INLINE V sigma1(V x) { return Rotr(x, 17) ^ Rotr(x, 19) ^ (x >> 10); }
+
+// One compression of the 16-word block w (overwritten by the message
+// schedule) into the state s
+template<typename V> SHA256_INLINE void Compress(V s[8], V w[16])
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++)
+    {
+        if (i >= 16)
+            w[i & 15] += sigma1(w[(i + 14) & 15]) + w[(i + 9) & 15] + sigma0(w[(i + 1) & 15]);
+        V t1 = h + Sigma1(e) + Ch(e, f, g) + Splat<V>(K[i]) + w[i & 15];
+        V t2 = Sigma0(a) + Maj(a, b, c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+}
+
+// Double SHA-256 of N consecutive 64-byte inputs, one per lane of V
+template<typename V, int N> SHA256_INLINE void TransformD64(unsigned char* pout, const unsigned char* pin)
+{
+    V s[8], w[16];
+    uint32_t a[N];
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int j = 0; j < N; j++)
+            a[j] = ReadBE32(pin + 64 * j + 4 * i);
+        memcpy(&w[i], a, sizeof(V));
+    }
+    for (int i = 0; i < 8; i++)
+        s[i] = Splat<V>(IV[i]);
+    Compress(s, w);
+
+    // Padding block of a 64-byte message
+    w[0] = Splat<V>(0x80000000);
+    for (int i = 1; i < 15; i++)
+        w[i] = Splat<V>(0);
+    w[15] = Splat<V>(512);
+    Compress(s, w);
+
+    // Second hash, over the 32-byte digest
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = Splat<V>(0x80000000);
+    for (int i = 9; i < 15; i++)
+        w[i] = Splat<V>(0);
+    w[15] = Splat<V>(256);
+    for (int i = 0; i < 8; i++)
+        s[i] = Splat<V>(IV[i]);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++)
+    {
+        memcpy(a, &s[i], sizeof(V));
+        for (int j = 0; j < N; j++)
+            WriteBE32(pout + 32 * j + 4 * i, a[j]);
+    }
+}
+
+void SHA256D64Generic(unsigned char* pout, const unsigned char* pin, size_t nBlocks)
+{
+    for (size_t i = 0; i < nBlocks; i++)
+        TransformD64<uint32_t, 1>(pout + 32 * i, pin + 64 * i);
+}
+
+#ifdef USE_SHA256_X86
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+
+__attribute__((target("sse4.1")))
+void SHA256D64SSE41(unsigned char* pout, const unsigned char* pin, size_t nBlocks)
+{
+    for (; nBlocks >= 4; nBlocks -= 4, pout += 128, pin += 256)
+        TransformD64<v4u32, 4>(pout, pin);
+    for (; nBlocks > 0; nBlocks--, pout += 32, pin += 64)
+        TransformD64<uint32_t, 1>(pout, pin);
+}
+
+__attribute__((target("avx2")))
+void SHA256D64AVX2(unsigned char* pout, const unsigned char* pin, size_t nBlocks)
+{
+    for (; nBlocks >= 8; nBlocks -= 8, pout += 256, pin += 512)
+        TransformD64<v8u32, 8>(pout, pin);
+    if (nBlocks >= 4)
+    {
+        TransformD64<v4u32, 4>(pout, pin);
+        nBlocks -= 4, pout += 128, pin += 256;
+    }
+    for (; nBlocks > 0; nBlocks--, pout += 32, pin += 64)
+        TransformD64<uint32_t, 1>(pout, pin);
+}
+
+/* SHA extensions keep the state as two registers, ABEF and CDGH, and run
+ * two rounds per sha256rnds2. Message words are four to a register, in
+ * lane order W[i], W[i+1], W[i+2], W[i+3].
+ */
+__attribute__((target("sha,sse4.1")))
+inline void TransformSHANI(__m128i& abef, __m128i& cdgh, __m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    __m128i abefSave = abef, cdghSave = cdgh;
+    __m128i m[4] = { m0, m1, m2, m3 };
+    for (int i = 0; i < 16; i++)
+    {
+        if (i >= 4)
+        {
+            // W[t] from W[t-16], W[t-15], W[t-7] and W[t-2], four at a time
+            __m128i x = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+            x = _mm_add_epi32(x, _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4));
+            m[i & 3] = _mm_sha256msg2_epu32(x, m[(i + 3) & 3]);
+        }
+        __m128i msg = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i*)&K[4 * i]));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+    }
+    abef = _mm_add_epi32(abef, abefSave);
+    cdgh = _mm_add_epi32(cdgh, cdghSave);
+}
+
+__attribute__((target("sha,sse4.1")))
+void SHA256D64SHANI(unsigned char* pout, const unsigned char* pin, size_t nBlocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // Initial state, from DCBA/HGFE lane order to ABEF/CDGH
+    __m128i dcba = _mm_loadu_si128((const __m128i*)&IV[0]);
+    __m128i hgfe = _mm_loadu_si128((const __m128i*)&IV[4]);
+    __m128i tmp = _mm_shuffle_epi32(dcba, 0xB1);
+    hgfe = _mm_shuffle_epi32(hgfe, 0x1B);
+    const __m128i abefInit = _mm_alignr_epi8(tmp, hgfe, 8);
+    const __m128i cdghInit = _mm_blend_epi16(hgfe, tmp, 0xF0);
+
+    const __m128i pad0 = _mm_set_epi32(0, 0, 0, 0x80000000);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pad512 = _mm_set_epi32(512, 0, 0, 0);
+    const __m128i pad256 = _mm_set_epi32(256, 0, 0, 0);
+
+    for (; nBlocks > 0; nBlocks--, pout += 32, pin += 64)
+    {
+        __m128i abef = abefInit, cdgh = cdghInit;
+        TransformSHANI(abef, cdgh,
+                       _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pin + 0)), bswap),
+                       _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pin + 16)), bswap),
+                       _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pin + 32)), bswap),
+                       _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pin + 48)), bswap));
+        TransformSHANI(abef, cdgh, pad0, zero, zero, pad512);
+
+        // Back to DCBA/HGFE, which is exactly the first half of the second block
+        tmp = _mm_shuffle_epi32(abef, 0x1B);
+        cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+        dcba = _mm_blend_epi16(tmp, cdgh, 0xF0);
+        hgfe = _mm_alignr_epi8(cdgh, tmp, 8);
+
+        abef = abefInit;
+        cdgh = cdghInit;
+        TransformSHANI(abef, cdgh, dcba, hgfe, pad0, pad256);
+
+        tmp = _mm_shuffle_epi32(abef, 0x1B);
+        cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+        dcba = _mm_blend_epi16(tmp, cdgh, 0xF0);
+        hgfe = _mm_alignr_epi8(cdgh, tmp, 8);
+        _mm_storeu_si128((__m128i*)(pout + 0), _mm_shuffle_epi8(dcba, bswap));
+        _mm_storeu_si128((__m128i*)(pout + 16), _mm_shuffle_epi8(hgfe, bswap));
+    }
+}
+
+void CPUID(uint32_t nLeaf, uint32_t nSubLeaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+    __cpuid_count(nLeaf, nSubLeaf, a, b, c, d);
+}
+#endif
+
+typedef void (*SHA256D64Func)(unsigned char* pout, const unsigned char* pin, size_t nBlocks);
+
+// Check an implementation against the generic code before trusting it
+bool SelfTest(SHA256D64Func func)
+{
+    unsigned char in[64 * 11], out[32 * 11], outRef[32 * 11];
+    for (unsigned int i = 0; i < sizeof(in); i++)
+        in[i] = (unsigned char)(i * 7 + (i >> 6));
+    SHA256D64Generic(outRef, in, 11);
+    func(out, in, 11);
+    return memcmp(out, outRef, sizeof(out)) == 0;
+}
+
+struct CSHA256D64Dispatch
+{
+    SHA256D64Func func;
+    std::string strName;
+
+    CSHA256D64Dispatch() : func(SHA256D64Generic), strName("generic")
+    {
+#ifdef USE_SHA256_X86
+        uint32_t a, b, c, d;
+        CPUID(0, 0, a, b, c, d);
+        uint32_t nMaxLeaf = a;
+        CPUID(1, 0, a, b, c, d);
+        bool fSSE41 = (c >> 19) & 1;
+        bool fAVX = false;
+        if (((c >> 27) & 1) && ((c >> 28) & 1))
+        {
+            // The OS must save the YMM registers too
+            uint32_t nXCR0Low, nXCR0High;
+            __asm__ ("xgetbv" : "=a"(nXCR0Low), "=d"(nXCR0High) : "c"(0));
+            fAVX = (nXCR0Low & 6) == 6;
+        }
+        bool fAVX2 = false, fSHA = false;
+        if (nMaxLeaf >= 7)
+        {
+            CPUID(7, 0, a, b, c, d);
+            fAVX2 = fAVX && ((b >> 5) & 1);
+            fSHA = (b >> 29) & 1;
+        }
+
+        if (fSSE41 && SelfTest(SHA256D64SSE41))
+        {
+            func = SHA256D64SSE41;
+            strName = "sse4.1 (4-way)";
+        }
+        if (fAVX2 && SelfTest(SHA256D64AVX2))
+        {
+            func = SHA256D64AVX2;
+            strName = "avx2 (8-way)";
+        }
+        if (fSHA && fSSE41 && SelfTest(SHA256D64SHANI))
+        {
+            func = SHA256D64SHANI;
+            strName = "shani";
+        }
+#endif
+    }
+};
+
+const CSHA256D64Dispatch& GetDispatch()
+{
+    static const CSHA256D64Dispatch dispatch;
+    return dispatch;
+}
+
+}
+
+void SHA256D64(unsigned char* pout, const unsigned char* pin, size_t nBlocks)
+{
+    GetDispatch().func(pout, pin, nBlocks);
+}
+
+std::string SHA256D64Implementation()
+{
+    return GetDispatch().strName;
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2015 The MotaCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_SHA256_H
+#define BITCOIN_SHA256_H
+
+#include <stddef.h>
+#include <string>
+
+/** Double SHA-256 of nBlocks consecutive 64-byte inputs, writing one 32-byte
+ *  digest per input: pout[32*i] = SHA256(SHA256(pin[64*i .. 64*i+63])).
+ *  These are the merkle tree node hashes. Several inputs are hashed at once
+ *  using the widest implementation the CPU supports (SHA extensions, AVX2
+ *  8-way or SSE4.1 4-way), chosen at run time.
+ */
+void SHA256D64(unsigned char* pout, const unsigned char* pin, size_t nBlocks);
+
+/** Name of the SHA256D64 implementation in use, for the debug log */
+std::string SHA256D64Implementation();
+
+#endif
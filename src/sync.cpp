@@ -127,3 +127,143 @@ void LeaveCritical()
 }
 
 #endif /* DEBUG_LOCKORDER */
+
+#ifdef LOCK_PROFILE
+//
+// Lock contention profiling.
+// Every acquisition through CMutexLock or ENTER_CRITICAL_SECTION reports
+// here how long it waited; every release reports how long the lock was held
+// since the thread's outermost acquisition of it. The counters are guarded
+// by a single mutex, which makes this a diagnostic build only.
+//
+
+struct CHeldLock
+{
+    void* cs;
+    CLockStats* pstats;
+    int64_t nStart;
+    bool fOuter;
+};
+
+typedef std::vector<CHeldLock> HeldLockStack;
+
+static boost::mutex mutexLockProfile;
+static std::map<std::string, CLockStats> mapLockStats;
+static std::map<const char*, CLockStats*> mapLockStatsByName;
+static boost::thread_specific_ptr<HeldLockStack> heldlocks;
+
+// Caller holds mutexLockProfile
+static CLockStats* FindLockStats(const char* pszName)
+{
+    std::map<const char*, CLockStats*>::iterator mi = mapLockStatsByName.find(pszName);
+    if (mi != mapLockStatsByName.end())
+        return mi->second;
+
+    std::string strName(pszName);
+    size_t nPos = strName.rfind("->");
+    if (nPos != std::string::npos)
+        strName = strName.substr(nPos + 2);
+    nPos = strName.rfind("::");
+    if (nPos != std::string::npos)
+        strName = strName.substr(nPos + 2);
+    if (!strName.empty() && strName[0] == '*')
+        strName = strName.substr(1);
+
+    CLockStats* pstats = &mapLockStats[strName];
+    mapLockStatsByName[pszName] = pstats;
+    return pstats;
+}
+
+int64_t GetLockProfileTime()
+{
+    return GetTimeMicros();
+}
+
+void LockProfileAcquired(const char* pszName, const char* pszFile, int nLine, void* cs, bool fContended, int64_t nWaitMicros)
+{
+    if (heldlocks.get() == NULL)
+        heldlocks.reset(new HeldLockStack);
+    HeldLockStack& held = *heldlocks;
+
+    CHeldLock entry;
+    entry.cs = cs;
+    entry.fOuter = true;
+    BOOST_FOREACH(const CHeldLock& other, held)
+    {
+        if (other.cs == cs)
+        {
+            entry.fOuter = false;
+            break;
+        }
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutexLockProfile);
+        entry.pstats = FindLockStats(pszName);
+        CLockStats& stats = *entry.pstats;
+        stats.nAcquires++;
+        if (!entry.fOuter)
+            stats.nRecursive++;
+        else
+        {
+            stats.wait.Add(nWaitMicros);
+            if (fContended)
+            {
+                stats.nContended++;
+                CLockSiteStats& site = stats.mapSites[std::make_pair(pszFile, nLine)];
+                site.nContended++;
+                site.nWaitMicros += nWaitMicros;
+                if (nWaitMicros > site.nMaxWaitMicros)
+                    site.nMaxWaitMicros = nWaitMicros;
+            }
+        }
+    }
+
+    entry.nStart = entry.fOuter ? GetLockProfileTime() : 0;
+    held.push_back(entry);
+}
+
+void LockProfileReleased(void* cs)
+{
+    if (heldlocks.get() == NULL)
+        return;
+    HeldLockStack& held = *heldlocks;
+
+    // Usually the most recently taken lock, but LEAVE_CRITICAL_SECTION
+    // doesn't have to be called in reverse order
+    for (HeldLockStack::reverse_iterator it = held.rbegin(); it != held.rend(); ++it)
+    {
+        if (it->cs != cs)
+            continue;
+        if (it->fOuter)
+        {
+            int64_t nHeld = GetLockProfileTime() - it->nStart;
+            boost::mutex::scoped_lock lock(mutexLockProfile);
+            it->pstats->hold.Add(nHeld);
+        }
+        held.erase(--(it.base()));
+        return;
+    }
+}
+
+void LockProfileTryFailed(const char* pszName, const char* pszFile, int nLine)
+{
+    boost::mutex::scoped_lock lock(mutexLockProfile);
+    FindLockStats(pszName)->nTryFailed++;
+}
+
+void GetLockProfile(std::map<std::string, CLockStats>& mapStats)
+{
+    boost::mutex::scoped_lock lock(mutexLockProfile);
+    mapStats = mapLockStats;
+}
+
+void ResetLockProfile()
+{
+    // Cleared in place: held locks and the name cache point into the map
+    boost::mutex::scoped_lock lock(mutexLockProfile);
+    for (std::map<std::string, CLockStats>::iterator mi = mapLockStats.begin(); mi != mapLockStats.end(); ++mi)
+        mi->second = CLockStats();
+}
+
+#endif /* LOCK_PROFILE */
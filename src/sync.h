@@ -11,6 +11,13 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#ifdef LOCK_PROFILE
+#include "perfstats.h"
+
+#include <map>
+#include <string>
+#endif
+
 
 
 
@@ -32,6 +39,44 @@ void static inline LeaveCritical() {}
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+#ifdef LOCK_PROFILE
+/** Contended acquisitions of a lock from one call site */
+struct CLockSiteStats
+{
+    uint64_t nContended;
+    int64_t nWaitMicros;
+    int64_t nMaxWaitMicros;
+
+    CLockSiteStats() : nContended(0), nWaitMicros(0), nMaxWaitMicros(0) {}
+};
+
+/** Profile of one named lock. Locks are named after the expression passed
+ * to LOCK or ENTER_CRITICAL_SECTION, with any pointer or namespace prefix
+ * stripped so that e.g. every node's cs_vSend is counted together */
+struct CLockStats
+{
+    uint64_t nAcquires;     // all acquisitions, recursive ones included
+    uint64_t nRecursive;    // re-entered by a thread already holding it
+    uint64_t nContended;    // had to wait for another thread
+    uint64_t nTryFailed;    // TRY_LOCK that didn't get the lock
+    CPerfHistogram wait;    // outermost acquisitions only
+    CPerfHistogram hold;    // from outermost acquisition to final release
+    std::map<std::pair<const char*, int>, CLockSiteStats> mapSites; // by __FILE__, __LINE__
+
+    CLockStats() : nAcquires(0), nRecursive(0), nContended(0), nTryFailed(0) {}
+};
+
+void GetLockProfile(std::map<std::string, CLockStats>& mapStats);
+void ResetLockProfile();
+
+int64_t GetLockProfileTime();
+void LockProfileAcquired(const char* pszName, const char* pszFile, int nLine, void* cs, bool fContended, int64_t nWaitMicros);
+void LockProfileReleased(void* cs);
+void LockProfileTryFailed(const char* pszName, const char* pszFile, int nLine);
+#else
+void static inline LockProfileReleased(void* cs) {}
+#endif
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template<typename Mutex>
 class CMutexLock
@@ -45,6 +90,19 @@ public:
         if (!lock.owns_lock())
         {
             EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+#ifdef LOCK_PROFILE
+            if (lock.try_lock())
+            {
+                LockProfileAcquired(pszName, pszFile, nLine, (void*)(lock.mutex()), false, 0);
+                return;
+            }
+#ifdef DEBUG_LOCKCONTENTION
+            PrintLockContention(pszName, pszFile, nLine);
+#endif
+            int64_t nStart = GetLockProfileTime();
+            lock.lock();
+            LockProfileAcquired(pszName, pszFile, nLine, (void*)(lock.mutex()), true, GetLockProfileTime() - nStart);
+#else
 #ifdef DEBUG_LOCKCONTENTION
             if (!lock.try_lock())
             {
@@ -53,6 +111,7 @@ public:
             lock.lock();
 #ifdef DEBUG_LOCKCONTENTION
             }
+#endif
 #endif
         }
     }
@@ -62,6 +121,7 @@ public:
         if (lock.owns_lock())
         {
             lock.unlock();
+            LockProfileReleased((void*)(lock.mutex()));
             LeaveCritical();
         }
     }
@@ -72,6 +132,12 @@ public:
         {
             EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
             lock.try_lock();
+#ifdef LOCK_PROFILE
+            if (lock.owns_lock())
+                LockProfileAcquired(pszName, pszFile, nLine, (void*)(lock.mutex()), false, 0);
+            else
+                LockProfileTryFailed(pszName, pszFile, nLine);
+#endif
             if (!lock.owns_lock())
                 LeaveCritical();
         }
@@ -89,7 +155,15 @@ public:
     ~CMutexLock()
     {
         if (lock.owns_lock())
+        {
+#ifdef LOCK_PROFILE
+            // Release here rather than in ~unique_lock so the hold time
+            // doesn't include the rest of the destructor
+            lock.unlock();
+            LockProfileReleased((void*)(lock.mutex()));
+#endif
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -109,15 +183,31 @@ typedef CMutexLock<CCriticalSection> CCriticalBlock;
 #define LOCK2(cs1,cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__),criticalblock2(cs2, #cs2, __FILE__, __LINE__)
 #define TRY_LOCK(cs,name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
 
+#ifdef LOCK_PROFILE
+#define ENTER_CRITICAL_SECTION(cs) \
+    { \
+        EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs)); \
+        if ((cs).try_lock()) \
+            LockProfileAcquired(#cs, __FILE__, __LINE__, (void*)(&cs), false, 0); \
+        else \
+        { \
+            int64_t nLockStart = GetLockProfileTime(); \
+            (cs).lock(); \
+            LockProfileAcquired(#cs, __FILE__, __LINE__, (void*)(&cs), true, GetLockProfileTime() - nLockStart); \
+        } \
+    }
+#else
 #define ENTER_CRITICAL_SECTION(cs) \
     { \
         EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs)); \
         (cs).lock(); \
     }
+#endif
 
 #define LEAVE_CRITICAL_SECTION(cs) \
     { \
         (cs).unlock(); \
+        LockProfileReleased((void*)(&cs)); \
         LeaveCritical(); \
     }
 
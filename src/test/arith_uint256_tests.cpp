@@ -0,0 +1,131 @@
+#include <boost/test/unit_test.hpp>
+
+#include "arith_uint256.h"
+#include "bignum.h"
+#include "main.h"
+#include "kernel.h"
+
+BOOST_AUTO_TEST_SUITE(arith_uint256_tests)
+
+// Deterministic, so that a failure can be reproduced
+static uint64_t nRandState = 0x853c49e6748fea9bULL;
+static uint64_t Rand64()
+{
+    nRandState ^= nRandState << 13;
+    nRandState ^= nRandState >> 7;
+    nRandState ^= nRandState << 17;
+    return nRandState;
+}
+
+static uint256 RandBits(unsigned int nBits)
+{
+    uint256 n;
+    for (unsigned char* p = n.begin(); p < n.begin() + 32; p += 8)
+    {
+        uint64_t r = Rand64();
+        memcpy(p, &r, 8);
+    }
+    return nBits >= 256 ? n : n >> (256 - nBits);
+}
+
+// nBits values shaped like real targets plus the corner cases of the
+// compact encoding: sign bit, short mantissas and exponents past 256 bits
+static unsigned int RandCompact()
+{
+    switch (Rand64() % 4)
+    {
+    case 0: return (unsigned int)Rand64();
+    case 1: return (unsigned int)(((0x18 + Rand64() % 8) << 24) | (Rand64() & 0x7fffff));
+    case 2: return (unsigned int)(((Rand64() % 40) << 24) | (Rand64() & 0xffffff));
+    default: return (unsigned int)((Rand64() % 40) << 24 | (Rand64() % 3 == 0 ? 0x800000 : 0) | (Rand64() & 0xff));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_compact)
+{
+    for (int i = 0; i < 20000; i++)
+    {
+        unsigned int nBits = RandCompact();
+        CBigNum bn;
+        bn.SetCompact(nBits);
+        bool fNegative, fOverflow;
+        arith_uint256 a;
+        a.SetCompact(nBits, &fNegative, &fOverflow);
+
+        BOOST_CHECK_EQUAL(fNegative, bn < 0);
+        BOOST_CHECK_EQUAL(fOverflow, bn > CBigNum(~uint256(0)) || CBigNum(0) - bn > CBigNum(~uint256(0)));
+        if (!fNegative && !fOverflow)
+        {
+            BOOST_CHECK(a.getuint256() == bn.getuint256());
+            BOOST_CHECK_EQUAL(a.GetCompact(), bn.GetCompact());
+        }
+
+        // GetCompact of an arbitrary value
+        uint256 n = RandBits(Rand64() % 257);
+        BOOST_CHECK_EQUAL(arith_uint256(n).GetCompact(), CBigNum(n).GetCompact());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_muldiv)
+{
+    for (int i = 0; i < 5000; i++)
+    {
+        uint256 a = RandBits(Rand64() % 257);
+        uint256 b = RandBits(Rand64() % 257);
+        arith_uint512 a512 = arith_uint512(arith_uint256(a));
+        arith_uint512 b512 = arith_uint512(arith_uint256(b));
+
+        // Full products fit in 512 bits, quotients and sums in 256
+        CBigNum bnProduct = CBigNum(a) * CBigNum(b);
+        BOOST_CHECK((arith_uint256((a512 * b512) >> 256)).getuint256() == (bnProduct >> 256).getuint256());
+        BOOST_CHECK(arith_uint256(a512 * b512).getuint256() == (bnProduct - ((bnProduct >> 256) << 256)).getuint256());
+        if (b != 0)
+            BOOST_CHECK(arith_uint256(arith_uint256(a) / arith_uint256(b)).getuint256() == (CBigNum(a) / CBigNum(b)).getuint256());
+        uint32_t nDivisor = (uint32_t)Rand64() >> (Rand64() % 32);
+        if (nDivisor != 0)
+            BOOST_CHECK(arith_uint256(arith_uint256(a) / nDivisor).getuint256() == (CBigNum(a) / CBigNum(nDivisor)).getuint256());
+        BOOST_CHECK_EQUAL(arith_uint256(a) < arith_uint256(b), CBigNum(a) < CBigNum(b));
+        unsigned int nShift = Rand64() % 256;
+        BOOST_CHECK(arith_uint256(arith_uint256(a) >> nShift).getuint256() == (CBigNum(a) >> nShift).getuint256());
+        BOOST_CHECK(arith_uint256(arith_uint256(a >> nShift) << nShift).getuint256() == ((CBigNum(a) >> nShift) << nShift).getuint256());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_blocktrust)
+{
+    CBlockIndex index;
+    for (int i = 0; i < 20000; i++)
+    {
+        index.nBits = RandCompact();
+
+        // The CBigNum formula GetBlockTrust used before
+        CBigNum bnTarget;
+        bnTarget.SetCompact(index.nBits);
+        uint256 expected = bnTarget <= 0 ? 0 : ((CBigNum(1)<<256) / (bnTarget+1)).getuint256();
+
+        BOOST_CHECK(index.GetBlockTrust() == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_stake_target)
+{
+    for (int i = 0; i < 20000; i++)
+    {
+        unsigned int nBits = RandCompact();
+        int64_t nValueIn = (int64_t)(Rand64() >> (Rand64() % 64));
+        int64_t nTimeWeight = (int64_t)(Rand64() % (90 * 24 * 60 * 60)) - 60 * 60;
+        uint256 hash = RandBits(Rand64() % 257);
+        if (Rand64() % 8 == 0)
+            nValueIn = -nValueIn;
+
+        // The CBigNum formula stakeTargetHit used before
+        CBigNum bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+        CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
+        bool fExpected = (CBigNum(hash) < bnCoinDayWeight * bnTargetPerCoinDay);
+
+        BOOST_CHECK_EQUAL(stakeTargetHit(hash, nTimeWeight, nValueIn, nBits), fExpected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
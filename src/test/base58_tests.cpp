@@ -55,6 +55,29 @@ BOOST_AUTO_TEST_CASE(base58_DecodeBase58)
     }
 
     BOOST_CHECK(!DecodeBase58("invalid", result));
+
+    // Surrounding whitespace is skipped, whitespace between digits is not
+    BOOST_CHECK(DecodeBase58(" \t112g \n", result));
+    BOOST_CHECK(HexStr(result) == "000061");
+    BOOST_CHECK(!DecodeBase58("112 g", result));
+    BOOST_CHECK(DecodeBase58("", result) && result.empty());
+}
+
+// Goal: round trip inputs of every length, including ones too long for the
+// conversions' stack buffers
+BOOST_AUTO_TEST_CASE(base58_roundtrip)
+{
+    std::vector<unsigned char> result;
+    for (unsigned int nLen = 0; nLen < 400; nLen += (nLen < 40 ? 1 : 37))
+    {
+        std::vector<unsigned char> data(nLen);
+        for (unsigned int i = 0; i < nLen; i++)
+            data[i] = (i < nLen % 3) ? 0 : (unsigned char)(i * 131 + nLen);
+        std::string str = EncodeBase58(data);
+        BOOST_CHECK(str.size() <= nLen * 138 / 100 + 1);
+        BOOST_CHECK(DecodeBase58(str, result));
+        BOOST_CHECK(result == data);
+    }
 }
 
 // Visitor to check address type
@@ -0,0 +1,44 @@
+#include <boost/test/unit_test.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(hash_tests)
+
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    // Reference vectors: SipHash-2-4 of the bytes 00 01 02 ... with key 00 01 .. 0f
+    uint256 x("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    BOOST_CHECK(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x) == 0x7127512f72f27cceULL);
+    BOOST_CHECK(SipHashUint256Extra(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x, 0x23222120) == 0x314dffbe0815a3b4ULL);
+
+    // Each hasher has its own salt
+    CSaltedHasher hasher1, hasher2;
+    BOOST_CHECK(hasher1(x) == hasher1(x));
+    BOOST_CHECK(hasher1(x) != hasher2(x));
+    BOOST_CHECK(hasher1(x, 0) != hasher1(x, 1));
+}
+
+// The salted hasher as the hash of an unordered map keyed by uint256
+BOOST_AUTO_TEST_CASE(salted_unordered_map)
+{
+    std::vector<uint256> vKeys(1000);
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        vKeys[i] = GetRandHash();
+
+    std::unordered_map<uint256, unsigned int, CSaltedHasher> m;
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        m.insert(std::make_pair(vKeys[i], i));
+    BOOST_CHECK(m.size() == vKeys.size());
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+    {
+        std::unordered_map<uint256, unsigned int, CSaltedHasher>::const_iterator it = m.find(vKeys[i]);
+        BOOST_CHECK(it != m.end() && it->second == i);
+    }
+    BOOST_CHECK(m.count(GetRandHash()) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
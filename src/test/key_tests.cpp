@@ -5,9 +5,15 @@
 
 #include "key.h"
 #include "base58.h"
+#include "main.h"
 #include "uint256.h"
 #include "util.h"
 
+#ifdef USE_SECP256K1
+#include <openssl/ecdsa.h>
+#include "json/json_spirit_writer_template.h"
+#endif
+
 using namespace std;
 
 static const string strSecret1     ("5HxWvvfubhXpYYpS3tJkw6fq9jE9j18THftkZjHHfmFiWtmAbrj");
@@ -50,6 +56,44 @@ void dumpKeyInfo(uint256 privkey)
 }
 #endif
 
+#ifdef USE_SECP256K1
+using namespace json_spirit;
+
+// In script_tests.cpp
+extern Array read_json(const std::string& filename);
+extern CScript ParseScript(string s);
+
+// Whenever the secp256k1 backend answers, it must give the OpenSSL answer
+static void CheckSecp256k1Verify(const vector<unsigned char>& vchPubKey, const uint256& hash, const vector<unsigned char>& vchSig)
+{
+    int nResult = Secp256k1Verify(vchPubKey, hash, vchSig);
+    if (nResult < 0)
+        return;
+    CKey key;
+    bool fOpenSSL = key.SetPubKey(CPubKey(vchPubKey)) && key.VerifyOpenSSL(hash, vchSig);
+    BOOST_CHECK_MESSAGE((nResult == 1) == fOpenSSL, "pubkey=" << HexStr(vchPubKey) << " sig=" << HexStr(vchSig));
+}
+
+// Same signature with s replaced by order - s
+static vector<unsigned char> FlipS(const vector<unsigned char>& vchSig)
+{
+    const unsigned char* pbegin = &vchSig[0];
+    ECDSA_SIG* sig = d2i_ECDSA_SIG(NULL, &pbegin, vchSig.size());
+    BOOST_REQUIRE(sig != NULL);
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    BIGNUM* order = BN_new();
+    EC_GROUP_get_order(group, order, NULL);
+    BN_sub(sig->s, order, sig->s);
+    vector<unsigned char> vchRet(i2d_ECDSA_SIG(sig, NULL));
+    unsigned char* pout = &vchRet[0];
+    i2d_ECDSA_SIG(sig, &pout);
+    BN_free(order);
+    EC_GROUP_free(group);
+    ECDSA_SIG_free(sig);
+    return vchRet;
+}
+#endif
+
 
 BOOST_AUTO_TEST_SUITE(key_tests)
 
@@ -144,4 +188,172 @@ BOOST_AUTO_TEST_CASE(key_test1)
     }
 }
 
+BOOST_AUTO_TEST_CASE(key_secret_from_privkey)
+{
+    CBitcoinSecret bsecret1, bsecret2C;
+    BOOST_CHECK(bsecret1.SetString (strSecret1));
+    BOOST_CHECK(bsecret2C.SetString(strSecret2C));
+
+    bool fCompressed;
+    CSecret secret1  = bsecret1.GetSecret (fCompressed);
+    CSecret secret2C = bsecret2C.GetSecret(fCompressed);
+
+    CKey key1, key2C;
+    key1.SetSecret(secret1, false);
+    key2C.SetSecret(secret2C, true);
+
+    CSecret secretOut;
+    BOOST_CHECK(CKey::GetSecretFromPrivKey(key1.GetPrivKey(), secretOut));
+    BOOST_CHECK(secretOut == secret1);
+    BOOST_CHECK(CKey::GetSecretFromPrivKey(key2C.GetPrivKey(), secretOut));
+    BOOST_CHECK(secretOut == secret2C);
+
+    CPrivKey privkeyBad = key1.GetPrivKey();
+    privkeyBad[0] = 0x31;
+    BOOST_CHECK(!CKey::GetSecretFromPrivKey(privkeyBad, secretOut));
+    BOOST_CHECK(!CKey::GetSecretFromPrivKey(CPrivKey(), secretOut));
+    privkeyBad = key1.GetPrivKey();
+    privkeyBad.resize(10);
+    BOOST_CHECK(!CKey::GetSecretFromPrivKey(privkeyBad, secretOut));
+    // Truncated inside the long form SEQUENCE length
+    for (unsigned int nSize = 2; nSize <= 4; nSize++)
+    {
+        privkeyBad = key1.GetPrivKey();
+        privkeyBad[1] = 0x82;
+        privkeyBad.resize(nSize);
+        BOOST_CHECK(!CKey::GetSecretFromPrivKey(privkeyBad, secretOut));
+    }
+}
+
+#ifdef USE_SECP256K1
+BOOST_AUTO_TEST_CASE(key_secp256k1_differential)
+{
+    CBitcoinSecret bsecret1, bsecret2C;
+    BOOST_CHECK(bsecret1.SetString (strSecret1));
+    BOOST_CHECK(bsecret2C.SetString(strSecret2C));
+    bool fCompressed;
+    CKey keys[4];
+    keys[0].SetSecret(bsecret1.GetSecret(fCompressed), false);
+    keys[1].SetSecret(bsecret2C.GetSecret(fCompressed), true);
+    keys[2].MakeNewKey(false);
+    keys[3].MakeNewKey(true);
+
+    for (int n=0; n<4; n++)
+    {
+        string strMsg = strprintf("Very secret message %i: 11", n);
+        uint256 hashMsg = Hash(strMsg.begin(), strMsg.end());
+
+        for (int i=0; i<4; i++)
+        {
+            vector<unsigned char> vchPubKey = keys[i].GetPubKey().Raw();
+            vector<unsigned char> vchSig;
+            BOOST_CHECK(keys[i].Sign(hashMsg, vchSig));
+
+            // Signatures we produce always take the fast path
+            BOOST_CHECK(Secp256k1Verify(vchPubKey, hashMsg, vchSig) == 1);
+            BOOST_CHECK(Secp256k1Verify(vchPubKey, hashMsg + 1, vchSig) == 0);
+            BOOST_CHECK(Secp256k1Verify(keys[(i + 1) % 4].GetPubKey().Raw(), hashMsg, vchSig) == 0);
+
+            // High-S is valid for OpenSSL, so it must be for secp256k1 too
+            BOOST_CHECK(Secp256k1Verify(vchPubKey, hashMsg, FlipS(vchSig)) == 1);
+            BOOST_CHECK(CPubKey(vchPubKey).Verify(hashMsg, FlipS(vchSig)));
+
+            // Hybrid encodings of uncompressed keys
+            if (vchPubKey.size() == 65)
+            {
+                vector<unsigned char> vchHybrid = vchPubKey;
+                vchHybrid[0] = 0x06 | (vchPubKey[64] & 1);
+                CheckSecp256k1Verify(vchHybrid, hashMsg, vchSig);
+                vchHybrid[0] ^= 1;
+                CheckSecp256k1Verify(vchHybrid, hashMsg, vchSig);
+            }
+
+            // Every single-bit corruption, and padded or truncated encodings
+            for (unsigned int nBit = 0; nBit < vchSig.size() * 8; nBit++)
+            {
+                vector<unsigned char> vchBad = vchSig;
+                vchBad[nBit / 8] ^= 1 << (nBit % 8);
+                CheckSecp256k1Verify(vchPubKey, hashMsg, vchBad);
+            }
+            for (unsigned int nPos = 0; nPos <= vchSig.size(); nPos++)
+            {
+                vector<unsigned char> vchBad = vchSig;
+                vchBad.insert(vchBad.begin() + nPos, 0);
+                CheckSecp256k1Verify(vchPubKey, hashMsg, vchBad);
+                vchBad = vchSig;
+                if (nPos < vchSig.size())
+                {
+                    vchBad.erase(vchBad.begin() + nPos);
+                    CheckSecp256k1Verify(vchPubKey, hashMsg, vchBad);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(key_secp256k1_tx_vectors)
+{
+    // Try every signature in the transaction test vectors against every
+    // public key pushed alongside it, and check both backends agree
+    const char* pszFiles[] = { "tx_valid.json", "tx_invalid.json" };
+    BOOST_FOREACH(const char* pszFile, pszFiles)
+    {
+        Array tests = read_json(pszFile);
+        BOOST_FOREACH(Value& tv, tests)
+        {
+            Array test = tv.get_array();
+            if (test[0].type() != array_type || test.size() != 3)
+                continue;
+
+            map<COutPoint, CScript> mapprevOutScriptPubKeys;
+            BOOST_FOREACH(Value& input, test[0].get_array())
+            {
+                Array vinput = input.get_array();
+                mapprevOutScriptPubKeys[COutPoint(uint256(vinput[0].get_str()), vinput[1].get_int())] = ParseScript(vinput[2].get_str());
+            }
+
+            CDataStream stream(ParseHex(test[1].get_str()), SER_NETWORK, PROTOCOL_VERSION);
+            CTransaction tx;
+            stream >> tx;
+
+            for (unsigned int i = 0; i < tx.vin.size(); i++)
+            {
+                const CScript& scriptPubKey = mapprevOutScriptPubKeys[tx.vin[i].prevout];
+                vector<vector<unsigned char> > vPushes;
+                vector<CScript> vScriptCodes(1, scriptPubKey);
+                opcodetype opcode;
+                vector<unsigned char> vch;
+                CScript::const_iterator pc = tx.vin[i].scriptSig.begin();
+                while (tx.vin[i].scriptSig.GetOp(pc, opcode, vch))
+                    if (!vch.empty())
+                        vPushes.push_back(vch);
+                if (!vPushes.empty())
+                    vScriptCodes.push_back(CScript(vPushes.back().begin(), vPushes.back().end()));
+                BOOST_FOREACH(const CScript& scriptCode, vScriptCodes)
+                {
+                    pc = scriptCode.begin();
+                    while (scriptCode.GetOp(pc, opcode, vch))
+                        if (!vch.empty())
+                            vPushes.push_back(vch);
+                }
+
+                BOOST_FOREACH(const vector<unsigned char>& vchSig, vPushes)
+                {
+                    if (vchSig[0] != 0x30)
+                        continue;
+                    vector<unsigned char> vchSigDER(vchSig.begin(), vchSig.end() - 1);
+                    BOOST_FOREACH(const CScript& scriptCode, vScriptCodes)
+                    {
+                        uint256 hash = SignatureHash(scriptCode, tx, i, vchSig.back());
+                        BOOST_FOREACH(const vector<unsigned char>& vchPubKey, vPushes)
+                            if (vchPubKey.size() == 33 || vchPubKey.size() == 65)
+                                CheckSecp256k1Verify(vchPubKey, hash, vchSigDER);
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include "perfstats.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(perfstats_tests)
+
+BOOST_AUTO_TEST_CASE(perfstats_histogram)
+{
+    CPerfHistogram histogram;
+    histogram.Add(0);
+    histogram.Add(1);
+    histogram.Add(2);
+    histogram.Add(3);
+    histogram.Add(1024);
+    histogram.Add(1025);
+    histogram.Add(-5);
+    histogram.Add((int64_t)1 << 40);
+    BOOST_CHECK(histogram.nCount == 8);
+    BOOST_CHECK(histogram.nMaxMicros == (int64_t)1 << 40);
+    BOOST_CHECK(histogram.nTotalMicros == 1 + 2 + 3 + 1024 + 1025 + ((int64_t)1 << 40));
+    BOOST_CHECK(histogram.vBucket[0] == 3); // 0, 1 and the negative sample
+    BOOST_CHECK(histogram.vBucket[1] == 1); // 2
+    BOOST_CHECK(histogram.vBucket[2] == 1); // 3
+    BOOST_CHECK(histogram.vBucket[10] == 1); // 1024
+    BOOST_CHECK(histogram.vBucket[11] == 1); // 1025
+    BOOST_CHECK(histogram.vBucket[PERF_HISTOGRAM_BUCKETS - 1] == 1);
+    BOOST_CHECK(CPerfHistogram::BucketLimit(10) == 1024);
+    BOOST_CHECK(CPerfHistogram::BucketLimit(PERF_HISTOGRAM_BUCKETS - 1) == -1);
+
+    CPerfHistogram merged;
+    merged.Add(7);
+    merged.Merge(histogram);
+    BOOST_CHECK(merged.nCount == 9 && merged.vBucket[3] == 1 && merged.vBucket[10] == 1);
+}
+
+static void RecordOnThread()
+{
+    RenameThread("perfstats-test");
+    PerfRecord("perfstats_tests.op", 10);
+    PerfRecord(std::string("perfstats_tests.") + "dynamic", 20);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_threads)
+{
+    ResetPerfStats();
+    PerfRecord("perfstats_tests.op", 5);
+
+    // Counters of exited threads are kept under the thread's name
+    for (int i = 0; i < 2; i++)
+    {
+        boost::thread thread(RecordOnThread);
+        thread.join();
+    }
+
+    PerfStatsMap mapTotal;
+    std::map<std::string, PerfStatsMap> mapByThread;
+    GetPerfStats(mapTotal, &mapByThread);
+    BOOST_CHECK(mapTotal["perfstats_tests.op"].nCount == 3);
+    BOOST_CHECK(mapTotal["perfstats_tests.op"].nTotalMicros == 25);
+    BOOST_CHECK(mapTotal["perfstats_tests.dynamic"].nCount == 2);
+    BOOST_CHECK(mapByThread["perfstats-test"]["perfstats_tests.op"].nTotalMicros == 20);
+    BOOST_CHECK(mapByThread["perfstats-test"]["perfstats_tests.dynamic"].nTotalMicros == 40);
+
+    std::string strText = FormatPerfStatsPrometheus();
+    BOOST_CHECK(strText.find("motacoin_operation_duration_microseconds_bucket{op=\"perfstats_tests.op\",le=\"8\"} 1\n") != std::string::npos);
+    BOOST_CHECK(strText.find("motacoin_operation_duration_microseconds_bucket{op=\"perfstats_tests.op\",le=\"16\"} 3\n") != std::string::npos);
+    BOOST_CHECK(strText.find("motacoin_operation_duration_microseconds_count{op=\"perfstats_tests.op\"} 3\n") != std::string::npos);
+    BOOST_CHECK(strText.find("motacoin_thread_operation_microseconds_total{thread=\"perfstats-test\",op=\"perfstats_tests.dynamic\"} 40\n") != std::string::npos);
+
+    ResetPerfStats();
+    GetPerfStats(mapTotal);
+    BOOST_CHECK(mapTotal.count("perfstats_tests.op") == 0);
+
+    fPerfStats = false;
+    {
+        CPerfTimer timer("perfstats_tests.disabled");
+    }
+    fPerfStats = true;
+    {
+        CPerfTimer timer("perfstats_tests.timer");
+    }
+    GetPerfStats(mapTotal);
+    BOOST_CHECK(mapTotal.count("perfstats_tests.disabled") == 0);
+    BOOST_CHECK(mapTotal["perfstats_tests.timer"].nCount == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
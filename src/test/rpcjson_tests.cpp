@@ -0,0 +1,124 @@
+#include <boost/test/unit_test.hpp>
+
+#include "json/json_spirit_reader_template.h"
+#include "json/json_spirit_writer_template.h"
+
+#include "rpcjson.h"
+#include "util.h"
+
+using namespace json_spirit;
+
+BOOST_AUTO_TEST_SUITE(rpcjson_tests)
+
+BOOST_AUTO_TEST_CASE(rpcjson_parse)
+{
+    Value v;
+    BOOST_CHECK(ParseJSON(" {\"a\" : [1, -2, 3.5, true, false, null], \"b\":{}} ", v));
+    const Object& obj = v.get_obj();
+    BOOST_CHECK(obj.size() == 2 && obj[0].name_ == "a" && obj[1].name_ == "b");
+    const Array& arr = obj[0].value_.get_array();
+    BOOST_CHECK(arr.size() == 6);
+    BOOST_CHECK(arr[0].get_int64() == 1 && arr[1].get_int64() == -2);
+    BOOST_CHECK(arr[2].type() == real_type && arr[2].get_real() == 3.5);
+    BOOST_CHECK(arr[3].get_bool() && !arr[4].get_bool() && arr[5].is_null());
+    BOOST_CHECK(obj[1].value_.get_obj().empty());
+
+    // Duplicate keys are kept, in order
+    BOOST_CHECK(ParseJSON("{\"k\":1,\"k\":2}", v) && v.get_obj().size() == 2);
+
+    // Numbers: a '.' or exponent makes a real, otherwise int64, then uint64
+    BOOST_CHECK(ParseJSON("1e3", v) && v.type() == real_type && v.get_real() == 1000.0);
+    BOOST_CHECK(ParseJSON(".5", v) && v.get_real() == 0.5);
+    BOOST_CHECK(ParseJSON("-9223372036854775808", v) && v.get_int64() == INT64_MIN && !v.is_uint64());
+    BOOST_CHECK(ParseJSON("18446744073709551615", v) && v.is_uint64() && v.get_uint64() == UINT64_MAX);
+    BOOST_CHECK(!ParseJSON("18446744073709551616", v));
+    BOOST_CHECK(!ParseJSON("-9223372036854775809", v));
+
+    // Escapes, as json_spirit decodes them
+    BOOST_CHECK(ParseJSON("\"\\t\\\"\\/\\x41\\u0042\\q\"", v) && v.get_str() == "\t\"/AB");
+
+    // Trailing text after the first value is ignored
+    BOOST_CHECK(ParseJSON("[1] junk", v) && v.get_array().size() == 1);
+
+    BOOST_CHECK(!ParseJSON("", v));
+    BOOST_CHECK(!ParseJSON("  ", v));
+    BOOST_CHECK(!ParseJSON("[1,]", v));
+    BOOST_CHECK(!ParseJSON("{\"a\" 1}", v));
+    BOOST_CHECK(!ParseJSON("{\"a\":1,}", v));
+    BOOST_CHECK(!ParseJSON("[\"abc", v));
+    BOOST_CHECK(!ParseJSON("\"\\x\"", v));
+    BOOST_CHECK(!ParseJSON("tru", v));
+    BOOST_CHECK(!ParseJSON("-", v));
+}
+
+BOOST_AUTO_TEST_CASE(rpcjson_write)
+{
+    Object obj;
+    obj.push_back(Pair("str", "a\"b\\c\n\x01"));
+    obj.push_back(Pair("real", 0.1));
+    obj.push_back(Pair("int", (int64_t)-42));
+    obj.push_back(Pair("uint", (uint64_t)UINT64_MAX));
+    obj.push_back(Pair("arr", Array()));
+    obj.push_back(Pair("null", Value()));
+    Value v(obj);
+
+    BOOST_CHECK_EQUAL(WriteJSON(v), "{\"str\":\"a\\\"b\\\\c\\n\\u0001\",\"real\":0.10000000,"
+        "\"int\":-42,\"uint\":18446744073709551615,\"arr\":[],\"null\":null}");
+    BOOST_CHECK_EQUAL(WriteJSON(v), write_string(v, false));
+    BOOST_CHECK_EQUAL(WriteJSON(v, true), write_string(v, true));
+}
+
+// Parsing then writing must give the same values and text as json_spirit
+BOOST_AUTO_TEST_CASE(rpcjson_matches_json_spirit)
+{
+    const char* inputs[] = {
+        "[]", "{}", "[[],{}]", "\"\\u00e9\"", "1.", "-0", "+3", "1e", "1.5e-3",
+        "[0.12345678, 1e20, -1E+2]", "{\"a\":{\"b\":[{\"c\":null}]}}",
+        " [ \"x\" , \t\n\"y\" ] ", "\"\\012\"", "[true,false,null]",
+    };
+    for (unsigned int i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        Value vSpirit, vFast;
+        BOOST_CHECK(read_string(std::string(inputs[i]), vSpirit));
+        BOOST_CHECK_MESSAGE(ParseJSON(inputs[i], vFast), inputs[i]);
+        BOOST_CHECK_MESSAGE(WriteJSON(vFast) == write_string(vSpirit, false), inputs[i]);
+        BOOST_CHECK_MESSAGE(WriteJSON(vFast, true) == write_string(vSpirit, true), inputs[i]);
+    }
+}
+
+static std::string SendManyRequest()
+{
+    std::string str = "{\"method\":\"sendmany\",\"params\":[\"\",{";
+    for (int i = 0; i < 50; i++)
+        str += strprintf("%s\"MotaAddr%026d\":%d.%08d", i ? "," : "", i, i % 7, i * 1234567 % 100000000);
+    str += "},1,\"payroll\"],\"id\":1}";
+    return str;
+}
+
+static std::string SignRawTransactionRequest()
+{
+    std::string strTx;
+    for (int i = 0; i < 1000; i++)
+        strTx += strprintf("%02x", (i * 37) & 0xff);
+    std::string str = "{\"method\":\"signrawtransaction\",\"params\":[\"" + strTx + "\",[";
+    for (int i = 0; i < 10; i++)
+        str += strprintf("%s{\"txid\":\"%064x\",\"vout\":%d,\"scriptPubKey\":\"76a914%040x88ac\","
+                         "\"redeemScript\":\"5221%066x21%066x52ae\"}", i ? "," : "", i, i, i, i, i + 1);
+    str += "],[\"PrivKey1\",\"PrivKey2\"],\"ALL\"],\"id\":\"curltest\"}";
+    return str;
+}
+
+// Typical request payloads parse to the same values as with json_spirit
+BOOST_AUTO_TEST_CASE(rpcjson_request_payloads)
+{
+    const std::string payloads[] = { SendManyRequest(), SignRawTransactionRequest() };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        Value vSpirit, vFast;
+        BOOST_CHECK(read_string(payloads[i], vSpirit));
+        BOOST_CHECK(ParseJSON(payloads[i], vFast));
+        BOOST_CHECK(WriteJSON(vFast) == write_string(vSpirit, false));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -442,4 +442,32 @@ BOOST_AUTO_TEST_CASE(script_combineSigs)
     BOOST_CHECK(combined == partial3c);
 }
 
+BOOST_AUTO_TEST_CASE(script_signaturehasher)
+{
+    // CSignatureHasher must produce exactly the same digests as SignatureHash:
+    CTransaction txTo;
+    txTo.vin.resize(5);
+    txTo.vout.resize(3);
+    for (unsigned int i = 0; i < txTo.vin.size(); i++)
+    {
+        txTo.vin[i].prevout.hash = GetRandHash();
+        txTo.vin[i].prevout.n = i;
+        txTo.vin[i].scriptSig = CScript() << OP_1;
+        txTo.vin[i].nSequence = i;
+    }
+    for (unsigned int i = 0; i < txTo.vout.size(); i++)
+    {
+        txTo.vout[i].nValue = (i + 1) * CENT;
+        txTo.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    txTo.nLockTime = 12345;
+
+    CScript scriptCode = CScript() << OP_DUP << OP_HASH160 << vector<unsigned char>(20, 7) << OP_EQUALVERIFY << OP_CHECKSIG;
+    int nHashTypes[] = { SIGHASH_ALL, SIGHASH_NONE, SIGHASH_SINGLE, SIGHASH_ALL|SIGHASH_ANYONECANPAY };
+    CSignatureHasher hasher(txTo);
+    for (unsigned int nIn = 0; nIn < txTo.vin.size(); nIn++)
+        BOOST_FOREACH(int nHashType, nHashTypes)
+            BOOST_CHECK(hasher.SignatureHash(scriptCode, nIn, nHashType) == SignatureHash(scriptCode, txTo, nIn, nHashType));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
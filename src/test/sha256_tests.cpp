@@ -0,0 +1,94 @@
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "main.h"
+#include "sha256.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(sha256_tests)
+
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Odd counts exercise the tails left over by the 4- and 8-way kernels
+    for (size_t nBlocks = 0; nBlocks <= 34; nBlocks++)
+    {
+        std::vector<unsigned char> vIn(64 * nBlocks);
+        for (size_t i = 0; i < vIn.size(); i++)
+            vIn[i] = (unsigned char)(i * 7 + nBlocks);
+        std::vector<unsigned char> vOut(32 * nBlocks + 1, 0xa5);
+
+        SHA256D64(vOut.empty() ? NULL : &vOut[0], vIn.empty() ? NULL : &vIn[0], nBlocks);
+        for (size_t i = 0; i < nBlocks; i++)
+        {
+            uint256 hash = Hash(vIn.begin() + 64 * i, vIn.begin() + 64 * (i + 1));
+            BOOST_CHECK(memcmp(&vOut[32 * i], hash.begin(), 32) == 0);
+        }
+        // Nothing written past the last digest
+        BOOST_CHECK(vOut[32 * nBlocks] == 0xa5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(merkle_tree)
+{
+    for (size_t nLeaves = 1; nLeaves <= 40; nLeaves++)
+    {
+        std::vector<uint256> vLeaves;
+        for (size_t i = 0; i < nLeaves; i++)
+        {
+            uint256 leaf = i * 0x10001 + nLeaves;
+            vLeaves.push_back(Hash(leaf.begin(), leaf.end()));
+        }
+
+        // Reference: the pairwise construction BuildMerkleTree used to do
+        std::vector<uint256> vExpected(vLeaves);
+        int j = 0;
+        for (int nSize = nLeaves; nSize > 1; nSize = (nSize + 1) / 2)
+        {
+            for (int i = 0; i < nSize; i += 2)
+            {
+                int i2 = std::min(i+1, nSize-1);
+                vExpected.push_back(Hash(BEGIN(vExpected[j+i]),  END(vExpected[j+i]),
+                                         BEGIN(vExpected[j+i2]), END(vExpected[j+i2])));
+            }
+            j += nSize;
+        }
+
+        std::vector<uint256> vTree(vLeaves);
+        ComputeMerkleTree(vTree);
+        BOOST_CHECK(vTree == vExpected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hashwriter)
+{
+    CTransaction tx;
+    tx.vin.resize(3);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        tx.vin[i].prevout = COutPoint(uint256(i + 1), i);
+        tx.vin[i].scriptSig << OP_1 << std::vector<unsigned char>(70 + i, 0x30);
+    }
+    tx.vout[0].nValue = 5 * COIN;
+    tx.vout[0].scriptPubKey << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Streaming the fields into the hasher matches hashing the serialized buffer
+    CDataStream ss(SER_GETHASH, 0);
+    ss << tx;
+    BOOST_CHECK(tx.GetHash() == Hash(ss.begin(), ss.end()));
+
+    // A copy carries on from the same state, as stakeHash relies on
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << (uint64_t)0x0123456789abcdefULL;
+    for (unsigned int nTime = 0; nTime < 3; nTime++)
+    {
+        CHashWriter hwCopy(hw);
+        hwCopy << nTime;
+        CDataStream ss2(SER_GETHASH, 0);
+        ss2 << (uint64_t)0x0123456789abcdefULL << nTime;
+        BOOST_CHECK(hwCopy.GetHash() == Hash(ss2.begin(), ss2.end()));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
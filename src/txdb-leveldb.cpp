@@ -26,11 +26,25 @@ using namespace boost;
 
 leveldb::DB *txdb; // global pointer for LevelDB object instance
 
+// Last index version that stored the spending positions inside each "tx"
+// record; such databases are converted in place instead of rebuilt
+static const int TXINDEX_FULLSPENT_VERSION = 70508;
+
+// Whether the ("spender", txid, n) table is maintained (-txindexspenders).
+// Decided once, when the shared database is opened; every CTxDB after
+// that only reads it.
+static bool fTxIndexSpenders = false;
+
+// In-memory environment set up by CTxDB::MakeMock(), NULL for the disk
+static leveldb::Env* penvMock = NULL;
+
 static leveldb::Options GetOptions() {
     leveldb::Options options;
     int nCacheSizeMB = GetArg("-dbcache", 25);
     options.block_cache = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    if (penvMock)
+        options.env = penvMock;
     return options;
 }
 
@@ -86,12 +100,26 @@ CTxDB::CTxDB(const char* pszMode)
     init_blockindex(options); // Init directory
     pdb = txdb;
 
+    bool fSpenders = GetBoolArg("-txindexspenders", false);
+    bool fNewIndex = false;
+
     if (Exists(string("version")))
     {
         ReadVersion(nVersion);
         printf("Transaction index version is %d\n", nVersion);
 
-        if (nVersion < DATABASE_VERSION)
+        if (nVersion == TXINDEX_FULLSPENT_VERSION)
+        {
+            // The migration writes records in the requested format, before
+            // any other CTxDB can use the database
+            fTxIndexSpenders = fSpenders;
+            bool fTmp = fReadOnly;
+            fReadOnly = false;
+            if (!MigrateTxIndex())
+                throw runtime_error("CTxDB() : failed to migrate transaction index");
+            fReadOnly = fTmp;
+        }
+        else if (nVersion < DATABASE_VERSION)
         {
             printf("Required index version is %d, removing old database\n", DATABASE_VERSION);
 
@@ -108,6 +136,7 @@ CTxDB::CTxDB(const char* pszMode)
             fReadOnly = false;
             WriteVersion(DATABASE_VERSION); // Save transaction index version
             fReadOnly = fTmp;
+            fNewIndex = true;
         }
     }
     else if (fCreate)
@@ -116,11 +145,51 @@ CTxDB::CTxDB(const char* pszMode)
         fReadOnly = false;
         WriteVersion(DATABASE_VERSION);
         fReadOnly = fTmp;
+        fNewIndex = true;
+    }
+
+    // The spender table is only usable if it has been maintained since the
+    // index was created
+    bool fHaveSpenders = Exists(string("txindexspenders"));
+    if (fSpenders && !fHaveSpenders && !fNewIndex)
+    {
+        printf("-txindexspenders ignored: the transaction index was built without it, remove txleveldb to rebuild\n");
+        fSpenders = false;
+    }
+    else if (fSpenders != fHaveSpenders)
+    {
+        bool fTmp = fReadOnly;
+        fReadOnly = false;
+        if (fSpenders)
+            Write(string("txindexspenders"), true);
+        else
+            Erase(string("txindexspenders"));
+        fReadOnly = fTmp;
+    }
+    if (!fSpenders)
+    {
+        // Drop the rows of a spender table that is no longer maintained
+        bool fTmp = fReadOnly;
+        fReadOnly = false;
+        if (!EraseTxSpenders())
+            throw runtime_error("CTxDB() : failed to erase the transaction spender index");
+        fReadOnly = fTmp;
     }
+    fTxIndexSpenders = fSpenders;
+    printf("Transaction spender index %s\n", fTxIndexSpenders ? "enabled" : "disabled");
 
     printf("Opened LevelDB successfully\n");
 }
 
+void CTxDB::MakeMock()
+{
+    if (txdb)
+        throw runtime_error("CTxDB::MakeMock(): already opened");
+
+    if (!penvMock)
+        penvMock = leveldb::NewMemEnv(leveldb::Env::Default());
+}
+
 void CTxDB::Close()
 {
     delete txdb;
@@ -143,7 +212,13 @@ bool CTxDB::TxnBegin()
 bool CTxDB::TxnCommit()
 {
     assert(activeBatch);
+    // Block data the batch refers to must reach the disk first
+    int64_t nTimeStart = GetTimeMicros();
+    blockwriter.SyncBeforeCommit();
+    int64_t nTimeWrite = GetTimeMicros();
+    PerfRecord("blockfile.sync", nTimeWrite - nTimeStart);
     leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+    PerfRecord("leveldb.commit", GetTimeMicros() - nTimeWrite);
     delete activeBatch;
     activeBatch = NULL;
     if (!status.ok()) {
@@ -207,7 +282,34 @@ bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex)
 bool CTxDB::UpdateTxIndex(uint256 hash, const CTxIndex& txindex)
 {
     assert(!fClient);
-    return Write(make_pair(string("tx"), hash), txindex);
+    if (!Write(make_pair(string("tx"), hash), txindex))
+        return false;
+
+    if (fTxIndexSpenders)
+    {
+        // Only the outputs spent or unspent since the record was read are written
+        typedef map<unsigned int, CDiskTxPos> SpenderMap;
+        BOOST_FOREACH(const SpenderMap::value_type& item, txindex.GetChangedSpenders())
+        {
+            bool fOk;
+            if (item.second.IsNull())
+                fOk = Erase(boost::make_tuple(string("spender"), hash, item.first));
+            else
+                fOk = Write(boost::make_tuple(string("spender"), hash, item.first), item.second);
+            if (!fOk)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::ReadTxSpender(uint256 hash, unsigned int n, CDiskTxPos& posSpender)
+{
+    assert(!fClient);
+    posSpender.SetNull();
+    if (!fTxIndexSpenders)
+        return false;
+    return Read(boost::make_tuple(string("spender"), hash, n), posSpender);
 }
 
 bool CTxDB::AddTxIndex(const CTransaction& tx, const CDiskTxPos& pos, int nHeight)
@@ -225,6 +327,10 @@ bool CTxDB::EraseTxIndex(const CTransaction& tx)
     assert(!fClient);
     uint256 hash = tx.GetHash();
 
+    if (fTxIndexSpenders)
+        for (unsigned int n = 0; n < tx.vout.size(); n++)
+            Erase(boost::make_tuple(string("spender"), hash, n));
+
     return Erase(make_pair(string("tx"), hash));
 }
 
@@ -305,20 +411,170 @@ bool CTxDB::WriteCheckpointPubKey(const string& strPubKey)
     return Write(string("strCheckpointPubKey"), strPubKey);
 }
 
+/** A "tx" record as written by TXINDEX_FULLSPENT_VERSION databases */
+class CTxIndexFullSpent
+{
+public:
+    CDiskTxPos pos;
+    vector<CDiskTxPos> vSpent;
+
+    IMPLEMENT_SERIALIZE
+    (
+        if (!(nType & SER_GETHASH))
+            READWRITE(nVersion);
+        READWRITE(pos);
+        READWRITE(vSpent);
+    )
+};
+
+// Rewrite every "tx" record in the current format, moving the spending
+// positions to the spender table when -txindexspenders is set. Each batch
+// also records the last key converted ("txindexmigration"), so a migration
+// interrupted by a crash resumes after it instead of reading converted
+// records in the old format.
+bool CTxDB::MigrateTxIndex()
+{
+    printf("Migrating transaction index to version %d...\n", DATABASE_VERSION);
+    int64_t nStart = GetTimeMillis();
+
+    pair<uint256, bool> progress(0, fTxIndexSpenders);
+    bool fResume = Read(string("txindexmigration"), progress);
+    if (fResume)
+    {
+        // Finish in the format the migration was started with
+        fTxIndexSpenders = progress.second;
+        printf("Resuming the migration after %s\n", progress.first.ToString().c_str());
+    }
+
+    leveldb::Iterator *iterator = pdb->NewIterator(leveldb::ReadOptions());
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << make_pair(string("tx"), progress.first);
+    iterator->Seek(ssStartKey.str());
+
+    unsigned int nMigrated = 0;
+    TxnBegin();
+    while (iterator->Valid())
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.write(iterator->key().data(), iterator->key().size());
+        string strType;
+        ssKey >> strType;
+        if (strType != "tx")
+            break;
+        uint256 hash;
+        ssKey >> hash;
+        if (fResume && hash == progress.first)
+        {
+            // Converted in the last batch before the interruption
+            iterator->Next();
+            continue;
+        }
+
+        CTxIndexFullSpent txindexOld;
+        try {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ssValue.write(iterator->value().data(), iterator->value().size());
+            ssValue >> txindexOld;
+        }
+        catch (std::exception &e) {
+            delete iterator;
+            TxnAbort();
+            return error("MigrateTxIndex() : cannot read index of %s", hash.ToString().c_str());
+        }
+
+        CTxIndex txindex(txindexOld.pos, txindexOld.vSpent.size());
+        for (unsigned int n = 0; n < txindexOld.vSpent.size(); n++)
+            if (!txindexOld.vSpent[n].IsNull())
+                txindex.MarkSpent(n, txindexOld.vSpent[n]);
+        if (!UpdateTxIndex(hash, txindex))
+        {
+            delete iterator;
+            TxnAbort();
+            return false;
+        }
+
+        // Keep the write batch bounded
+        if (++nMigrated % 10000 == 0)
+        {
+            Write(string("txindexmigration"), make_pair(hash, fTxIndexSpenders));
+            if (!TxnCommit())
+            {
+                delete iterator;
+                return false;
+            }
+            TxnBegin();
+        }
+        iterator->Next();
+    }
+    delete iterator;
+
+    // The spender table is complete, as the old records had every position
+    if (fTxIndexSpenders)
+        Write(string("txindexspenders"), true);
+    Erase(string("txindexmigration"));
+    WriteVersion(DATABASE_VERSION);
+    if (!TxnCommit())
+        return false;
+
+    printf("Migrated %u transaction index records in %" PRId64 "ms\n", nMigrated, GetTimeMillis() - nStart);
+    return true;
+}
+
+// Delete the spender table, a batch at a time. Its flag is erased first, so
+// the rows left by an interrupted run are never trusted and are deleted on
+// the next start.
+bool CTxDB::EraseTxSpenders()
+{
+    leveldb::Iterator *iterator = pdb->NewIterator(leveldb::ReadOptions());
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << string("spender");
+    iterator->Seek(ssStartKey.str());
+
+    unsigned int nErased = 0;
+    TxnBegin();
+    while (iterator->Valid())
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.write(iterator->key().data(), iterator->key().size());
+        string strType;
+        ssKey >> strType;
+        if (strType != "spender")
+            break;
+        activeBatch->Delete(iterator->key());
+
+        if (++nErased % 10000 == 0)
+        {
+            if (!TxnCommit())
+            {
+                delete iterator;
+                return false;
+            }
+            TxnBegin();
+        }
+        iterator->Next();
+    }
+    delete iterator;
+    if (nErased == 0)
+        return TxnAbort();
+    if (!TxnCommit())
+        return false;
+
+    printf("Erased %u transaction spender records\n", nErased);
+    return true;
+}
+
 static CBlockIndex *InsertBlockIndex(uint256 hash)
 {
     if (hash == 0)
         return NULL;
 
     // Return existing
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
     if (mi != mapBlockIndex.end())
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = NewBlockIndex();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -369,9 +625,11 @@ bool CTxDB::LoadBlockIndex()
         pindexNew->nMoneySupply   = diskindex.nMoneySupply;
         pindexNew->nFlags         = diskindex.nFlags;
         pindexNew->nStakeModifier = diskindex.nStakeModifier;
-        pindexNew->prevoutStake   = diskindex.prevoutStake;
-        pindexNew->nStakeTime     = diskindex.nStakeTime;
-        pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+        if (diskindex.IsProofOfStake())
+        {
+            pindexNew->pstake = NewBlockIndexStake(diskindex.prevoutStake, diskindex.nStakeTime);
+            pindexNew->pstake->hashProofOfStake = diskindex.hashProofOfStake;
+        }
         pindexNew->nVersion       = diskindex.nVersion;
         pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
         pindexNew->nTime          = diskindex.nTime;
@@ -389,7 +647,7 @@ bool CTxDB::LoadBlockIndex()
 
         // NovaCoin: build setStakeSeen
         if (pindexNew->IsProofOfStake())
-            setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+            setStakeSeen.insert(pindexNew->GetProofOfStake());
 
         iterator->Next();
     }
@@ -497,12 +755,13 @@ bool CTxDB::LoadBlockIndex()
                             }
                     }
                     // check level 4: check whether spent txouts were spent within the main chain
-                    unsigned int nOutput = 0;
-                    if (nCheckLevel>3)
+                    // (needs the spending positions, i.e. -txindexspenders)
+                    if (nCheckLevel>3 && fTxIndexSpenders)
                     {
-                        BOOST_FOREACH(const CDiskTxPos &txpos, txindex.vSpent)
+                        for (unsigned int nOutput = 0; nOutput < txindex.GetOutputCount(); nOutput++)
                         {
-                            if (!txpos.IsNull())
+                            CDiskTxPos txpos;
+                            if (txindex.IsSpent(nOutput) && ReadTxSpender(hashTx, nOutput, txpos))
                             {
                                 pair<unsigned int, unsigned int> posFind = make_pair(txpos.nFile, txpos.nBlockPos);
                                 if (!mapBlockPos.count(posFind))
@@ -538,7 +797,6 @@ bool CTxDB::LoadBlockIndex()
                                     }
                                 }
                             }
-                            nOutput++;
                         }
                     }
                 }
@@ -549,7 +807,7 @@ bool CTxDB::LoadBlockIndex()
                      {
                           CTxIndex txindex;
                           if (ReadTxIndex(txin.prevout.hash, txindex))
-                              if (txindex.vSpent.size()-1 < txin.prevout.n || txindex.vSpent[txin.prevout.n].IsNull())
+                              if (txindex.GetOutputCount() <= txin.prevout.n || !txindex.IsSpent(txin.prevout.n))
                               {
                                   printf("LoadBlockIndex(): *** found unspent prevout %s:%i in %s\n", txin.prevout.hash.ToString().c_str(), txin.prevout.n, hashTx.ToString().c_str());
                                   pindexFork = pindex->pprev;
@@ -41,6 +41,10 @@ public:
     // Destroys the underlying shared global state accessed by this TxDB.
     void Close();
 
+    // Keeps the index in memory instead of under the data directory, for
+    // tests and benchmarks. Must be called before the first CTxDB is opened.
+    static void MakeMock();
+
 private:
     leveldb::DB *pdb;  // Points to the global instance.
 
@@ -76,6 +80,7 @@ protected:
             }
         }
         if (readFromDb) {
+            CPerfTimer timer("leveldb.read");
             leveldb::Status status = pdb->Get(leveldb::ReadOptions(),
                                               ssKey.str(), &strValue);
             if (!status.ok()) {
@@ -115,6 +120,7 @@ protected:
             activeBatch->Put(ssKey.str(), ssValue.str());
             return true;
         }
+        CPerfTimer timer("leveldb.write");
         leveldb::Status status = pdb->Put(leveldb::WriteOptions(), ssKey.str(), ssValue.str());
         if (!status.ok()) {
             printf("LevelDB write failure: %s\n", status.ToString().c_str());
@@ -138,6 +144,7 @@ protected:
             activeBatch->Delete(ssKey.str());
             return true;
         }
+        CPerfTimer timer("leveldb.write");
         leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), ssKey.str());
         return (status.ok() || status.IsNotFound());
     }
@@ -158,6 +165,7 @@ protected:
         }
 
 
+        CPerfTimer timer("leveldb.read");
         leveldb::Status status = pdb->Get(leveldb::ReadOptions(), ssKey.str(), &unused);
         return status.IsNotFound() == false;
     }
@@ -186,6 +194,7 @@ public:
 
     bool ReadTxIndex(uint256 hash, CTxIndex& txindex);
     bool UpdateTxIndex(uint256 hash, const CTxIndex& txindex);
+    bool ReadTxSpender(uint256 hash, unsigned int n, CDiskTxPos& posSpender);
     bool AddTxIndex(const CTransaction& tx, const CDiskTxPos& pos, int nHeight);
     bool EraseTxIndex(const CTransaction& tx);
     bool ContainsTx(uint256 hash);
@@ -205,6 +214,8 @@ public:
     bool LoadBlockIndex();
 private:
     bool LoadBlockIndexGuts();
+    bool MigrateTxIndex();
+    bool EraseTxSpenders();
 };
 
 
@@ -9,6 +9,7 @@
 #include "strlcpy.h"
 #include "version.h"
 #include "ui_interface.h"
+#include "perfstats.h"
 #include <boost/algorithm/string/join.hpp>
 
 // Work around clang compilation problem in Boost 1.46:
@@ -30,6 +31,7 @@ namespace boost {
 #include <openssl/crypto.h>
 #include <openssl/rand.h>
 #include <stdarg.h>
+#include <atomic>
 
 #ifdef WIN32
 #ifdef _MSC_VER
@@ -76,6 +78,7 @@ bool fServer = false;
 bool fCommandLine = false;
 string strMiscWarning;
 bool fTestNet = false;
+bool fRegTest = false;
 bool fNoListen = false;
 bool fLogTimestamps = false;
 CMedianFilter<int64_t> vTimeOffsets(200,0);
@@ -201,7 +204,219 @@ uint256 GetRandHash()
 
 static FILE* fileout = NULL;
 
-inline int OutputDebugStringF(const char* pszFormat, ...)
+std::atomic<int> nLogLevel[LOG_CATEGORIES] = {{LOGLEVEL_INFO}, {LOGLEVEL_INFO}, {LOGLEVEL_INFO}, {LOGLEVEL_INFO}, {LOGLEVEL_INFO}};
+
+static const char* pszLogCategories[LOG_CATEGORIES] = {"net", "mempool", "stake", "db", "rpc"};
+static const char* pszLogLevels[] = {"none", "info", "debug"};
+
+const char* LogCategoryName(int nCategory)
+{
+    return pszLogCategories[nCategory];
+}
+
+const char* LogLevelName(int nLevel)
+{
+    return pszLogLevels[nLevel];
+}
+
+int LogCategoryFromName(const std::string& strName)
+{
+    for (int i = 0; i < LOG_CATEGORIES; i++)
+        if (strName == pszLogCategories[i])
+            return i;
+    return -1;
+}
+
+int LogLevelFromName(const std::string& strName)
+{
+    for (int i = LOGLEVEL_NONE; i <= LOGLEVEL_DEBUG; i++)
+        if (strName == pszLogLevels[i])
+            return i;
+    return -1;
+}
+
+// This routine may be called by global destructors during shutdown.
+// Since the order of destruction of static/global objects is undefined,
+// the mutex is allocated on the heap the first time it is needed.
+static boost::mutex& DebugLogMutex()
+{
+    static boost::mutex* mutexDebugLog = new boost::mutex();
+    return *mutexDebugLog;
+}
+
+// Append to debug.log, buffered. Caller holds DebugLogMutex().
+static bool WriteDebugLog(const std::string& str, int64_t nTime)
+{
+    if (!fileout)
+    {
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        fileout = fopen(pathDebug.string().c_str(), "a");
+        if (!fileout)
+            return false;
+        setvbuf(fileout, NULL, _IOFBF, 64 * 1024);
+    }
+
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
+            setvbuf(fileout, NULL, _IOFBF, 64 * 1024);
+    }
+
+    // Debug print useful for profiling
+    static bool fStartedNewLine = true;
+    if (fLogTimestamps && fStartedNewLine)
+    {
+        static int64_t nLastTime = -1;
+        static std::string strLastTime;
+        if (nTime != nLastTime)
+        {
+            strLastTime = DateTimeStrFormat("%x %H:%M:%S", nTime) + " ";
+            nLastTime = nTime;
+        }
+        fputs(strLastTime.c_str(), fileout);
+    }
+    fwrite(str.data(), 1, str.size(), fileout);
+    fStartedNewLine = (!str.empty() && str[str.size() - 1] == '\n');
+    return true;
+}
+
+// Log lines waiting for the writer thread. A logging thread claims a slot by
+// advancing nEnqueuePos with a compare-and-swap and publishes it through the
+// slot's sequence number, so logging threads never wait on each other or on
+// the disk. The writer thread is the only consumer.
+static const unsigned int LOG_RING_SIZE = 8192; // power of 2
+
+class CLogRing
+{
+private:
+    struct CSlot
+    {
+        std::atomic<unsigned int> nSeq;
+        int64_t nTime;
+        std::string str;
+    };
+
+    CSlot slots[LOG_RING_SIZE];
+    std::atomic<unsigned int> nEnqueuePos;
+    unsigned int nDequeuePos;
+
+public:
+    CLogRing() : nEnqueuePos(0), nDequeuePos(0)
+    {
+        for (unsigned int i = 0; i < LOG_RING_SIZE; i++)
+            slots[i].nSeq.store(i, std::memory_order_relaxed);
+    }
+
+    // Takes the contents of str; false if the ring is full
+    bool Push(std::string& str, int64_t nTime)
+    {
+        unsigned int nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        CSlot* slot;
+        while (true)
+        {
+            slot = &slots[nPos & (LOG_RING_SIZE - 1)];
+            int nDiff = (int)(slot->nSeq.load(std::memory_order_acquire) - nPos);
+            if (nDiff == 0)
+            {
+                if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (nDiff < 0)
+                return false;
+            else
+                nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+        slot->str.swap(str);
+        slot->nTime = nTime;
+        slot->nSeq.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Writer thread only
+    bool Pop(std::string& str, int64_t& nTime)
+    {
+        CSlot* slot = &slots[nDequeuePos & (LOG_RING_SIZE - 1)];
+        if (slot->nSeq.load(std::memory_order_acquire) != nDequeuePos + 1)
+            return false;
+        str.swap(slot->str);
+        nTime = slot->nTime;
+        slot->nSeq.store(nDequeuePos + LOG_RING_SIZE, std::memory_order_release);
+        nDequeuePos++;
+        return true;
+    }
+};
+
+static CLogRing* plogring = NULL;
+static boost::thread* pthreadLogWriter = NULL;
+static std::atomic<bool> fLogWriterRunning(false);  // new lines go to the ring
+static std::atomic<bool> fLogWriterExit(false);
+static std::atomic<bool> fLogWriterWaiting(false);
+static std::atomic<int> nLogProducers(0);
+static boost::mutex mutexLogWriter;
+static boost::condition_variable condLogWriter;
+
+static void ThreadLogWriter()
+{
+    RenameThread("MotaCoin-log");
+    std::string str;
+    int64_t nTime;
+    while (true)
+    {
+        // Read before draining, so that nothing queued before the exit request is left behind
+        bool fExit = fLogWriterExit;
+        bool fWritten = false;
+        {
+            boost::mutex::scoped_lock scoped_lock(DebugLogMutex());
+            while (plogring->Pop(str, nTime))
+                fWritten |= WriteDebugLog(str, nTime);
+            if (fWritten)
+                fflush(fileout);
+        }
+        if (fExit)
+            return;
+        if (!fWritten)
+        {
+            // A wakeup racing with fLogWriterWaiting is lost, but only delays the write
+            boost::mutex::scoped_lock lock(mutexLogWriter);
+            fLogWriterWaiting = true;
+            condLogWriter.timed_wait(lock, boost::posix_time::milliseconds(100));
+            fLogWriterWaiting = false;
+        }
+    }
+}
+
+void StartLogWriter()
+{
+    if (fPrintToConsole || fPrintToDebugger || pthreadLogWriter)
+        return;
+    if (!plogring)
+        plogring = new CLogRing();
+    fLogWriterExit = false;
+    fLogWriterRunning = true;
+    pthreadLogWriter = new boost::thread(ThreadLogWriter);
+}
+
+void StopLogWriter()
+{
+    if (!pthreadLogWriter)
+        return;
+    // Lines already being queued are written before the thread exits
+    fLogWriterRunning = false;
+    while (nLogProducers > 0)
+        boost::this_thread::yield();
+    fLogWriterExit = true;
+    {
+        boost::mutex::scoped_lock lock(mutexLogWriter);
+        condLogWriter.notify_one();
+    }
+    pthreadLogWriter->join();
+    delete pthreadLogWriter;
+    pthreadLogWriter = NULL;
+}
+
+int OutputDebugStringF(const char* pszFormat, ...)
 {
     int ret = 0;
     if (fPrintToConsole)
@@ -214,46 +429,38 @@ inline int OutputDebugStringF(const char* pszFormat, ...)
     }
     else if (!fPrintToDebugger)
     {
-        // print to debug.log
+        // print to debug.log, through the writer thread once it is started
+        va_list arg_ptr;
+        va_start(arg_ptr, pszFormat);
+        std::string str = vstrprintf(pszFormat, arg_ptr);
+        va_end(arg_ptr);
+        ret = str.size();
+        int64_t nTime = fLogTimestamps ? GetTime() : 0;
 
-        if (!fileout)
+        bool fQueued = false;
+        nLogProducers++;
+        if (fLogWriterRunning)
         {
-            boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-            fileout = fopen(pathDebug.string().c_str(), "a");
-            if (fileout) setbuf(fileout, NULL); // unbuffered
+            // A full ring means the disk can't keep up; wait rather than lose lines
+            while (!plogring->Push(str, nTime))
+                boost::this_thread::yield();
+            fQueued = true;
         }
-        if (fileout)
+        nLogProducers--;
+
+        if (fQueued)
         {
-            static bool fStartedNewLine = true;
-
-            // This routine may be called by global destructors during shutdown.
-            // Since the order of destruction of static/global objects is undefined,
-            // allocate mutexDebugLog on the heap the first time this routine
-            // is called to avoid crashes during shutdown.
-            static boost::mutex* mutexDebugLog = NULL;
-            if (mutexDebugLog == NULL) mutexDebugLog = new boost::mutex();
-            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
+            if (fLogWriterWaiting)
+            {
+                boost::mutex::scoped_lock lock(mutexLogWriter);
+                condLogWriter.notify_one();
             }
-
-            // Debug print useful for profiling
-            if (fLogTimestamps && fStartedNewLine)
-                fprintf(fileout, "%s ", DateTimeStrFormat("%x %H:%M:%S", GetTime()).c_str());
-            if (pszFormat[strlen(pszFormat) - 1] == '\n')
-                fStartedNewLine = true;
-            else
-                fStartedNewLine = false;
-
-            va_list arg_ptr;
-            va_start(arg_ptr, pszFormat);
-            ret = vfprintf(fileout, pszFormat, arg_ptr);
-            va_end(arg_ptr);
+        }
+        else
+        {
+            boost::mutex::scoped_lock scoped_lock(DebugLogMutex());
+            if (WriteDebugLog(str, nTime))
+                fflush(fileout);
         }
     }
 
@@ -988,15 +1195,18 @@ void PrintException(std::exception* pex, const char* pszThread)
 
 void LogStackTrace() {
     printf("\n\n******* exception encountered *******\n");
-    if (fileout)
-    {
 #ifndef WIN32
-        void* pszBuffer[32];
-        size_t size;
-        size = backtrace(pszBuffer, 32);
-        backtrace_symbols_fd(pszBuffer, size, fileno(fileout));
-#endif
+    // Through printf, so it stays in order with lines the log writer has queued
+    void* pszBuffer[32];
+    int size = backtrace(pszBuffer, 32);
+    char** ppszSymbols = backtrace_symbols(pszBuffer, size);
+    if (ppszSymbols)
+    {
+        for (int i = 0; i < size; i++)
+            printf("%s\n", ppszSymbols[i]);
+        free(ppszSymbols);
     }
+#endif
 }
 
 void PrintExceptionContinue(std::exception* pex, const char* pszThread)
@@ -1063,7 +1273,7 @@ const boost::filesystem::path &GetDataDir(bool fNetSpecific)
         path = GetDefaultDataDir();
     }
     if (fNetSpecific && fTestNet)
-        path /= "testnet";
+        path /= fRegTest ? "regtest" : "testnet";
 
     fs::create_directory(path);
 
@@ -1276,6 +1486,8 @@ void runCommand(std::string strCommand)
 
 void RenameThread(const char* name)
 {
+    PerfSetThreadName(name);
+
 #if defined(PR_SET_NAME)
     // Only the first 15 characters are used (16 - NUL terminator)
     ::prctl(PR_SET_NAME, name, 0, 0, 0);
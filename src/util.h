@@ -16,6 +16,7 @@
 #include <sys/resource.h>
 #endif
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <string>
@@ -149,13 +150,51 @@ extern bool fServer;
 extern bool fCommandLine;
 extern std::string strMiscWarning;
 extern bool fTestNet;
+extern bool fRegTest;
 extern bool fNoListen;
 extern bool fLogTimestamps;
 extern bool fReopenDebugLog;
 
+/** Debug log categories, each with its own level (-loglevel, RPC logging) */
+enum LogCategory
+{
+    LOG_NET,
+    LOG_MEMPOOL,
+    LOG_STAKE,
+    LOG_DB,
+    LOG_RPC,
+    LOG_CATEGORIES
+};
+
+enum LogLevel
+{
+    LOGLEVEL_NONE,      // nothing
+    LOGLEVEL_INFO,      // the messages logged without -debug
+    LOGLEVEL_DEBUG,     // everything
+};
+
+// Set by the logging RPC while every thread reads it
+extern std::atomic<int> nLogLevel[LOG_CATEGORIES];
+
+/** Whether messages of a category at a level are logged:
+ *  if (LogAccept(LOG_NET)) printf(...);
+ */
+inline bool LogAccept(int nCategory, int nLevel=LOGLEVEL_DEBUG)
+{
+    return nLogLevel[nCategory].load(std::memory_order_relaxed) >= nLevel;
+}
+
+const char* LogCategoryName(int nCategory);
+const char* LogLevelName(int nLevel);
+int LogCategoryFromName(const std::string& strName); // -1 if unknown
+int LogLevelFromName(const std::string& strName);    // -1 if unknown
+
 void RandAddSeed();
 void RandAddSeedPerfmon();
 int ATTR_WARN_PRINTF(1,2) OutputDebugStringF(const char* pszFormat, ...);
+// Hand debug.log writes to a background thread from here on / write synchronously again
+void StartLogWriter();
+void StopLogWriter();
 
 /*
   Rationale for the real_strprintf / strprintf construction:
@@ -352,6 +391,12 @@ inline int64_t GetTimeMillis()
             boost::posix_time::ptime(boost::gregorian::date(1970,1,1))).total_milliseconds();
 }
 
+inline int64_t GetTimeMicros()
+{
+    return (boost::posix_time::ptime(boost::posix_time::microsec_clock::universal_time()) -
+            boost::posix_time::ptime(boost::gregorian::date(1970,1,1))).total_microseconds();
+}
+
 inline std::string DateTimeStrFormat(const char* pszFormat, int64_t nTime)
 {
     time_t n = nTime;
@@ -14,7 +14,7 @@
 //
 // database format versioning
 //
-static const int DATABASE_VERSION = 70508;
+static const int DATABASE_VERSION = 70509;
 
 //
 // network protocol versioning
@@ -30,6 +30,8 @@ class CReserveKey;
 class COutput;
 class CCoinControl;
 
+typedef std::unordered_map<uint256, CWalletTx, CSaltedHasher> WalletTxMap;
+
 /** (client) version numbers for particular wallet features */
 enum WalletFeature
 {
@@ -79,6 +81,13 @@ private:
 
     CWalletDB *pwalletdbEncryption;
 
+    // Nesting depth of write batches (see CWalletWriteBatch), and the
+    // transactions and counters whose disk writes are deferred until the
+    // outermost batch ends
+    int nWriteBatchDepth;
+    mutable std::set<uint256> setWriteBatchTx;
+    bool fWriteBatchOrderPosNext;
+
     // the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion;
 
@@ -126,6 +135,8 @@ public:
         fFileBacked = false;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
+        nWriteBatchDepth = 0;
+        fWriteBatchOrderPosNext = false;
         nOrderPosNext = 0;
 		fWalletUnlockMintOnly = false;
 		fStakeForCharity = false;
@@ -155,6 +166,8 @@ public:
         fFileBacked = true;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
+        nWriteBatchDepth = 0;
+        fWriteBatchOrderPosNext = false;
         nOrderPosNext = 0;
 		fWalletUnlockMintOnly = false;
 		fStakeForCharity = false;
@@ -177,7 +190,7 @@ public:
 		vDisabledAddresses.clear();
     }
 
-    std::map<uint256, CWalletTx> mapWallet;
+    WalletTxMap mapWallet;
     int64_t nOrderPosNext;
     std::map<uint256, int> mapRequestCount;
 
@@ -191,8 +204,8 @@ public:
 
     void AvailableCoinsMinConf(std::vector<COutput>& vCoins, int nConf) const;
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl=NULL) const;
-    bool SelectCoinsMinConf(int64_t nTargetValue, unsigned int nSpendTime, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet) const;
-    bool SelectCoinsMinConfByCoinAge(int64_t nTargetValue, unsigned int nSpendTime, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet) const;
+    bool SelectCoinsMinConf(int64_t nTargetValue, unsigned int nSpendTime, int nConfMine, int nConfTheirs, const std::vector<COutput>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet) const;
+    bool SelectCoinsMinConfByCoinAge(int64_t nTargetValue, unsigned int nSpendTime, int nConfMine, int nConfTheirs, const std::vector<COutput>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet) const;
     // keystore implementation
     // Generate a new key
     CPubKey GenerateNewKey();
@@ -200,6 +213,9 @@ public:
     bool AddKey(const CKey& key);
     // Adds a key to the store, without saving it to disk (used by LoadWallet)
     bool LoadKey(const CKey& key) { return CCryptoKeyStore::AddKey(key); }
+    // Adds a key by its public key and secret, without saving it to disk or
+    // checking that the two match (used by LoadWallet, which checks separately)
+    bool LoadKey(const CPubKey& vchPubKey, const CSecret& vchSecret) { return CCryptoKeyStore::AddSecret(vchPubKey, vchSecret, vchPubKey.IsCompressed()); }
     // Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CPubKey &pubkey, const CKeyMetadata &metadata);
 
@@ -224,14 +240,27 @@ public:
      */
     int64_t IncOrderPosNext(CWalletDB *pwalletdb = NULL);
 
+    // Start deferring transaction writes; nests
+    void BeginWriteBatch();
+    // Write everything deferred since the outermost BeginWriteBatch() in a single database transaction
+    bool EndWriteBatch();
+    // Write what has been deferred so far without ending the batch, e.g. before a transaction is relayed
+    bool FlushWriteBatch();
+    // Defer the write of transaction hash if a write batch is active
+    bool DeferWriteTx(const uint256& hash) const;
+
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
     typedef std::multimap<int64_t, TxPair > TxItems;
 
-    /** Get the wallet's activity log
-        @return multimap of ordered transactions and accounting entries
-        @warning Returned pointers are *only* valid within the scope of passed acentries
-     */
-    TxItems OrderedTxItems(std::list<CAccountingEntry>& acentries, std::string strAccount = "");
+    // The wallet's activity log: every transaction and accounting entry by
+    // nOrderPos, kept up to date as they are added (guarded by cs_wallet)
+    TxItems wtxOrdered;
+    std::list<CAccountingEntry> laccentries;
+
+    // Rebuild wtxOrdered and laccentries from mapWallet and the database
+    void BuildOrderedTxIndex();
+    // Index an accounting entry the caller has already written to the database
+    void AddAccountingEntry(const CAccountingEntry& acentry);
 
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn);
@@ -391,6 +420,36 @@ public:
     boost::signals2::signal<void (CWallet *wallet, const uint256 &hashTx, ChangeType status)> NotifyTransactionChanged;
 };
 
+/** Groups the wallet transaction writes made while in scope (e.g. by one
+ * block connect or one RPC call) into a single database transaction,
+ * instead of opening and checkpointing wallet.dat once per record.
+ */
+class CWalletWriteBatch
+{
+private:
+    CWallet* pwallet;
+
+public:
+    CWalletWriteBatch(CWallet* pwalletIn) : pwallet(pwalletIn)
+    {
+        if (pwallet)
+            pwallet->BeginWriteBatch();
+    }
+
+    ~CWalletWriteBatch()
+    {
+        End();
+    }
+
+    // End the batch early, returning whether the deferred writes succeeded
+    bool End()
+    {
+        CWallet* pwalletEnd = pwallet;
+        pwallet = NULL;
+        return pwalletEnd ? pwalletEnd->EndWriteBatch() : true;
+    }
+};
+
 /** A key allocated from the key pool. */
 class CReserveKey
 {
@@ -6,8 +6,10 @@
 
 #include "walletdb.h"
 #include "wallet.h"
+#include "checkqueue.h"
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace boost;
@@ -122,7 +124,7 @@ CWalletDB::ReorderTransactions(CWallet* pwallet)
     typedef multimap<int64_t, TxPair > TxItems;
     TxItems txByTime;
 
-    for (map<uint256, CWalletTx>::iterator it = pwallet->mapWallet.begin(); it != pwallet->mapWallet.end(); ++it)
+    for (WalletTxMap::iterator it = pwallet->mapWallet.begin(); it != pwallet->mapWallet.end(); ++it)
     {
         CWalletTx* wtx = &((*it).second);
         txByTime.insert(make_pair(wtx->nTimeReceived, TxPair(wtx, (CAccountingEntry*)0)));
@@ -182,6 +184,79 @@ CWalletDB::ReorderTransactions(CWallet* pwallet)
     return DB_LOAD_OK;
 }
 
+/** Consistency check of a plaintext "key" or "wkey" record: the stored
+ *  private key must parse, be valid and match the public key it is filed under.
+ *  These are the expensive EC operations of wallet loading, so LoadWallet runs
+ *  them on a CCheckQueue instead of inline while scanning the database.
+ */
+class CWalletKeyCheck
+{
+private:
+    CPubKey vchPubKey;
+    CPrivKey vchPrivKey;
+    bool fWalletKey;
+
+public:
+    string strErr;
+
+    CWalletKeyCheck() : fWalletKey(false) {}
+    CWalletKeyCheck(const CPubKey& vchPubKeyIn, const CPrivKey& vchPrivKeyIn, bool fWalletKeyIn) :
+        vchPubKey(vchPubKeyIn), vchPrivKey(vchPrivKeyIn), fWalletKey(fWalletKeyIn) {}
+
+    bool operator()()
+    {
+        try {
+            CKey key;
+            key.SetPubKey(vchPubKey);
+            if (!key.SetPrivKey(vchPrivKey))
+                strErr = "Error reading wallet database: CPrivKey corrupt";
+            else if (key.GetPubKey() != vchPubKey)
+                strErr = fWalletKey ? "Error reading wallet database: CWalletKey pubkey inconsistency" :
+                                      "Error reading wallet database: CPrivKey pubkey inconsistency";
+            else if (!key.IsValid())
+                strErr = fWalletKey ? "Error reading wallet database: invalid CWalletKey" :
+                                      "Error reading wallet database: invalid CPrivKey";
+            else
+                return true;
+        } catch (key_error& e) {
+            strErr = strprintf("Error reading wallet database: %s", e.what());
+        }
+        return false;
+    }
+
+    void swap(CWalletKeyCheck& check)
+    {
+        std::swap(vchPubKey, check.vchPubKey);
+        vchPrivKey.swap(check.vchPrivKey);
+        std::swap(fWalletKey, check.fWalletKey);
+        strErr.swap(check.strErr);
+    }
+};
+
+// Queue the deferred key checks in batches of this many while scanning
+static const unsigned int WALLET_KEYCHECK_BATCH = 1000;
+
+/** Worker threads running CWalletKeyCheck jobs for the duration of one LoadWallet call */
+class CWalletKeyCheckPool
+{
+public:
+    CCheckQueue<CWalletKeyCheck> queue;
+    boost::thread_group threads;
+
+    CWalletKeyCheckPool(int nThreads) : queue(128)
+    {
+        // The thread calling Wait() acts as one more worker
+        for (int i = 1; i < nThreads; i++)
+            threads.create_thread(boost::bind(&CCheckQueue<CWalletKeyCheck>::Thread, &queue));
+    }
+
+    ~CWalletKeyCheckPool()
+    {
+        queue.Quit();
+        threads.join_all();
+    }
+};
+
 class CWalletScanState {
 public:
     unsigned int nKeys;
@@ -191,12 +266,20 @@ public:
     bool fAnyUnordered;
     int nFileVersion;
     vector<uint256> vWalletUpgrade;
+    // If set, key consistency checks are collected in vKeyChecks instead of
+    // being run by ReadKeyValue itself
+    bool fDeferKeyChecks;
+    // If unset, deferred key checks are skipped entirely (-walletverify=lazy)
+    bool fCheckKeys;
+    vector<CWalletKeyCheck> vKeyChecks;
 
     CWalletScanState() {
         nKeys = nCKeys = nKeyMeta = 0;
         fIsEncrypted = false;
         fAnyUnordered = false;
         nFileVersion = 0;
+        fDeferKeyChecks = false;
+        fCheckKeys = true;
     }
 };
 
@@ -281,51 +364,39 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         {
             vector<unsigned char> vchPubKey;
             ssKey >> vchPubKey;
-            CKey key;
+            CPrivKey pkey;
             if (strType == "key")
             {
                 wss.nKeys++;
-                CPrivKey pkey;
                 ssValue >> pkey;
-                key.SetPubKey(vchPubKey);
-                if (!key.SetPrivKey(pkey))
-                {
-                    strErr = "Error reading wallet database: CPrivKey corrupt";
-                    return false;
-                }
-                if (key.GetPubKey() != vchPubKey)
-                {
-                    strErr = "Error reading wallet database: CPrivKey pubkey inconsistency";
-                    return false;
-                }
-                if (!key.IsValid())
-                {
-                    strErr = "Error reading wallet database: invalid CPrivKey";
-                    return false;
-                }
             }
             else
             {
                 CWalletKey wkey;
                 ssValue >> wkey;
-                key.SetPubKey(vchPubKey);
-                if (!key.SetPrivKey(wkey.vchPrivKey))
-                {
-                    strErr = "Error reading wallet database: CPrivKey corrupt";
-                    return false;
-                }
-                if (key.GetPubKey() != vchPubKey)
-                {
-                    strErr = "Error reading wallet database: CWalletKey pubkey inconsistency";
-                    return false;
-                }
-                if (!key.IsValid())
+                pkey = wkey.vchPrivKey;
+            }
+            CSecret vchSecret;
+            if (!CKey::GetSecretFromPrivKey(pkey, vchSecret))
+            {
+                strErr = "Error reading wallet database: CPrivKey corrupt";
+                return false;
+            }
+            CWalletKeyCheck check(vchPubKey, pkey, strType == "wkey");
+            if (!wss.fDeferKeyChecks)
+            {
+                if (!check())
                 {
-                    strErr = "Error reading wallet database: invalid CWalletKey";
+                    strErr = check.strErr;
                     return false;
                 }
             }
-            if (!pwallet->LoadKey(key))
+            else if (wss.fCheckKeys)
+            {
+                wss.vKeyChecks.push_back(CWalletKeyCheck());
+                wss.vKeyChecks.back().swap(check);
+            }
+            if (!pwallet->LoadKey(vchPubKey, vchSecret))
             {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -477,8 +548,15 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     bool fNoncriticalErrors = false;
     DBErrors result = DB_LOAD_OK;
 
+    // Plaintext key records are checked against their public keys by a pool
+    // of worker threads while the database scan continues on this thread.
+    wss.fDeferKeyChecks = true;
+    wss.fCheckKeys = (GetArg("-walletverify", "full") != "lazy");
+    CWalletKeyCheckPool keyCheckPool(wss.fCheckKeys ? boost::thread::hardware_concurrency() : 0);
+
     try {
         LOCK(pwallet->cs_wallet);
+        CCheckQueueControl<CWalletKeyCheck> keyCheckControl(wss.fCheckKeys ? &keyCheckPool.queue : NULL);
         int nMinVersion = 0;
         if (Read((string)"minversion", nMinVersion))
         {
@@ -528,8 +606,22 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 printf("%s\n", strErr.c_str());
+
+            if (wss.vKeyChecks.size() >= WALLET_KEYCHECK_BATCH)
+            {
+                keyCheckControl.Add(wss.vKeyChecks);
+                wss.vKeyChecks.clear();
+            }
         }
         pcursor->close();
+
+        keyCheckControl.Add(wss.vKeyChecks);
+        wss.vKeyChecks.clear();
+        if (!keyCheckControl.Wait())
+        {
+            printf("Error reading wallet database: private key inconsistent with its public key\n");
+            result = DB_CORRUPT;
+        }
     }
     catch (...)
     {
@@ -583,6 +675,9 @@ void ThreadFlushWalletDB(void* parg)
     if (!GetBoolArg("-flushwallet", true))
         return;
 
+    // Seconds the wallet must have been idle before it is flushed to disk
+    int64_t nFlushInterval = std::max((int64_t)1, GetArg("-walletflushinterval", 2));
+
     unsigned int nLastSeen = nWalletDBUpdated;
     unsigned int nLastFlushed = nWalletDBUpdated;
     int64_t nLastWalletUpdate = GetTime();
@@ -596,7 +691,7 @@ void ThreadFlushWalletDB(void* parg)
             nLastWalletUpdate = GetTime();
         }
 
-        if (nLastFlushed != nWalletDBUpdated && GetTime() - nLastWalletUpdate >= 2)
+        if (nLastFlushed != nWalletDBUpdated && GetTime() - nLastWalletUpdate >= nFlushInterval)
         {
             TRY_LOCK(bitdb.cs_db,lockDb);
             if (lockDb)